@@ -502,7 +502,7 @@ void AppRun_UpdatePosition(HWND parentWindow, const RECT& clientRect, AppRunStat
     }
 }
 
-void AppRun_Draw(HDC hdc, const RECT& clientRect, AppRunState* state) {
+void AppRun_Draw(Canvas* canvas, const RECT& clientRect, AppRunState* state) {
     if (!state || !state->isEmbedded) return;
     
     const int RED_BORDER = 3;
@@ -511,14 +511,12 @@ void AppRun_Draw(HDC hdc, const RECT& clientRect, AppRunState* state) {
     // Draw red border (3 pixels thick)
     RECT redBorder = clientRect;
     redBorder.bottom = clientRect.bottom - BAR_HEIGHT;
-    HBRUSH redBrush = CreateSolidBrush(RGB(255, 0, 0));
     
     for (int i = 0; i < RED_BORDER; i++) {
         RECT layer = redBorder;
         InflateRect(&layer, -i, -i);
-        FrameRect(hdc, &layer, redBrush);
+        canvas->StrokeRect(layer, 1, RGB(255, 0, 0));
     }
-    DeleteObject(redBrush);
     
     // Draw white border (10 pixels thick)
     RECT whiteBorder = clientRect;
@@ -527,13 +525,11 @@ void AppRun_Draw(HDC hdc, const RECT& clientRect, AppRunState* state) {
     whiteBorder.right = clientRect.right - RED_BORDER;
     whiteBorder.bottom = clientRect.bottom - BAR_HEIGHT - RED_BORDER;
     
-    HBRUSH whiteBrush = CreateSolidBrush(RGB(255, 255, 255));
     for (int i = 0; i < WHITE_BORDER; i++) {
         RECT layer = whiteBorder;
         InflateRect(&layer, -i, -i);
-        FrameRect(hdc, &layer, whiteBrush);
+        canvas->StrokeRect(layer, 1, RGB(255, 255, 255));
     }
-    DeleteObject(whiteBrush);
 }
 
 void AppRun_CloseApp(AppRunState* state) {
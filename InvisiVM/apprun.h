@@ -1,8 +1,9 @@
 #ifndef APPRUN_H
 #define APPRUN_H
 
-#include <windows.h>
+#include "platform.h"
 #include <string>
+#include "canvas.h"
 
 // Application embedding state
 struct AppRunState {
@@ -24,7 +25,7 @@ void AppRun_Initialize(AppRunState* state);
 bool AppRun_SelectAndLaunchApp(HWND parentWindow, AppRunState* state);
 bool AppRun_EmbedWindow(HWND parentWindow, AppRunState* state);
 void AppRun_UpdatePosition(HWND parentWindow, const RECT& clientRect, AppRunState* state);
-void AppRun_Draw(HDC hdc, const RECT& clientRect, AppRunState* state);
+void AppRun_Draw(Canvas* canvas, const RECT& clientRect, AppRunState* state);
 void AppRun_Cleanup(AppRunState* state);
 bool AppRun_IsRunning(AppRunState* state);
 void AppRun_CloseApp(AppRunState* state);
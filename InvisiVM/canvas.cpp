@@ -0,0 +1,8 @@
+#include "canvas.h"
+
+void Canvas_TextInRectA(Canvas* canvas, const CanvasFont& font, COLORREF color, const RECT& rect, const char* text,
+                        UINT format) {
+    std::wstring wide;
+    for (const char* p = text; *p; p++) wide.push_back((wchar_t)(unsigned char)*p);
+    canvas->TextInRect(font, color, rect, wide.c_str(), (int)wide.length(), format);
+}
@@ -0,0 +1,69 @@
+#ifndef CANVAS_H
+#define CANVAS_H
+
+#include <cstddef>
+#include <string>
+#include "platform.h"
+#include "wraplayout.h"
+
+// What the drawing code draws on. GdiCanvas draws through an HDC for the
+// window; SoftCanvas rasterizes into memory, so a frame can be drawn and
+// checked without a window or without Windows at all.
+//
+// Colours are COLORREFs and text is laid out with the DT_ flags of
+// DrawText, so code moved off an HDC reads as it did.
+
+// An empty face is the device's own font, the one the viewer's text is in
+struct CanvasFont {
+    std::wstring face;
+    int height;   // cell height in pixels, as a positive CreateFont height
+    int weight;   // FW_NORMAL, FW_BOLD, ...
+    bool italic;
+};
+
+class Canvas {
+public:
+    virtual ~Canvas() {}
+
+    virtual void FillRect(const RECT& rect, COLORREF color) = 0;
+    // Outline with a pen 'penWidth' wide on the edge of 'rect', as GDI's
+    // Rectangle draws it; a 1 pixel pen stays inside
+    virtual void StrokeRect(const RECT& rect, int penWidth, COLORREF color) = 0;
+    // From (x0, y0) up to but not including (x1, y1), as LineTo
+    virtual void Line(int x0, int y0, int x1, int y1, int penWidth, COLORREF color) = 0;
+    // Ellipse in 'rect' with a 1 pixel outline, as Ellipse with the
+    // default pen
+    virtual void FillEllipse(const RECT& rect, COLORREF fill, COLORREF outline) = 0;
+    virtual void StrokeEllipse(const RECT& rect, int penWidth, COLORREF color) = 0;
+
+    // 'length' code units with the top left of their cell at (x, y), cut
+    // to 'clip' if there is one
+    virtual void Text(const CanvasFont& font, COLORREF color, int x, int y, const wchar_t* text, size_t length,
+                      const RECT* clip) = 0;
+    // Text placed in 'rect' by DT_LEFT, DT_CENTER, DT_RIGHT, DT_TOP,
+    // DT_VCENTER and DT_SINGLELINE, and cut to it. A length of -1 runs to
+    // the terminator.
+    virtual void TextInRect(const CanvasFont& font, COLORREF color, const RECT& rect, const wchar_t* text,
+                            int length, UINT format) = 0;
+    virtual int TextWidth(const CanvasFont& font, const wchar_t* text, size_t length) = 0;
+    // Advances in 'font' for laying text out before it is drawn. Valid
+    // while the canvas is, and until the next call.
+    virtual GlyphMeasurer* Measurer(const CanvasFont& font) = 0;
+
+    // Keeps drawing inside 'rect' as well as the paint area; NULL lifts it
+    virtual void SetClip(const RECT* rect) = 0;
+    // Only 'rect' is being drawn again, as for a damaged part of a window:
+    // drawing outside it is dropped. NULL is the whole canvas.
+    virtual void SetPaintArea(const RECT* rect) = 0;
+    // False when nothing drawn in 'rect' would show, so it can be skipped
+    virtual bool Visible(const RECT& rect) = 0;
+    // Moves the pixels in 'rect' by (dx, dy), dropping those that leave it;
+    // the ones uncovered keep what they had. Not clipped.
+    virtual void Scroll(const RECT& rect, int dx, int dy) = 0;
+};
+
+// The ASCII 'text' as TextInRect draws it, for status strings
+void Canvas_TextInRectA(Canvas* canvas, const CanvasFont& font, COLORREF color, const RECT& rect, const char* text,
+                        UINT format);
+
+#endif
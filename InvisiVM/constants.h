@@ -8,6 +8,8 @@ const int CIRCLE_SPACING = 15;
 const int WINDOW_WIDTH = 800;
 const int WINDOW_HEIGHT = 600;
 const int LINE_HEIGHT = 16;
+// Space either side of the text in a grid cell
+const int CELL_PADDING = 4;
 
 // Animation constants
 const int TIMER_INTERVAL = 16;  // ~60 FPS
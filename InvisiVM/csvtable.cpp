@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CSVTABLE_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "csvtable.h"
+#include "threadpool.h"
+
+// Chunks are at least this big so small files stay on one thread
+static const size_t MIN_CHUNK = 16 << 20;
+static const size_t BLOCK = 64;
+// Rows seen before the arrays are sized for the whole chunk
+static const size_t SAMPLE_ROWS = 4096;
+
+static inline int LowestBit(uint64_t mask) {
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward64(&bit, mask);
+    return (int)bit;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+static inline int PopCount(uint64_t mask) {
+#ifdef _MSC_VER
+    return (int)__popcnt64(mask);
+#else
+    return __builtin_popcountll(mask);
+#endif
+}
+
+// Bit i of the result is the parity of the set bits at or below i, which
+// for a quote mask marks the bytes inside quotes
+static inline uint64_t PrefixXor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+#ifdef CSVTABLE_SSE2
+static inline uint64_t MatchMask(const __m128i* block, char c) {
+    const __m128i needle = _mm_set1_epi8(c);
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        mask |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block[i], needle)) << (16 * i);
+    }
+    return mask;
+}
+#endif
+
+struct BlockMasks {
+    uint64_t quote;
+    uint64_t delimiter;
+    uint64_t newline;
+};
+
+// One bit per byte of a 64-byte block
+static inline void ScanBlock(const char* p, char delimiter, BlockMasks* m) {
+#ifdef CSVTABLE_SSE2
+    __m128i block[4];
+    for (int i = 0; i < 4; i++) block[i] = _mm_loadu_si128((const __m128i*)(p + 16 * i));
+    m->quote = MatchMask(block, '"');
+    m->delimiter = MatchMask(block, delimiter);
+    m->newline = MatchMask(block, '\n');
+#else
+    m->quote = m->delimiter = m->newline = 0;
+    for (size_t i = 0; i < BLOCK; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        if (p[i] == '"') m->quote |= bit;
+        if (p[i] == delimiter) m->delimiter |= bit;
+        if (p[i] == '\n') m->newline |= bit;
+    }
+#endif
+}
+
+// The block at 'pos', zero padded past the end of the buffer
+static inline const char* BlockAt(const char* data, size_t size, size_t pos, char* tail) {
+    if (pos + BLOCK <= size) return data + pos;
+    memset(tail, 0, BLOCK);
+    memcpy(tail, data + pos, size - pos);
+    return tail;
+}
+
+static size_t CountQuotes(const char* data, size_t size, size_t from, size_t to) {
+    char tail[BLOCK];
+    size_t count = 0;
+    for (size_t pos = from; pos < to; pos += BLOCK) {
+        BlockMasks m;
+        ScanBlock(BlockAt(data, to, pos, tail), '\0', &m);
+        count += PopCount(m.quote);
+    }
+    return count;
+}
+
+static void PushRow(CsvSegment* seg, size_t rowStart, const std::vector<uint32_t>& cells) {
+    size_t row = seg->rowStarts.size();
+    seg->rowStarts.push_back(rowStart);
+    while (seg->columns.size() < cells.size()) {
+        seg->columns.push_back(std::vector<uint32_t>(row, CSV_NO_CELL));
+    }
+    for (size_t c = 0; c < seg->columns.size(); c++) {
+        seg->columns[c].push_back(c < cells.size() ? cells[c] : CSV_NO_CELL);
+    }
+}
+
+// Sizes the arrays from the average row length so far, so a big chunk does
+// not end with up to twice the memory it needs
+static void ReserveRows(CsvSegment* seg, size_t bytesSeen, size_t chunkBytes) {
+    size_t rows = seg->rowStarts.size();
+    size_t expected = (size_t)((double)chunkBytes * rows / bytesSeen * 1.05) + 64;
+    seg->rowStarts.reserve(expected);
+    for (size_t c = 0; c < seg->columns.size(); c++) seg->columns[c].reserve(expected);
+}
+
+// Parses the rows that start in [from, stopAt). Unless this is the first
+// chunk, 'from' may be mid-row, so everything up to the first row break is
+// left to the previous chunk. The last row may run past 'stopAt'.
+static bool ParseChunk(const char* data, size_t size, size_t from, size_t stopAt, bool inQuote,
+                       bool first, char delimiter, const std::atomic<bool>* cancel, CsvSegment* seg) {
+    char tail[BLOCK];
+    std::vector<uint32_t> cells;
+    if (first) cells.assign(1, 0);
+    bool skipping = !first;
+    size_t rowStart = from;
+    uint64_t quoteCarry = inQuote ? ~(uint64_t)0 : 0;
+
+    for (size_t pos = from; pos < size; pos += BLOCK) {
+        if ((pos & ((1 << 20) - 1)) < BLOCK && cancel && *cancel) return false;
+
+        BlockMasks m;
+        ScanBlock(BlockAt(data, size, pos, tail), delimiter, &m);
+        uint64_t inside = PrefixXor(m.quote) ^ quoteCarry;
+        quoteCarry = (uint64_t)0 - (inside >> 63);
+        uint64_t structural = (m.delimiter | m.newline) & ~inside;
+
+        while (structural) {
+            int bit = LowestBit(structural);
+            structural &= structural - 1;
+            size_t p = pos + bit;
+            if (p >= size) break;
+            if (!(m.newline & ((uint64_t)1 << bit))) {
+                if (!skipping) {
+                    if (p + 1 - rowStart > 0xFFFFFFFEu) return false;
+                    cells.push_back((uint32_t)(p + 1 - rowStart));
+                }
+                continue;
+            }
+
+            if (!skipping) {
+                PushRow(seg, rowStart, cells);
+                if (seg->rowStarts.size() == SAMPLE_ROWS) ReserveRows(seg, p + 1 - from, stopAt - from);
+                if (p >= stopAt) {
+                    seg->end = p + 1;
+                    return true;
+                }
+            } else if (p >= stopAt) {
+                // One row covers this whole chunk; the previous chunk has it
+                seg->end = from;
+                return true;
+            }
+            skipping = false;
+            rowStart = p + 1;
+            cells.assign(1, 0);
+        }
+    }
+
+    if (!skipping && rowStart < size) PushRow(seg, rowStart, cells);
+    seg->end = size;
+    return true;
+}
+
+bool CsvTable_Parse(CsvTable* table, const char* data, size_t size, char delimiter,
+                    const std::atomic<bool>* cancel) {
+    if (!table) return false;
+    *table = CsvTable();
+    table->data = data;
+    table->size = size;
+    table->delimiter = delimiter;
+    if (!data || size == 0) return true;
+
+    size_t chunkSize = std::max(MIN_CHUNK, size / (4 * (size_t)ThreadPool_Size()) + 1);
+    chunkSize = (chunkSize + BLOCK - 1) & ~(BLOCK - 1);
+    size_t chunks = (size + chunkSize - 1) / chunkSize;
+
+    // Pass one: quotes per chunk, whose running parity says whether each
+    // chunk starts inside a quoted field
+    std::vector<size_t> quotes(chunks, 0);
+    if (chunks > 1) {
+        TaskLatch latch(chunks - 1);
+        for (size_t i = 0; i + 1 < chunks; i++) {
+            ThreadPool_Submit([&, i](int) {
+                quotes[i] = CountQuotes(data, size, i * chunkSize, (i + 1) * chunkSize);
+                latch.Finish();
+            });
+        }
+        latch.Wait();
+    }
+
+    // Pass two: rows, a segment per chunk
+    table->segments.resize(chunks);
+    std::vector<char> ok(chunks, 0);
+    {
+        TaskLatch latch(chunks);
+        size_t parity = 0;
+        for (size_t i = 0; i < chunks; i++) {
+            bool inQuote = (parity & 1) != 0;
+            parity += quotes[i];
+            ThreadPool_Submit([&, i, inQuote](int) {
+                size_t from = i * chunkSize;
+                size_t stopAt = std::min(size, from + chunkSize);
+                ok[i] = ParseChunk(data, size, from, stopAt, inQuote, i == 0, delimiter, cancel,
+                                   &table->segments[i]);
+                latch.Finish();
+            });
+        }
+        latch.Wait();
+    }
+
+    for (size_t i = 0; i < chunks; i++) {
+        if (!ok[i]) {
+            *table = CsvTable();
+            return false;
+        }
+        CsvSegment& seg = table->segments[i];
+        seg.firstRow = table->rows;
+        table->rows += seg.rowStarts.size();
+        table->columnCount = std::max(table->columnCount, seg.columns.size());
+    }
+    // Chunks swallowed by a row that started earlier have nothing to look up
+    table->segments.erase(std::remove_if(table->segments.begin(), table->segments.end(),
+                                         [](const CsvSegment& seg) { return seg.rowStarts.empty(); }),
+                          table->segments.end());
+    return true;
+}
+
+static const CsvSegment* FindSegment(const CsvTable* table, size_t row) {
+    if (!table || row >= table->rows) return NULL;
+    std::vector<CsvSegment>::const_iterator it = std::upper_bound(
+        table->segments.begin(), table->segments.end(), row,
+        [](size_t r, const CsvSegment& seg) { return r < seg.firstRow; });
+    return it == table->segments.begin() ? NULL : &*(it - 1);
+}
+
+std::string_view CsvTable_RawCell(const CsvTable* table, size_t row, size_t column) {
+    const CsvSegment* seg = FindSegment(table, row);
+    if (!seg || column >= seg->columns.size()) return std::string_view();
+    size_t r = row - seg->firstRow;
+    uint32_t offset = seg->columns[column][r];
+    if (offset == CSV_NO_CELL) return std::string_view();
+
+    size_t rowStart = (size_t)seg->rowStarts[r];
+    size_t end = r + 1 < seg->rowStarts.size() ? (size_t)seg->rowStarts[r + 1] : seg->end;
+    if (end > rowStart && table->data[end - 1] == '\n') end--;
+    if (end > rowStart && table->data[end - 1] == '\r') end--;
+    if (column + 1 < seg->columns.size() && seg->columns[column + 1][r] != CSV_NO_CELL) {
+        end = rowStart + seg->columns[column + 1][r] - 1;
+    }
+    size_t start = rowStart + offset;
+    return std::string_view(table->data + start, end > start ? end - start : 0);
+}
+
+void CsvTable_CellText(const CsvTable* table, size_t row, size_t column, std::string* out) {
+    std::string_view raw = CsvTable_RawCell(table, row, column);
+    if (raw.empty() || raw[0] != '"') {
+        out->append(raw.data(), raw.size());
+        return;
+    }
+    // Anything after the closing quote is kept as written, like Python's csv
+    size_t i = 1;
+    while (i < raw.size()) {
+        size_t quote = raw.find('"', i);
+        if (quote == std::string_view::npos) quote = raw.size();
+        out->append(raw.data() + i, quote - i);
+        if (quote + 1 < raw.size() && raw[quote + 1] == '"') {
+            out->push_back('"');
+            i = quote + 2;
+        } else {
+            out->append(raw.data() + std::min(raw.size(), quote + 1),
+                        raw.size() - std::min(raw.size(), quote + 1));
+            break;
+        }
+    }
+}
+
+size_t CsvTable_RowAt(const CsvTable* table, size_t offset) {
+    if (!table || table->rows == 0) return 0;
+    std::vector<CsvSegment>::const_iterator it = std::upper_bound(
+        table->segments.begin(), table->segments.end(), offset,
+        [](size_t off, const CsvSegment& seg) { return off < seg.end; });
+    // Segments without rows own no bytes worth finding
+    while (it != table->segments.end() && it->rowStarts.empty()) ++it;
+    if (it == table->segments.end()) return table->rows - 1;
+    size_t after = std::upper_bound(it->rowStarts.begin(), it->rowStarts.end(), (uint64_t)offset) -
+                   it->rowStarts.begin();
+    if (after == 0) return it->firstRow > 0 ? it->firstRow - 1 : 0;
+    return it->firstRow + after - 1;
+}
+
+size_t CsvTable_MemoryBytes(const CsvTable* table) {
+    if (!table) return 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < table->segments.size(); i++) {
+        const CsvSegment& seg = table->segments[i];
+        bytes += seg.rowStarts.capacity() * sizeof(uint64_t);
+        for (size_t c = 0; c < seg.columns.size(); c++) bytes += seg.columns[c].capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
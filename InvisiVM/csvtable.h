@@ -0,0 +1,53 @@
+#ifndef CSVTABLE_H
+#define CSVTABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Rows parsed by one chunk of the file. Cells are stored a column at a time
+// as 32-bit offsets from their row start, so a 1 GB file with ten columns
+// costs about 4 bytes per cell and 8 per row on top of the bytes themselves.
+struct CsvSegment {
+    size_t firstRow;
+    size_t end;                      // offset just past the segment's last row
+    std::vector<uint64_t> rowStarts;
+    // columns[c][r]; CSV_NO_CELL for a row with fewer cells. A segment may
+    // have fewer columns than the table.
+    std::vector<std::vector<uint32_t>> columns;
+};
+
+static const uint32_t CSV_NO_CELL = 0xFFFFFFFFu;
+
+// RFC 4180 table over a buffer the caller keeps alive, typically a mapped
+// file. Cells are views of the raw bytes; quotes are only undone on access.
+struct CsvTable {
+    const char* data;
+    size_t size;
+    char delimiter;
+    size_t rows;
+    size_t columnCount;
+    std::vector<CsvSegment> segments;
+
+    CsvTable() : data(NULL), size(0), delimiter(','), rows(0), columnCount(0) {}
+};
+
+// Splits the buffer into chunks parsed on the thread pool; the quote state
+// at each chunk start comes from a first pass counting quotes. Must not be
+// called from a pool thread. Fails if 'cancel' is set or a row passes 4 GB.
+bool CsvTable_Parse(CsvTable* table, const char* data, size_t size, char delimiter,
+                    const std::atomic<bool>* cancel);
+// Cell as it appears in the file, surrounding quotes included. Empty for a
+// cell the row does not have.
+std::string_view CsvTable_RawCell(const CsvTable* table, size_t row, size_t column);
+// Appends the cell's value with quotes removed and "" turned into "
+void CsvTable_CellText(const CsvTable* table, size_t row, size_t column, std::string* out);
+// Row holding byte 'offset' of the data
+size_t CsvTable_RowAt(const CsvTable* table, size_t offset);
+// Heap held by the offset arrays
+size_t CsvTable_MemoryBytes(const CsvTable* table);
+
+#endif
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include "damage.h"
+
+static bool IsEmpty(const RECT& rect) {
+    return rect.right <= rect.left || rect.bottom <= rect.top;
+}
+
+// Sharing an edge counts, so a strip next to a strip becomes one
+static bool Touch(const RECT& a, const RECT& b) {
+    return a.left <= b.right && b.left <= a.right && a.top <= b.bottom && b.top <= a.bottom;
+}
+
+static RECT Union(const RECT& a, const RECT& b) {
+    return {std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right),
+            std::max(a.bottom, b.bottom)};
+}
+
+static int64_t Area(const RECT& rect) {
+    return (int64_t)(rect.right - rect.left) * (rect.bottom - rect.top);
+}
+
+// Merges 'rect' with everything it touches. A merge can grow it into
+// rectangles it missed before, so the list is walked until nothing joins.
+static void Insert(std::vector<RECT>& rects, RECT rect) {
+    for (size_t i = 0; i < rects.size();) {
+        if (Touch(rects[i], rect)) {
+            rect = Union(rects[i], rect);
+            rects[i] = rects.back();
+            rects.pop_back();
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+    rects.push_back(rect);
+}
+
+void Damage_Add(DamageRegion* damage, const RECT& rect) {
+    if (!damage || IsEmpty(rect)) return;
+    Insert(damage->rects, rect);
+
+    while (damage->rects.size() > DAMAGE_MAX_RECTS) {
+        std::vector<RECT>& rects = damage->rects;
+        size_t bestA = 0, bestB = 1;
+        int64_t bestGrowth = INT64_MAX;
+        for (size_t a = 0; a < rects.size(); a++) {
+            for (size_t b = a + 1; b < rects.size(); b++) {
+                int64_t growth = Area(Union(rects[a], rects[b])) - Area(rects[a]) - Area(rects[b]);
+                if (growth < bestGrowth) {
+                    bestGrowth = growth;
+                    bestA = a;
+                    bestB = b;
+                }
+            }
+        }
+        RECT merged = Union(rects[bestA], rects[bestB]);
+        rects.erase(rects.begin() + bestB);
+        rects.erase(rects.begin() + bestA);
+        Insert(rects, merged);
+    }
+}
+
+void Damage_Clear(DamageRegion* damage) {
+    if (damage) damage->rects.clear();
+}
+
+bool Damage_Empty(const DamageRegion* damage) {
+    return !damage || damage->rects.empty();
+}
+
+int64_t Damage_Area(const DamageRegion* damage) {
+    if (!damage) return 0;
+    int64_t area = 0;
+    for (const RECT& rect : damage->rects) area += Area(rect);
+    return area;
+}
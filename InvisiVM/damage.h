@@ -0,0 +1,25 @@
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+#include <cstdint>
+#include <vector>
+#include "platform.h"
+
+// Parts of a window that need drawing again. Whatever changes on screen
+// adds the rectangle it covers; rectangles that overlap or touch are
+// merged as they come, so each pixel is drawn once per paint.
+struct DamageRegion {
+    std::vector<RECT> rects;  // none overlap or touch; at most DAMAGE_MAX_RECTS
+};
+
+// Past this many, the two rectangles whose union adds least are merged
+const size_t DAMAGE_MAX_RECTS = 8;
+
+// Empty rectangles are ignored
+void Damage_Add(DamageRegion* damage, const RECT& rect);
+void Damage_Clear(DamageRegion* damage);
+bool Damage_Empty(const DamageRegion* damage);
+// Pixels covered
+int64_t Damage_Area(const DamageRegion* damage);
+
+#endif
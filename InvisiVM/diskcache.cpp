@@ -0,0 +1,297 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "diskcache.h"
+
+#ifdef _WIN32
+static const char SEP = '\\';
+#else
+static const char SEP = '/';
+#endif
+
+static const uint64_t MAX_CACHE_BYTES = 256ull << 20;
+static const size_t SAMPLE_BYTES = 64 << 10;  // from each end of the source
+// Bumped when an extractor's output changes, so older entries are ignored
+static const char MAGIC[8] = {'I', 'V', 'M', 'C', 'A', 'C', 'H', '3'};
+
+// Entry layout: header, text, padding to 8 bytes, the line starts, padding
+// to 8 bytes, then the first line of each page as 64-bit values
+struct CacheHeader {
+    char magic[8];
+    uint64_t key;
+    uint64_t textSize;
+    uint64_t startCount;
+    uint32_t startWidth;  // 4 or 8 bytes per line start
+    uint32_t pageCount;
+};
+
+static std::atomic<unsigned> g_tempCounter(0);
+
+static uint64_t Hash(uint64_t hash, const void* data, size_t size) {
+    // FNV-1a
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static size_t IndexOffset(uint64_t textSize) {
+    return (size_t)((sizeof(CacheHeader) + textSize + 7) & ~(uint64_t)7);
+}
+
+static size_t PagesOffset(const CacheHeader& header) {
+    return (size_t)((IndexOffset(header.textSize) + header.startCount * header.startWidth + 7) & ~(uint64_t)7);
+}
+
+// Identity of the source file as it is right now. The content sample
+// catches rewrites that keep the size and the timestamp.
+static bool ComputeKey(const char* path, uint64_t* key) {
+    uint64_t size, mtime;
+    if (!MapFile_Stamp(path, &size, &mtime)) return false;
+    MappedFile source;
+    if (!MapFile_Open(path, &source)) return false;
+
+    uint64_t hash = 0xCBF29CE484222325ull;
+    hash = Hash(hash, path, strlen(path));
+    hash = Hash(hash, &size, sizeof(size));
+    hash = Hash(hash, &mtime, sizeof(mtime));
+    size_t head = std::min(source.size, SAMPLE_BYTES);
+    hash = Hash(hash, source.data, head);
+    if (source.size > head) {
+        size_t tail = std::min(source.size - head, SAMPLE_BYTES);
+        hash = Hash(hash, source.data + source.size - tail, tail);
+    }
+    MapFile_Close(&source);
+    *key = hash;
+    return true;
+}
+
+static std::string CacheDir() {
+#ifdef _WIN32
+    const char* base = getenv("LOCALAPPDATA");
+    if (!base || !*base) return "";
+    return std::string(base) + "\\InvisiVM\\cache";
+#else
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) return std::string(xdg) + "/invisivm";
+    const char* home = getenv("HOME");
+    if (!home || !*home) return "";
+    return std::string(home) + "/.cache/invisivm";
+#endif
+}
+
+static bool MakeDirs(const std::string& dir) {
+    for (size_t i = 1; i <= dir.size(); i++) {
+        if (i < dir.size() && dir[i] != SEP) continue;
+        std::string part = dir.substr(0, i);
+#ifdef _WIN32
+        if (part.size() == 2 && part[1] == ':') continue;  // drive letter
+        if (!CreateDirectoryA(part.c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS) return false;
+#else
+        if (mkdir(part.c_str(), 0700) != 0 && errno != EEXIST) return false;
+#endif
+    }
+    return true;
+}
+
+static std::string EntryPath(const std::string& dir, uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.ivc", (unsigned long long)key);
+    return dir + SEP + name;
+}
+
+// Recency for eviction is the entry's modification time
+static void Touch(const std::string& path) {
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(handle, NULL, NULL, &now);
+    CloseHandle(handle);
+#else
+    utimensat(AT_FDCWD, path.c_str(), NULL, 0);
+#endif
+}
+
+struct DirEntry {
+    std::string path;
+    uint64_t size;
+    uint64_t mtime;
+};
+
+static void ListEntries(const std::string& dir, std::vector<DirEntry>* entries) {
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &found);
+    if (find == INVALID_HANDLE_VALUE) return;
+    do {
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        DirEntry entry;
+        entry.path = dir + SEP + found.cFileName;
+        entry.size = ((uint64_t)found.nFileSizeHigh << 32) | found.nFileSizeLow;
+        entry.mtime = ((uint64_t)found.ftLastWriteTime.dwHighDateTime << 32) | found.ftLastWriteTime.dwLowDateTime;
+        entries->push_back(entry);
+    } while (FindNextFileA(find, &found));
+    FindClose(find);
+#else
+    DIR* handle = opendir(dir.c_str());
+    if (!handle) return;
+    while (struct dirent* found = readdir(handle)) {
+        if (found->d_name[0] == '.') continue;
+        DirEntry entry;
+        entry.path = dir + SEP + found->d_name;
+        struct stat st;
+        if (stat(entry.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        entry.size = (uint64_t)st.st_size;
+        entry.mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+        entries->push_back(entry);
+    }
+    closedir(handle);
+#endif
+}
+
+// Deletes the least recently used entries until the cache fits its budget.
+// An entry another viewer still has mapped cannot be deleted on Windows and
+// is simply skipped.
+static void Trim(const std::string& dir) {
+    std::vector<DirEntry> entries;
+    ListEntries(dir, &entries);
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < entries.size(); i++) total += entries[i].size;
+    if (total <= MAX_CACHE_BYTES) return;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const DirEntry& a, const DirEntry& b) { return a.mtime < b.mtime; });
+    for (size_t i = 0; i < entries.size() && total > MAX_CACHE_BYTES; i++) {
+        if (remove(entries[i].path.c_str()) == 0) total -= entries[i].size;
+    }
+}
+
+bool DiskCache_Lookup(const char* path, CachedText* entry, LineIndex* index) {
+    if (!path || !entry || !index) return false;
+
+    std::string dir = CacheDir();
+    uint64_t key;
+    if (dir.empty() || !ComputeKey(path, &key)) return false;
+
+    std::string entryPath = EntryPath(dir, key);
+    MappedFile file;
+    if (!MapFile_Open(entryPath.c_str(), &file)) return false;
+
+    CacheHeader header;
+    bool valid = file.size >= sizeof(header);
+    if (valid) {
+        memcpy(&header, file.data, sizeof(header));
+        valid = memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.key == key &&
+                (header.startWidth == 4 || header.startWidth == 8) &&
+                header.textSize <= file.size &&
+                header.startCount <= file.size / header.startWidth &&
+                IndexOffset(header.textSize) + header.startCount * header.startWidth <= file.size &&
+                PagesOffset(header) + (uint64_t)header.pageCount * 8 == file.size;
+    }
+    if (!valid) {
+        MapFile_Close(&file);
+        return false;
+    }
+
+    // The starts are 8-byte aligned within a page-aligned view
+    const char* starts = file.data + IndexOffset(header.textSize);
+    LineIndex_Reset(index);
+    if (header.startWidth == 4) {
+        const uint32_t* begin = (const uint32_t*)starts;
+        index->starts32.assign(begin, begin + header.startCount);
+    } else {
+        const uint64_t* begin = (const uint64_t*)starts;
+        index->starts64.assign(begin, begin + header.startCount);
+    }
+    index->scanned = (size_t)header.textSize;
+
+    const uint64_t* pages = (const uint64_t*)(file.data + PagesOffset(header));
+    entry->pageLines.assign(pages, pages + header.pageCount);
+    entry->file = file;
+    entry->textOffset = sizeof(CacheHeader);
+    entry->textSize = (size_t)header.textSize;
+    Touch(entryPath);
+    return true;
+}
+
+bool DiskCache_Store(const char* path, const std::string& text, const std::vector<size_t>* pageLines) {
+    if (!path) return false;
+
+    std::string dir = CacheDir();
+    uint64_t key;
+    if (dir.empty() || !ComputeKey(path, &key) || !MakeDirs(dir)) return false;
+
+    LineIndex index;
+    LineIndex_Update(&index, text.data(), text.size());
+    bool wide = !index.starts64.empty();
+
+    CacheHeader header = {};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.key = key;
+    header.textSize = text.size();
+    header.startCount = wide ? index.starts64.size() : index.starts32.size();
+    header.startWidth = wide ? 8 : 4;
+    std::vector<uint64_t> pages;
+    if (pageLines) pages.assign(pageLines->begin(), pageLines->end());
+    header.pageCount = (uint32_t)pages.size();
+
+    std::string entryPath = EntryPath(dir, key);
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    char suffix[48];
+    snprintf(suffix, sizeof(suffix), ".%lu.%u.tmp", pid, g_tempCounter++);
+    std::string tempPath = entryPath + suffix;
+
+    FILE* out = fopen(tempPath.c_str(), "wb");
+    if (!out) return false;
+    static const char padding[8] = {};
+    size_t padSize = IndexOffset(text.size()) - sizeof(header) - text.size();
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+              fwrite(text.data(), 1, text.size(), out) == text.size() &&
+              fwrite(padding, 1, padSize, out) == padSize;
+    if (ok && wide) {
+        ok = fwrite(index.starts64.data(), 8, index.starts64.size(), out) == index.starts64.size();
+    } else if (ok) {
+        ok = fwrite(index.starts32.data(), 4, index.starts32.size(), out) == index.starts32.size();
+    }
+    padSize = PagesOffset(header) - IndexOffset(header.textSize) - header.startCount * header.startWidth;
+    ok = ok && fwrite(padding, 1, padSize, out) == padSize &&
+         fwrite(pages.data(), 8, pages.size(), out) == pages.size();
+    ok = fclose(out) == 0 && ok;
+
+#ifdef _WIN32
+    // Fails while another viewer maps the old entry; theirs is just as good
+    ok = ok && MoveFileExA(tempPath.c_str(), entryPath.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(tempPath.c_str(), entryPath.c_str()) == 0;
+#endif
+    if (!ok) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    Trim(dir);
+    return true;
+}
@@ -0,0 +1,30 @@
+#ifndef DISKCACHE_H
+#define DISKCACHE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "lineindex.h"
+#include "mapfile.h"
+
+// Persistent cache of extracted text, one file per document under the
+// user's local cache directory. Entries are keyed by a hash of the path,
+// size, modification time and a sample of the contents, hold the text and
+// its line index ready to map, and are evicted least recently used first.
+struct CachedText {
+    MappedFile file;
+    size_t textOffset;  // text bytes within file.data
+    size_t textSize;
+    std::vector<size_t> pageLines;  // first line of each page; empty if unpaged
+
+    CachedText() : textOffset(0), textSize(0) {}
+};
+
+// On a hit maps the entry, fills 'index' and marks the entry as used
+bool DiskCache_Lookup(const char* path, CachedText* entry, LineIndex* index);
+// Writes to a temporary file and renames it into place, so a viewer never
+// maps a half written entry. Trims the cache afterwards. 'pageLines' may be
+// NULL for a document without pages.
+bool DiskCache_Store(const char* path, const std::string& text, const std::vector<size_t>* pageLines);
+
+#endif
@@ -0,0 +1,416 @@
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#include "docstore.h"
+#include "diskcache.h"
+#include "threadpool.h"
+
+// Mapped documents are indexed this much at a time as the view moves down
+static const size_t INDEX_CHUNK = 4 << 20;
+static const size_t DEFAULT_BUDGET = 512u << 20;
+// Smaller documents are searched by reading them through, which takes a few
+// milliseconds at most
+static const size_t INDEX_MIN_BYTES = 8 << 20;
+// Search index blocks built by one pool task
+static const size_t INDEX_TASK_BLOCKS = 64;
+
+struct IdleDoc {
+    std::shared_ptr<Document> doc;
+    size_t bytes;
+};
+
+// Lock order is store, then document. Loader callbacks only ever take the
+// document lock, and documents are destroyed with neither lock held since
+// the destructor waits for the loader to let go.
+struct DocStore {
+    std::mutex lock;
+    std::unordered_map<std::string, std::shared_ptr<Document>> docs;
+    std::list<IdleDoc> idle;  // no window uses these; most recent first
+    size_t idleBytes;
+    size_t budget;
+
+    DocStore() : idleBytes(0), budget(DEFAULT_BUDGET) {}
+};
+
+static DocStore g_store;
+
+Document::Document()
+    : sourceSize(0), sourceTime(0), mappedStart(0), mappedSize(0), encoding(TEXT_UTF8),
+      loading(false), failed(false), loadDone(0), loadTotal(0), pageCount(0), job(NULL), indexing(false) {}
+
+Document::~Document() {
+    // After Loader_Cancel returns the loader never calls back into us
+    if (job) Loader_Cancel(job);
+    MapFile_Close(&mapped);
+}
+
+static void NotifyLocked(Document* doc) {
+    for (size_t i = 0; i < doc->observers.size(); i++) doc->observers[i]->OnDocumentChanged();
+}
+
+// A search index under construction. Each task holds the document only
+// while it works, so once the last window lets go the rest are skipped, and
+// the last task to finish hands the index over.
+struct IndexBuild {
+    std::weak_ptr<Document> doc;
+    std::shared_ptr<SearchIndex> index;
+    std::atomic<size_t> remaining;
+};
+
+static void IndexBlocks(const std::shared_ptr<IndexBuild>& build, size_t first) {
+    std::shared_ptr<Document> doc = build->doc.lock();
+    if (doc) {
+        // The text no longer changes once loading is over
+        size_t size;
+        const char* text = Doc_SearchText(doc.get(), &size);
+        SearchIndex_Build(build->index.get(), text, first, first + INDEX_TASK_BLOCKS);
+    }
+    if (--build->remaining > 0 || !doc) return;
+    std::lock_guard<std::mutex> guard(doc->lock);
+    doc->search = build->index;
+    doc->indexing = false;
+    NotifyLocked(doc.get());
+}
+
+// Called with the lock held once the document has loaded
+static void StartIndex(Document* doc) {
+    size_t size;
+    Doc_SearchText(doc, &size);
+    if (doc->failed || doc->search || doc->indexing || size < INDEX_MIN_BYTES) return;
+
+    std::shared_ptr<IndexBuild> build = std::make_shared<IndexBuild>();
+    build->doc = doc->weak_from_this();
+    build->index = std::make_shared<SearchIndex>();
+    SearchIndex_Init(build->index.get(), size);
+    size_t blocks = SearchIndex_Blocks(build->index.get());
+    build->remaining = (blocks + INDEX_TASK_BLOCKS - 1) / INDEX_TASK_BLOCKS;
+    doc->indexing = true;
+    for (size_t first = 0; first < blocks; first += INDEX_TASK_BLOCKS) {
+        ThreadPool_Submit([build, first](int) { IndexBlocks(build, first); });
+    }
+}
+
+void Document::OnChunk(std::string& chunk) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (text.empty()) {
+        text.swap(chunk);
+    } else {
+        text += chunk;
+    }
+    // Only the bytes appended since the last chunk are scanned
+    LineIndex_Update(&lines, text.data(), text.size());
+    NotifyLocked(this);
+}
+
+void Document::OnPages(const std::vector<size_t>& firstLines, int total) {
+    std::lock_guard<std::mutex> guard(lock);
+    pageLines.insert(pageLines.end(), firstLines.begin(), firstLines.end());
+    pageCount = total;
+    NotifyLocked(this);
+}
+
+void Document::OnTable(std::unique_ptr<LoadedTable>& loaded) {
+    std::lock_guard<std::mutex> guard(lock);
+    table.swap(loaded);
+    encoding = table->encoding;
+    NotifyLocked(this);
+}
+
+void Document::OnProgress(int done, int total) {
+    std::lock_guard<std::mutex> guard(lock);
+    loadDone = done;
+    loadTotal = total;
+    NotifyLocked(this);
+}
+
+void Document::OnFinished(bool ok, const std::string& message) {
+    std::lock_guard<std::mutex> guard(lock);
+    loading = false;
+    if (!ok) {
+        text = message;
+        LineIndex_Reset(&lines);
+        LineIndex_Update(&lines, text.data(), text.size());
+        pageLines.clear();
+        pageCount = 0;
+        failed = true;
+    }
+    StartIndex(this);
+    NotifyLocked(this);
+}
+
+const char* Doc_Text(const Document* doc, size_t* size) {
+    if (doc->mapped.data) {
+        *size = doc->mappedSize;
+        return doc->mapped.data + doc->mappedStart;
+    }
+    *size = doc->text.size();
+    return doc->text.data();
+}
+
+void Doc_IndexThrough(Document* doc, size_t needed) {
+    // A PDF being extracted on demand only goes as far as someone reads
+    if (doc->loading && doc->job) Loader_Request(doc->job, needed);
+    if (!doc->mapped.data) return;
+    size_t size;
+    const char* text = Doc_Text(doc, &size);
+    while (doc->lines.scanned < size && LineIndex_Count(&doc->lines, size) <= needed) {
+        LineIndex_Update(&doc->lines, text, std::min(size, doc->lines.scanned + INDEX_CHUNK));
+    }
+}
+
+// Before the whole text is indexed the rest is assumed to have the same
+// average line length as the part already seen, and pages not extracted
+// yet the same number of lines as those that are
+size_t Doc_EstimatedLineCount(const Document* doc) {
+    if (doc->table) return doc->table->table.rows;
+    size_t size;
+    Doc_Text(doc, &size);
+    size_t count = LineIndex_Count(&doc->lines, size);
+    if (doc->loading && doc->loadDone > 0 && doc->loadTotal > doc->loadDone) {
+        return (size_t)((double)count * doc->loadTotal / doc->loadDone);
+    }
+    size_t scanned = doc->lines.scanned;
+    if (scanned >= size || scanned == 0) return count;
+    return count + (size_t)((double)(size - scanned) * count / scanned);
+}
+
+size_t Doc_LineCount(const Document* doc) {
+    if (doc->table) return doc->table->table.rows;
+    size_t size;
+    Doc_Text(doc, &size);
+    return LineIndex_Count(&doc->lines, size);
+}
+
+const char* Doc_SearchText(const Document* doc, size_t* size) {
+    if (doc->table) {
+        *size = doc->table->table.size;
+        return doc->table->table.data;
+    }
+    return Doc_Text(doc, size);
+}
+
+size_t Doc_LineAtOffset(Document* doc, size_t offset) {
+    if (doc->table) return CsvTable_RowAt(&doc->table->table, offset);
+    size_t size;
+    const char* text = Doc_Text(doc, &size);
+    if (doc->mapped.data && doc->lines.scanned <= offset) {
+        // Past the end of the index; take in whole chunks like Doc_IndexThrough
+        size_t chunks = (offset + 1 - doc->lines.scanned + INDEX_CHUNK - 1) / INDEX_CHUNK;
+        LineIndex_Update(&doc->lines, text, std::min(size, doc->lines.scanned + chunks * INDEX_CHUNK));
+    }
+    return LineIndex_LineAt(&doc->lines, offset);
+}
+
+size_t Doc_PageAtLine(const Document* doc, size_t line) {
+    std::vector<size_t>::const_iterator it = std::upper_bound(doc->pageLines.begin(), doc->pageLines.end(), line);
+    return it == doc->pageLines.begin() ? 0 : (size_t)(it - doc->pageLines.begin()) - 1;
+}
+
+std::string_view Doc_Line(const Document* doc, size_t i, std::string* scratch) {
+    if (doc->table) {
+        const CsvTable* table = &doc->table->table;
+        scratch->clear();
+        for (size_t c = 0; c < table->columnCount; c++) {
+            if (c > 0) scratch->append(" | ");
+            CsvTable_CellText(table, i, c, scratch);
+        }
+        return *scratch;
+    }
+    size_t size;
+    const char* text = Doc_Text(doc, &size);
+    return LineIndex_Line(&doc->lines, text, size, i);
+}
+
+// Heap held by a document. Mapped text is left out; the OS can drop those
+// pages at any time.
+static size_t MemoryBytes(const Document* doc) {
+    size_t bytes = doc->text.capacity() + doc->lines.starts32.capacity() * sizeof(uint32_t) +
+                   doc->lines.starts64.capacity() * sizeof(uint64_t) + doc->pageLines.capacity() * sizeof(size_t);
+    if (doc->table) bytes += doc->table->text.capacity() + CsvTable_MemoryBytes(&doc->table->table);
+    return bytes + SearchIndex_MemoryBytes(doc->search.get());
+}
+
+// Takes over a mapped text file. UTF-16 is converted to UTF-8 up front since
+// the line index looks for '\n' bytes; everything else is viewed in place.
+static void AdoptMappedText(Document* doc, MappedFile* mapped) {
+    size_t bomSize;
+    TextEncoding encoding = TextEnc_Detect(mapped->data, mapped->size, &bomSize);
+    if (encoding == TEXT_UTF16LE || encoding == TEXT_UTF16BE) {
+        TextEnc_UTF16ToUTF8(mapped->data + bomSize, mapped->size - bomSize,
+                            encoding == TEXT_UTF16BE, &doc->text);
+        MapFile_Close(mapped);
+        LineIndex_Update(&doc->lines, doc->text.data(), doc->text.size());
+        return;
+    }
+    doc->mapped = *mapped;
+    doc->mappedStart = bomSize;
+    doc->mappedSize = mapped->size - bomSize;
+    doc->encoding = encoding;
+}
+
+static void StartLoad(const std::shared_ptr<Document>& doc, const char* path, const char* expectedType) {
+    bool typeMatches = !expectedType || Loader_HasExtension(path, expectedType);
+    bool isText = Loader_HasExtension(path, "txt");
+    // Tables are parsed natively from the file, which is quicker than the cache
+    bool isTable = Loader_HasExtension(path, "csv") || Loader_HasExtension(path, "tsv") ||
+                   Loader_HasExtension(path, "xlsx");
+
+    // Plain text is shown straight from the file and indexed as it scrolls,
+    // so even a multi-GB log opens instantly
+    if (typeMatches && isText) {
+        MappedFile mapped;
+        if (MapFile_Open(path, &mapped)) {
+            std::lock_guard<std::mutex> guard(doc->lock);
+            AdoptMappedText(doc.get(), &mapped);
+            doc->loading = false;
+            StartIndex(doc.get());
+            NotifyLocked(doc.get());
+            return;
+        }
+    }
+
+    // Anything extracted before comes back from the disk cache, text and
+    // line index both, without parsing the document again
+    if (typeMatches && !isText && !isTable) {
+        std::lock_guard<std::mutex> guard(doc->lock);
+        CachedText cached;
+        if (DiskCache_Lookup(path, &cached, &doc->lines)) {
+            doc->mapped = cached.file;
+            doc->mappedStart = cached.textOffset;
+            doc->mappedSize = cached.textSize;
+            doc->pageLines.swap(cached.pageLines);
+            doc->pageCount = (int)doc->pageLines.size();
+            doc->loading = false;
+            StartIndex(doc.get());
+            NotifyLocked(doc.get());
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(doc->lock);
+    doc->job = Loader_Start(path, expectedType, doc.get());
+}
+
+static void RemoveIdle(const std::shared_ptr<Document>& doc) {
+    for (std::list<IdleDoc>::iterator it = g_store.idle.begin(); it != g_store.idle.end(); ++it) {
+        if (it->doc == doc) {
+            g_store.idleBytes -= it->bytes;
+            g_store.idle.erase(it);
+            return;
+        }
+    }
+}
+
+// Pushes the least recently used idle documents out until the budget holds.
+// They are handed back to be destroyed once the store lock is released.
+static void TrimIdle(std::vector<std::shared_ptr<Document>>* evicted) {
+    while (g_store.idleBytes > g_store.budget && !g_store.idle.empty()) {
+        IdleDoc& oldest = g_store.idle.back();
+        g_store.docs.erase(oldest.doc->key);
+        g_store.idleBytes -= oldest.bytes;
+        evicted->push_back(oldest.doc);
+        g_store.idle.pop_back();
+    }
+}
+
+std::shared_ptr<Document> DocStore_Open(const char* path, const char* expectedType, DocObserver* observer) {
+    if (!path) return std::shared_ptr<Document>();
+
+    std::string key = path;
+    key.push_back('\n');
+    if (expectedType) key += expectedType;
+
+    uint64_t size = 0, mtime = 0;
+    MapFile_Stamp(path, &size, &mtime);
+
+    std::shared_ptr<Document> doc, stale;
+    {
+        std::lock_guard<std::mutex> guard(g_store.lock);
+        std::unordered_map<std::string, std::shared_ptr<Document>>::iterator it = g_store.docs.find(key);
+        if (it != g_store.docs.end()) {
+            std::shared_ptr<Document> existing = it->second;
+            std::lock_guard<std::mutex> docGuard(existing->lock);
+            // A failed load is retried and a file changed on disk is reread
+            if (!existing->failed && existing->sourceSize == size && existing->sourceTime == mtime) {
+                if (observer) existing->observers.push_back(observer);
+                RemoveIdle(existing);
+                return existing;
+            }
+            RemoveIdle(existing);
+            g_store.docs.erase(it);
+            stale = existing;
+        }
+
+        doc = std::make_shared<Document>();
+        doc->key = key;
+        doc->sourceSize = size;
+        doc->sourceTime = mtime;
+        doc->loading = true;
+        if (observer) doc->observers.push_back(observer);
+        g_store.docs[key] = doc;
+    }
+    // Windows still showing the old copy keep it alive until they let go
+    stale.reset();
+
+    StartLoad(doc, path, expectedType);
+    return doc;
+}
+
+std::shared_ptr<Document> DocStore_FromText(const std::string& text) {
+    std::shared_ptr<Document> doc = std::make_shared<Document>();
+    doc->text = text;
+    LineIndex_Update(&doc->lines, doc->text.data(), doc->text.size());
+    return doc;
+}
+
+void DocStore_Release(std::shared_ptr<Document>& doc, DocObserver* observer) {
+    if (!doc) return;
+
+    std::vector<std::shared_ptr<Document>> evicted;
+    {
+        std::lock_guard<std::mutex> guard(g_store.lock);
+        bool unused, loaded;
+        size_t bytes;
+        {
+            std::lock_guard<std::mutex> docGuard(doc->lock);
+            doc->observers.erase(std::remove(doc->observers.begin(), doc->observers.end(), observer),
+                                 doc->observers.end());
+            unused = doc->observers.empty();
+            loaded = !doc->loading && !doc->failed;
+            bytes = MemoryBytes(doc.get());
+        }
+
+        std::unordered_map<std::string, std::shared_ptr<Document>>::iterator it = g_store.docs.find(doc->key);
+        if (unused && it != g_store.docs.end() && it->second == doc) {
+            if (loaded) {
+                IdleDoc entry = {doc, bytes};
+                g_store.idle.push_front(entry);
+                g_store.idleBytes += bytes;
+                TrimIdle(&evicted);
+            } else {
+                // Nobody is waiting for this load any more; dropping the
+                // last reference below cancels it
+                g_store.docs.erase(it);
+            }
+        }
+    }
+    doc.reset();
+}
+
+void DocStore_SetBudget(size_t bytes) {
+    std::vector<std::shared_ptr<Document>> evicted;
+    std::lock_guard<std::mutex> guard(g_store.lock);
+    g_store.budget = bytes;
+    TrimIdle(&evicted);
+    // 'evicted' is destroyed after 'guard' unlocks
+}
+
+void DocStore_Shutdown() {
+    std::vector<std::shared_ptr<Document>> evicted;
+    std::lock_guard<std::mutex> guard(g_store.lock);
+    size_t budget = g_store.budget;
+    g_store.budget = 0;
+    TrimIdle(&evicted);
+    g_store.budget = budget;
+}
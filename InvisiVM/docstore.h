@@ -0,0 +1,97 @@
+#ifndef DOCSTORE_H
+#define DOCSTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "loader.h"
+#include "lineindex.h"
+#include "mapfile.h"
+#include "searchindex.h"
+#include "textenc.h"
+
+// Told whenever a document gains text, makes progress or finishes loading.
+// Called from the loader thread with the document's lock held, so it should
+// only flag the change and return.
+class DocObserver {
+public:
+    virtual ~DocObserver() {}
+    virtual void OnDocumentChanged() = 0;
+};
+
+// One extracted document, shared by every window showing the same file.
+// Fields below 'lock' are guarded by it while a load is running; windows
+// keep their own scroll position.
+struct Document : public LoadSink, public std::enable_shared_from_this<Document> {
+    std::string key;        // path and expected type; empty if not shared
+    uint64_t sourceSize;    // stamp of the file when it was opened
+    uint64_t sourceTime;
+
+    std::mutex lock;
+    std::string text;       // extracted text, unless 'mapped' is used
+    LineIndex lines;
+    MappedFile mapped;      // a text file or disk cache entry viewed in place
+    std::unique_ptr<LoadedTable> table;  // CSV and TSV, one line per row
+    size_t mappedStart;
+    size_t mappedSize;
+    TextEncoding encoding;
+    bool loading;
+    bool failed;
+    int loadDone;
+    int loadTotal;          // 0 while the amount of work is unknown
+    std::vector<size_t> pageLines;  // first line of each page extracted so far
+    int pageCount;          // 0 for a document without pages
+    std::vector<DocObserver*> observers;
+    LoadJob* job;
+    // Built on the thread pool once the text is final; never changes after
+    std::shared_ptr<const SearchIndex> search;
+    bool indexing;
+
+    Document();
+    ~Document();
+
+    void OnChunk(std::string& chunk) override;
+    void OnPages(const std::vector<size_t>& firstLines, int total) override;
+    void OnTable(std::unique_ptr<LoadedTable>& loaded) override;
+    void OnProgress(int done, int total) override;
+    void OnFinished(bool ok, const std::string& message) override;
+};
+
+// Returns the shared document for the file, starting a load if no window
+// has it open and it is not held in the idle cache. 'observer' is
+// registered before anything can be reported to it.
+std::shared_ptr<Document> DocStore_Open(const char* path, const char* expectedType, DocObserver* observer);
+// A private document holding fixed text, such as a placeholder message
+std::shared_ptr<Document> DocStore_FromText(const std::string& text);
+// Unregisters 'observer' and drops the caller's reference. A loaded document
+// no window uses stays cached until the memory budget pushes it out.
+void DocStore_Release(std::shared_ptr<Document>& doc, DocObserver* observer);
+// Bytes of text and index kept for documents no window uses
+void DocStore_SetBudget(size_t bytes);
+// Drops every idle document; call after the last window has closed
+void DocStore_Shutdown();
+
+// The helpers below expect the caller to hold doc->lock
+const char* Doc_Text(const Document* doc, size_t* size);
+// Indexes a mapped document until line 'needed' is known or the text ends,
+// and asks a PDF that is still being extracted for that much
+void Doc_IndexThrough(Document* doc, size_t needed);
+// Exact once the whole text is indexed, an extrapolation before that
+size_t Doc_EstimatedLineCount(const Document* doc);
+// Lines known so far
+size_t Doc_LineCount(const Document* doc);
+// Line i as drawn. A table row is built in 'scratch' with its cells joined
+// by " | " as program.py does.
+std::string_view Doc_Line(const Document* doc, size_t i, std::string* scratch);
+// The bytes a search looks through: the text, or a table's CSV source
+const char* Doc_SearchText(const Document* doc, size_t* size);
+// Line or table row holding byte 'offset' of Doc_SearchText, indexing a
+// mapped document that far if needed
+size_t Doc_LineAtOffset(Document* doc, size_t offset);
+// 0-based page holding line 'line', for a document with pageLines
+size_t Doc_PageAtLine(const Document* doc, size_t line);
+
+#endif
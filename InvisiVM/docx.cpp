@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <atomic>
+#include "docx.h"
+#include "opcpackage.h"
+
+// Turns WordprocessingML into lines as the elements go by. Text boxes and
+// the fallback copies of alternate content are skipped; python-docx leaves
+// them out as well.
+class DocumentReader : public XmlHandler {
+public:
+    std::atomic<bool> stopped;
+
+    DocumentReader(const DocxSink& sink, size_t chunkSize)
+        : stopped(false), sink(sink), chunkSize(chunkSize), skipDepth(0), runDepth(0), inText(false),
+          tableDepth(0), cells(0), cellParagraphs(0) {}
+
+    void OnStart(std::string_view name, const std::vector<XmlAttr>& attrs) override {
+        if (skipDepth > 0) {
+            skipDepth++;
+            return;
+        }
+        std::string_view local = Xml_LocalName(name);
+        if (local == "t") {
+            inText = true;
+        } else if (local == "r") {
+            runDepth++;
+        } else if (local == "p") {
+            paragraph.clear();
+        } else if (runDepth > 0 && (local == "tab" || local == "ptab")) {
+            paragraph.push_back('\t');
+        } else if (runDepth > 0 && local == "br") {
+            // Page and column breaks are not line breaks
+            std::string_view type = Xml_Attr(attrs, "type");
+            if (type.empty() || type == "textWrapping") paragraph.push_back('\n');
+        } else if (runDepth > 0 && local == "cr") {
+            paragraph.push_back('\n');
+        } else if (runDepth > 0 && local == "noBreakHyphen") {
+            paragraph.push_back('-');
+        } else if (local == "tbl") {
+            tableDepth++;
+        } else if (local == "tr" && tableDepth == 1) {
+            row.clear();
+            cells = 0;
+        } else if (local == "tc" && tableDepth == 1) {
+            if (cells > 0) row += " | ";
+            cells++;
+            cellParagraphs = 0;
+        } else if (local == "txbxContent" || local == "Fallback") {
+            skipDepth = 1;
+        }
+    }
+
+    void OnEnd(std::string_view name) override {
+        if (skipDepth > 0) {
+            skipDepth--;
+            return;
+        }
+        std::string_view local = Xml_LocalName(name);
+        if (local == "t") {
+            inText = false;
+        } else if (local == "r") {
+            runDepth--;
+        } else if (local == "p") {
+            EndParagraph();
+        } else if (local == "tbl") {
+            tableDepth--;
+        } else if (local == "tr" && tableDepth == 1) {
+            row.push_back('\n');
+            Emit(row);
+        }
+    }
+
+    void OnText(std::string_view text, bool cdata) override {
+        if (!inText || skipDepth > 0) return;
+        if (cdata) paragraph.append(text.data(), text.size());
+        else Xml_AppendText(text, &paragraph);
+    }
+
+    // Hands over whatever is left
+    void Finish() {
+        if (!pending.empty() && !stopped) stopped = !sink(pending);
+        pending.clear();
+    }
+
+private:
+    // Paragraphs in a table cell, nested tables included, run together on
+    // the row's line
+    void EndParagraph() {
+        if (tableDepth == 0) {
+            paragraph.push_back('\n');
+            Emit(paragraph);
+            return;
+        }
+        if (paragraph.empty()) return;
+        std::replace(paragraph.begin(), paragraph.end(), '\n', ' ');
+        if (cellParagraphs++ > 0) row.push_back(' ');
+        row += paragraph;
+    }
+
+    void Emit(const std::string& line) {
+        pending += line;
+        if (pending.size() < chunkSize || stopped) return;
+        stopped = !sink(pending);
+        pending.clear();
+    }
+
+    const DocxSink& sink;
+    size_t chunkSize;
+    std::string pending;    // finished lines not handed over yet
+    std::string paragraph;  // text of the paragraph being read
+    std::string row;        // the outermost table's current row
+    int skipDepth;          // elements open inside a skipped one
+    int runDepth;
+    bool inText;
+    int tableDepth;
+    size_t cells;
+    size_t cellParagraphs;
+};
+
+bool Docx_Extract(const char* path, const DocxSink& sink, size_t chunkSize, std::string* error) {
+    ZipArchive zip;
+    if (!Zip_Open(path, &zip)) {
+        if (error) *error = "Error: Not a valid DOCX file.";
+        return false;
+    }
+    std::string part = Opc_MainPart(&zip, "word/document.xml");
+    if (!Zip_Find(&zip, part)) {
+        Zip_Close(&zip);
+        if (error) *error = "Error: The DOCX file has no document.";
+        return false;
+    }
+
+    DocumentReader reader(sink, std::max<size_t>(chunkSize, 1));
+    bool ok = Opc_ParsePart(&zip, part, &reader, &reader.stopped, NULL);
+    reader.Finish();
+    Zip_Close(&zip);
+    if (!ok && error && !reader.stopped) *error = "Error: The DOCX file is damaged.";
+    return ok && !reader.stopped;
+}
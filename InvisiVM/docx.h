@@ -0,0 +1,22 @@
+#ifndef DOCX_H
+#define DOCX_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// Native DOCX text extraction. The main document is inflated and parsed in
+// pieces and never held whole, as XML or as a tree. Each paragraph becomes
+// a line and each table row its cells joined by " | ", the way CSV rows are
+// shown.
+
+// Receives finished lines; may take 'text'. Returning false stops.
+typedef std::function<bool(std::string& text)> DocxSink;
+
+// Calls 'sink' each time about 'chunkSize' bytes of lines are ready and once
+// more at the end. False if the file is not a readable DOCX, is damaged
+// part way (the lines before the damage have been delivered), or the sink
+// stopped.
+bool Docx_Extract(const char* path, const DocxSink& sink, size_t chunkSize, std::string* error);
+
+#endif
@@ -0,0 +1,168 @@
+#include <algorithm>
+#include "gdicanvas.h"
+
+static bool SameFont(const CanvasFont& a, const CanvasFont& b) {
+    return a.height == b.height && a.weight == b.weight && a.italic == b.italic && a.face == b.face;
+}
+
+void GdiCanvasMeasurer::Measure(wchar_t first, wchar_t last, int* advances) {
+    canvas->UseFont(font);
+    if (!GetCharWidth32W(canvas->hdc, first, last, advances)) std::fill(advances, advances + (last - first + 1), 0);
+}
+
+GdiCanvas::GdiCanvas(HDC hdc) : hdc(hdc), painting(false), paint(), clipped(false), clip() {
+    deviceFont = GetCurrentObject(hdc, OBJ_FONT);
+    measurer.canvas = this;
+    SetBkMode(hdc, TRANSPARENT);
+}
+
+GdiCanvas::~GdiCanvas() {
+    SelectObject(hdc, deviceFont);
+    for (size_t i = 0; i < fonts.size(); i++) DeleteObject(fonts[i].handle);
+}
+
+void GdiCanvas::UseFont(const CanvasFont& font) {
+    if (font.face.empty()) {
+        SelectObject(hdc, deviceFont);
+        return;
+    }
+    for (size_t i = 0; i < fonts.size(); i++) {
+        if (SameFont(fonts[i].font, font)) {
+            SelectObject(hdc, fonts[i].handle);
+            return;
+        }
+    }
+    HFONT handle = CreateFontW(font.height, 0, 0, 0, font.weight, font.italic ? TRUE : FALSE, FALSE, FALSE,
+                               DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY,
+                               DEFAULT_PITCH | FF_DONTCARE, font.face.c_str());
+    if (!handle) {
+        SelectObject(hdc, deviceFont);
+        return;
+    }
+    fonts.push_back({font, handle});
+    SelectObject(hdc, handle);
+}
+
+void GdiCanvas::FillRect(const RECT& rect, COLORREF color) {
+    HBRUSH brush = CreateSolidBrush(color);
+    if (!brush) return;
+    ::FillRect(hdc, &rect, brush);
+    DeleteObject(brush);
+}
+
+void GdiCanvas::StrokeRect(const RECT& rect, int penWidth, COLORREF color) {
+    HPEN pen = CreatePen(PS_SOLID, penWidth, color);
+    if (!pen) return;
+    HGDIOBJ oldPen = SelectObject(hdc, pen);
+    HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+    Rectangle(hdc, rect.left, rect.top, rect.right, rect.bottom);
+    SelectObject(hdc, oldBrush);
+    SelectObject(hdc, oldPen);
+    DeleteObject(pen);
+}
+
+void GdiCanvas::Line(int x0, int y0, int x1, int y1, int penWidth, COLORREF color) {
+    HPEN pen = CreatePen(PS_SOLID, penWidth, color);
+    if (!pen) return;
+    HGDIOBJ oldPen = SelectObject(hdc, pen);
+    MoveToEx(hdc, x0, y0, NULL);
+    LineTo(hdc, x1, y1);
+    SelectObject(hdc, oldPen);
+    DeleteObject(pen);
+}
+
+void GdiCanvas::FillEllipse(const RECT& rect, COLORREF fill, COLORREF outline) {
+    HBRUSH brush = CreateSolidBrush(fill);
+    if (!brush) return;
+    HPEN pen = CreatePen(PS_SOLID, 1, outline);
+    HGDIOBJ oldBrush = SelectObject(hdc, brush);
+    HGDIOBJ oldPen = SelectObject(hdc, pen ? (HGDIOBJ)pen : GetStockObject(BLACK_PEN));
+    Ellipse(hdc, rect.left, rect.top, rect.right, rect.bottom);
+    SelectObject(hdc, oldPen);
+    SelectObject(hdc, oldBrush);
+    if (pen) DeleteObject(pen);
+    DeleteObject(brush);
+}
+
+void GdiCanvas::StrokeEllipse(const RECT& rect, int penWidth, COLORREF color) {
+    HPEN pen = CreatePen(PS_SOLID, penWidth, color);
+    if (!pen) return;
+    HGDIOBJ oldPen = SelectObject(hdc, pen);
+    HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+    Ellipse(hdc, rect.left, rect.top, rect.right, rect.bottom);
+    SelectObject(hdc, oldBrush);
+    SelectObject(hdc, oldPen);
+    DeleteObject(pen);
+}
+
+void GdiCanvas::Text(const CanvasFont& font, COLORREF color, int x, int y, const wchar_t* text, size_t length,
+                     const RECT* clip) {
+    UseFont(font);
+    SetTextColor(hdc, color);
+    if (clip) {
+        ExtTextOutW(hdc, x, y, ETO_CLIPPED, clip, text, (UINT)length, NULL);
+    } else {
+        TextOutW(hdc, x, y, text, (int)length);
+    }
+}
+
+void GdiCanvas::TextInRect(const CanvasFont& font, COLORREF color, const RECT& rect, const wchar_t* text, int length,
+                           UINT format) {
+    UseFont(font);
+    SetTextColor(hdc, color);
+    RECT bounds = rect;
+    DrawTextW(hdc, text, length, &bounds, format);
+}
+
+int GdiCanvas::TextWidth(const CanvasFont& font, const wchar_t* text, size_t length) {
+    UseFont(font);
+    SIZE size = {0, 0};
+    GetTextExtentPoint32W(hdc, text, (int)length, &size);
+    return size.cx;
+}
+
+GlyphMeasurer* GdiCanvas::Measurer(const CanvasFont& font) {
+    measurer.font = font;
+    return &measurer;
+}
+
+// The DC's clip region is whichever of 'paint' and 'clip' apply, both
+// if both do
+void GdiCanvas::ApplyClip() {
+    RECT area;
+    if (painting && clipped) {
+        IntersectRect(&area, &paint, &clip);
+    } else if (painting || clipped) {
+        area = painting ? paint : clip;
+    } else {
+        SelectClipRgn(hdc, NULL);
+        return;
+    }
+    HRGN region = CreateRectRgnIndirect(&area);
+    SelectClipRgn(hdc, region);
+    DeleteObject(region);
+}
+
+void GdiCanvas::SetClip(const RECT* rect) {
+    clipped = rect != NULL;
+    if (rect) clip = *rect;
+    ApplyClip();
+}
+
+void GdiCanvas::SetPaintArea(const RECT* rect) {
+    painting = rect != NULL;
+    if (rect) paint = *rect;
+    clipped = false;
+    ApplyClip();
+}
+
+void GdiCanvas::Scroll(const RECT& rect, int dx, int dy) {
+    ScrollDC(hdc, dx, dy, &rect, &rect, NULL, NULL);
+}
+
+bool GdiCanvas::Visible(const RECT& rect) {
+    RECT shown;
+    if (painting && !IntersectRect(&shown, &rect, &paint)) return false;
+    if (clipped && !IntersectRect(&shown, &rect, &clip)) return false;
+    return rect.right > rect.left && rect.bottom > rect.top;
+}
@@ -0,0 +1,69 @@
+#ifndef GDICANVAS_H
+#define GDICANVAS_H
+
+#include <windows.h>
+#include <vector>
+#include "canvas.h"
+
+class GdiCanvas;
+
+// Advances from GetCharWidth32W in one of the canvas's fonts
+class GdiCanvasMeasurer : public GlyphMeasurer {
+public:
+    GdiCanvas* canvas;
+    CanvasFont font;
+
+    void Measure(wchar_t first, wchar_t last, int* advances) override;
+};
+
+// Draws through an HDC, usually the back buffer of a WM_PAINT. Fonts are
+// created the first time they are asked for and deleted with the canvas;
+// the DC gets its own font back then.
+class GdiCanvas : public Canvas {
+public:
+    explicit GdiCanvas(HDC hdc);
+    ~GdiCanvas();
+
+    void FillRect(const RECT& rect, COLORREF color) override;
+    void StrokeRect(const RECT& rect, int penWidth, COLORREF color) override;
+    void Line(int x0, int y0, int x1, int y1, int penWidth, COLORREF color) override;
+    void FillEllipse(const RECT& rect, COLORREF fill, COLORREF outline) override;
+    void StrokeEllipse(const RECT& rect, int penWidth, COLORREF color) override;
+    void Text(const CanvasFont& font, COLORREF color, int x, int y, const wchar_t* text, size_t length,
+              const RECT* clip) override;
+    void TextInRect(const CanvasFont& font, COLORREF color, const RECT& rect, const wchar_t* text, int length,
+                    UINT format) override;
+    int TextWidth(const CanvasFont& font, const wchar_t* text, size_t length) override;
+    GlyphMeasurer* Measurer(const CanvasFont& font) override;
+    void SetClip(const RECT* rect) override;
+    void SetPaintArea(const RECT* rect) override;
+    bool Visible(const RECT& rect) override;
+    void Scroll(const RECT& rect, int dx, int dy) override;
+
+    // Selects 'font' into the DC
+    void UseFont(const CanvasFont& font);
+
+private:
+    friend class GdiCanvasMeasurer;
+
+    struct CachedFont {
+        CanvasFont font;
+        HFONT handle;
+    };
+
+    HDC hdc;
+    HGDIOBJ deviceFont;
+    bool painting;  // whether 'paint' limits drawing
+    RECT paint;
+    bool clipped;   // whether 'clip' does, inside 'paint'
+    RECT clip;
+    std::vector<CachedFont> fonts;
+    GdiCanvasMeasurer measurer;
+
+    void ApplyClip();
+
+    GdiCanvas(const GdiCanvas&);
+    GdiCanvas& operator=(const GdiCanvas&);
+};
+
+#endif
@@ -0,0 +1,566 @@
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cwctype>
+#include <map>
+#include <memory>
+#include <string>
+#include "glyphraster.h"
+
+// Slant given to italics where the font has none, as x per unit of height
+static const float ITALIC_SLANT = 0.2f;
+// Composite glyphs nest no deeper than this
+static const int MAX_COMPONENT_DEPTH = 8;
+
+// Big-endian reads that stop at the end of the data rather than run past it
+struct FontReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok;
+
+    FontReader(const uint8_t* p, const uint8_t* end) : p(p), end(end), ok(p <= end) {}
+
+    uint8_t U8() {
+        if (p + 1 > end) return Fail();
+        return *p++;
+    }
+    uint16_t U16() {
+        if (p + 2 > end) return Fail();
+        uint16_t v = (uint16_t)(p[0] << 8 | p[1]);
+        p += 2;
+        return v;
+    }
+    int16_t S16() { return (int16_t)U16(); }
+    uint32_t U32() {
+        uint32_t high = U16();
+        return high << 16 | U16();
+    }
+    void Skip(size_t n) {
+        if ((size_t)(end - p) < n) {
+            Fail();
+            return;
+        }
+        p += n;
+    }
+
+private:
+    uint8_t Fail() {
+        ok = false;
+        p = end;
+        return 0;
+    }
+};
+
+// The tables of a TrueType file needed to draw its glyphs
+struct TrueTypeFont {
+    std::vector<uint8_t> data;
+    int cell;          // winAscent + winDescent, the height GDI scales to
+    int ascent;
+    bool longLoca;
+    uint32_t glyphCount;
+    size_t loca, locaSize;
+    size_t glyf, glyfSize;
+    size_t cmap4, cmap12;  // subtables; 0 if missing
+
+    TrueTypeFont() : cell(0), ascent(0), longLoca(false), glyphCount(0), loca(0), locaSize(0), glyf(0),
+                     glyfSize(0), cmap4(0), cmap12(0) {}
+};
+
+static bool FindTable(const std::vector<uint8_t>& data, const char* tag, size_t* offset, size_t* size) {
+    FontReader r(data.data(), data.data() + data.size());
+    r.Skip(4);
+    uint16_t tables = r.U16();
+    r.Skip(6);
+    for (uint16_t i = 0; i < tables && r.ok; i++) {
+        const uint8_t* name = r.p;
+        r.Skip(8);
+        uint32_t start = r.U32(), length = r.U32();
+        if (r.ok && memcmp(name, tag, 4) == 0) {
+            if (start > data.size() || length > data.size() - start) return false;
+            *offset = start;
+            *size = length;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool LoadTrueType(const std::string& path, TrueTypeFont* font) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (length <= 12) {
+        fclose(file);
+        return false;
+    }
+    font->data.resize((size_t)length);
+    size_t got = fread(font->data.data(), 1, font->data.size(), file);
+    fclose(file);
+    if (got != font->data.size()) return false;
+
+    const uint8_t* base = font->data.data();
+    const uint8_t* end = base + font->data.size();
+    size_t head, headSize, maxp, maxpSize, os2, os2Size, cmap, cmapSize;
+    if (!FindTable(font->data, "head", &head, &headSize) || !FindTable(font->data, "maxp", &maxp, &maxpSize) ||
+        !FindTable(font->data, "OS/2", &os2, &os2Size) || !FindTable(font->data, "cmap", &cmap, &cmapSize) ||
+        !FindTable(font->data, "loca", &font->loca, &font->locaSize) ||
+        !FindTable(font->data, "glyf", &font->glyf, &font->glyfSize)) {
+        return false;
+    }
+
+    FontReader headReader(base + head + 50, end);
+    font->longLoca = headReader.S16() != 0;
+    FontReader maxpReader(base + maxp + 4, end);
+    font->glyphCount = maxpReader.U16();
+    FontReader os2Reader(base + os2 + 74, end);
+    font->ascent = os2Reader.U16();
+    font->cell = font->ascent + os2Reader.U16();
+    if (!headReader.ok || !maxpReader.ok || !os2Reader.ok || font->cell <= 0) return false;
+
+    // Unicode subtables: format 4 for the BMP, format 12 beyond it
+    FontReader r(base + cmap + 2, base + cmap + cmapSize);
+    uint16_t subtables = r.U16();
+    for (uint16_t i = 0; i < subtables && r.ok; i++) {
+        uint16_t platform = r.U16(), encoding = r.U16();
+        uint32_t offset = r.U32();
+        if (!r.ok || offset + 2 > cmapSize) break;
+        bool unicode = platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10));
+        if (!unicode) continue;
+        FontReader format(base + cmap + offset, base + cmap + cmapSize);
+        uint16_t kind = format.U16();
+        if (kind == 4 && !font->cmap4) font->cmap4 = cmap + offset;
+        if (kind == 12 && !font->cmap12) font->cmap12 = cmap + offset;
+    }
+    return font->cmap4 || font->cmap12;
+}
+
+static uint32_t GlyphIndex(const TrueTypeFont* font, uint32_t codePoint) {
+    const uint8_t* base = font->data.data();
+    const uint8_t* end = base + font->data.size();
+    if (font->cmap12) {
+        FontReader r(base + font->cmap12 + 12, end);
+        uint32_t groups = r.U32();
+        for (uint32_t i = 0; i < groups && r.ok; i++) {
+            uint32_t first = r.U32(), last = r.U32(), glyph = r.U32();
+            if (codePoint >= first && codePoint <= last) return glyph + (codePoint - first);
+        }
+        return 0;
+    }
+    if (codePoint > 0xFFFF) return 0;
+    FontReader r(base + font->cmap4 + 6, end);
+    uint16_t segments = r.U16() / 2;
+    const uint8_t* ends = base + font->cmap4 + 14;
+    const uint8_t* starts = ends + segments * 2 + 2;
+    const uint8_t* deltas = starts + segments * 2;
+    const uint8_t* ranges = deltas + segments * 2;
+    if (ranges + segments * 2 > end) return 0;
+    for (uint16_t i = 0; i < segments; i++) {
+        uint16_t last = FontReader(ends + i * 2, end).U16();
+        if (codePoint > last) continue;
+        uint16_t first = FontReader(starts + i * 2, end).U16();
+        if (codePoint < first) return 0;
+        uint16_t delta = FontReader(deltas + i * 2, end).U16();
+        uint16_t range = FontReader(ranges + i * 2, end).U16();
+        if (range == 0) return (codePoint + delta) & 0xFFFF;
+        uint16_t glyph = FontReader(ranges + i * 2 + range + (codePoint - first) * 2, end).U16();
+        return glyph ? (glyph + delta) & 0xFFFF : 0;
+    }
+    return 0;
+}
+
+// Maps font units to pixels: x' = a x + b y + e, y' = c x + d y + f
+struct Transform {
+    float a, b, c, d, e, f;
+
+    void Apply(float x, float y, float* px, float* py) const {
+        *px = a * x + b * y + e;
+        *py = c * x + d * y + f;
+    }
+};
+
+struct Edge {
+    float x0, y0, x1, y1;
+};
+
+// Quadratic curve as lines, more of them the more it bends
+static void AddCurve(std::vector<Edge>* edges, float x0, float y0, float cx, float cy, float x1, float y1) {
+    float dx = x0 - 2 * cx + x1, dy = y0 - 2 * cy + y1;
+    float deviation = dx * dx + dy * dy;
+    int steps = deviation < 0.333f ? 1 : 1 + (int)std::floor(std::sqrt(std::sqrt(3.0f * deviation)));
+    float px = x0, py = y0;
+    for (int i = 1; i <= steps; i++) {
+        float t = (float)i / steps;
+        float u = 1 - t;
+        float x = u * u * x0 + 2 * u * t * cx + t * t * x1;
+        float y = u * u * y0 + 2 * u * t * cy + t * t * y1;
+        edges->push_back({px, py, x, y});
+        px = x;
+        py = y;
+    }
+}
+
+static void AddGlyph(const TrueTypeFont* font, uint32_t glyph, const Transform& m, std::vector<Edge>* edges,
+                     int depth) {
+    if (glyph >= font->glyphCount || depth > MAX_COMPONENT_DEPTH) return;
+    const uint8_t* base = font->data.data();
+    const uint8_t* fontEnd = base + font->data.size();
+    uint32_t start, stop;
+    if (font->longLoca) {
+        FontReader r(base + font->loca + glyph * 4, base + font->loca + font->locaSize);
+        start = r.U32();
+        stop = r.U32();
+        if (!r.ok) return;
+    } else {
+        FontReader r(base + font->loca + glyph * 2, base + font->loca + font->locaSize);
+        start = r.U16() * 2u;
+        stop = r.U16() * 2u;
+        if (!r.ok) return;
+    }
+    if (stop <= start || stop > font->glyfSize) return;
+    const uint8_t* glyphEnd = std::min(fontEnd, base + font->glyf + stop);
+    FontReader r(base + font->glyf + start, glyphEnd);
+    int16_t contours = r.S16();
+    r.Skip(8);
+
+    if (contours < 0) {
+        // Composite: other glyphs, each moved and maybe scaled
+        uint16_t flags;
+        do {
+            flags = r.U16();
+            uint16_t part = r.U16();
+            float dx, dy;
+            if (flags & 0x0001) {
+                dx = r.S16();
+                dy = r.S16();
+            } else {
+                dx = (int8_t)r.U8();
+                dy = (int8_t)r.U8();
+            }
+            // Components placed by matching points are rare; drawn in place
+            if (!(flags & 0x0002)) dx = dy = 0;
+            float a = 1, b = 0, c = 0, d = 1;
+            if (flags & 0x0008) {
+                a = d = r.S16() / 16384.0f;
+            } else if (flags & 0x0040) {
+                a = r.S16() / 16384.0f;
+                d = r.S16() / 16384.0f;
+            } else if (flags & 0x0080) {
+                a = r.S16() / 16384.0f;
+                c = r.S16() / 16384.0f;
+                b = r.S16() / 16384.0f;
+                d = r.S16() / 16384.0f;
+            }
+            if (!r.ok) return;
+            Transform inner = {m.a * a + m.b * c, m.a * b + m.b * d, m.c * a + m.d * c, m.c * b + m.d * d,
+                               m.a * dx + m.b * dy + m.e, m.c * dx + m.d * dy + m.f};
+            AddGlyph(font, part, inner, edges, depth + 1);
+        } while ((flags & 0x0020) && r.ok);
+        return;
+    }
+
+    std::vector<uint16_t> ends(contours);
+    for (int16_t i = 0; i < contours; i++) ends[i] = r.U16();
+    if (!r.ok || contours == 0) return;
+    size_t count = (size_t)ends[contours - 1] + 1;
+    r.Skip(r.U16());
+
+    std::vector<uint8_t> flags(count);
+    for (size_t i = 0; i < count && r.ok;) {
+        uint8_t flag = r.U8();
+        size_t repeat = (flag & 0x08) ? r.U8() : 0;
+        for (size_t k = 0; k <= repeat && i < count; k++) flags[i++] = flag;
+    }
+    std::vector<float> xs(count), ys(count);
+    int value = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (flags[i] & 0x02) {
+            int delta = r.U8();
+            value += (flags[i] & 0x10) ? delta : -delta;
+        } else if (!(flags[i] & 0x10)) {
+            value += r.S16();
+        }
+        xs[i] = (float)value;
+    }
+    value = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (flags[i] & 0x04) {
+            int delta = r.U8();
+            value += (flags[i] & 0x20) ? delta : -delta;
+        } else if (!(flags[i] & 0x20)) {
+            value += r.S16();
+        }
+        ys[i] = (float)value;
+    }
+    if (!r.ok) return;
+
+    // Between two off-curve points lies an implied on-curve one
+    size_t first = 0;
+    for (int16_t c = 0; c < contours; c++) {
+        size_t last = ends[c];
+        if (last < first || last >= count) return;
+        size_t n = last - first + 1;
+        std::vector<float> px(n), py(n);
+        std::vector<bool> on(n);
+        for (size_t i = 0; i < n; i++) {
+            m.Apply(xs[first + i], ys[first + i], &px[i], &py[i]);
+            on[i] = (flags[first + i] & 0x01) != 0;
+        }
+        // Start on an on-curve point, or between the two ends if neither
+        // is one; the contour then closes back to it
+        size_t from = 0, to = n;
+        float sx, sy;
+        if (on[0]) {
+            sx = px[0];
+            sy = py[0];
+            from = 1;
+        } else if (on[n - 1]) {
+            sx = px[n - 1];
+            sy = py[n - 1];
+            to = n - 1;
+        } else {
+            sx = (px[0] + px[n - 1]) / 2;
+            sy = (py[0] + py[n - 1]) / 2;
+        }
+        float cx = sx, cy = sy;
+        bool control = false;
+        float ctrlX = 0, ctrlY = 0;
+        for (size_t i = from; i <= to; i++) {
+            bool closing = i == to;
+            float x = closing ? sx : px[i], y = closing ? sy : py[i];
+            if (closing || on[i]) {
+                if (control) {
+                    AddCurve(edges, cx, cy, ctrlX, ctrlY, x, y);
+                } else {
+                    edges->push_back({cx, cy, x, y});
+                }
+                control = false;
+                cx = x;
+                cy = y;
+            } else if (control) {
+                float mx = (ctrlX + x) / 2, my = (ctrlY + y) / 2;
+                AddCurve(edges, cx, cy, ctrlX, ctrlY, mx, my);
+                cx = mx;
+                cy = my;
+                ctrlX = x;
+                ctrlY = y;
+            } else {
+                control = true;
+                ctrlX = x;
+                ctrlY = y;
+            }
+        }
+        first = last + 1;
+    }
+}
+
+// Signed area each edge leaves in the cells it crosses; the running sum
+// along a row is then the coverage. 'area' has 'stride' cells per row.
+static void Accumulate(const Edge& edge, float* area, int stride, int rows) {
+    if (edge.y0 == edge.y1) return;
+    float dir = edge.y0 < edge.y1 ? 1.0f : -1.0f;
+    float x0 = edge.y0 < edge.y1 ? edge.x0 : edge.x1, y0 = std::min(edge.y0, edge.y1);
+    float x1 = edge.y0 < edge.y1 ? edge.x1 : edge.x0, y1 = std::max(edge.y0, edge.y1);
+    float dxdy = (x1 - x0) / (y1 - y0);
+    float x = x0;
+    int yEnd = std::min(rows, (int)std::ceil(y1));
+    for (int y = std::max(0, (int)y0); y < yEnd; y++) {
+        float dy = std::min((float)(y + 1), y1) - std::max((float)y, y0);
+        float xNext = x + dxdy * dy;
+        float d = dy * dir;
+        float left = std::min(x, xNext), right = std::max(x, xNext);
+        float leftFloor = std::floor(left);
+        int leftCell = (int)leftFloor;
+        float rightCeil = std::ceil(right);
+        int rightCell = (int)rightCeil;
+        float* row = area + (size_t)y * stride;
+        if (leftCell < 0 || rightCell >= stride) {
+            x = xNext;
+            continue;
+        }
+        if (rightCell <= leftCell + 1) {
+            float mid = 0.5f * (x + xNext) - leftFloor;
+            row[leftCell] += d - d * mid;
+            row[leftCell + 1] += d * mid;
+        } else {
+            float s = 1.0f / (right - left);
+            float leftFrac = left - leftFloor;
+            float a0 = 0.5f * s * (1 - leftFrac) * (1 - leftFrac);
+            float rightFrac = right - rightCeil + 1;
+            float am = 0.5f * s * rightFrac * rightFrac;
+            row[leftCell] += d * a0;
+            if (rightCell == leftCell + 2) {
+                row[leftCell + 1] += d * (1 - a0 - am);
+            } else {
+                float a1 = s * (1.5f - leftFrac);
+                row[leftCell + 1] += d * (a1 - a0);
+                for (int i = leftCell + 2; i < rightCell - 1; i++) row[i] += d * s;
+                float a2 = a1 + (rightCell - leftCell - 3) * s;
+                row[rightCell - 1] += d * (1 - a2 - am);
+            }
+            row[rightCell] += d * am;
+        }
+        x = xNext;
+    }
+}
+
+static void FillEdges(std::vector<Edge>& edges, GlyphBitmap* glyph) {
+    glyph->left = glyph->top = glyph->width = glyph->height = 0;
+    glyph->coverage.clear();
+    if (edges.empty()) return;
+    float minX = edges[0].x0, maxX = minX, minY = edges[0].y0, maxY = minY;
+    for (size_t i = 0; i < edges.size(); i++) {
+        minX = std::min(minX, std::min(edges[i].x0, edges[i].x1));
+        maxX = std::max(maxX, std::max(edges[i].x0, edges[i].x1));
+        minY = std::min(minY, std::min(edges[i].y0, edges[i].y1));
+        maxY = std::max(maxY, std::max(edges[i].y0, edges[i].y1));
+    }
+    glyph->left = (int)std::floor(minX);
+    glyph->top = (int)std::floor(minY);
+    glyph->width = (int)std::ceil(maxX) - glyph->left;
+    glyph->height = (int)std::ceil(maxY) - glyph->top;
+    if (glyph->width <= 0 || glyph->height <= 0) {
+        glyph->width = glyph->height = 0;
+        return;
+    }
+
+    int stride = glyph->width + 2;
+    std::vector<float> area((size_t)stride * glyph->height, 0.0f);
+    for (size_t i = 0; i < edges.size(); i++) {
+        Edge e = {edges[i].x0 - glyph->left, edges[i].y0 - glyph->top, edges[i].x1 - glyph->left,
+                  edges[i].y1 - glyph->top};
+        Accumulate(e, area.data(), stride, glyph->height);
+    }
+    glyph->coverage.resize((size_t)glyph->width * glyph->height);
+    for (int y = 0; y < glyph->height; y++) {
+        float sum = 0;
+        const float* row = area.data() + (size_t)y * stride;
+        uint8_t* out = glyph->coverage.data() + (size_t)y * glyph->width;
+        for (int x = 0; x < glyph->width; x++) {
+            sum += row[x];
+            out[x] = (uint8_t)std::min(255.0f, std::fabs(sum) * 255.0f + 0.5f);
+        }
+    }
+}
+
+class FontFileRasterizer : public GlyphRasterizer {
+public:
+    explicit FontFileRasterizer(const char* directory) : directory(directory) {}
+
+    bool Rasterize(const TextFont& font, int height, uint32_t codePoint, GlyphBitmap* glyph) override {
+        const TrueTypeFont* file = Open(font);
+        if (!file || height <= 0) return false;
+        float scale = (float)height / file->cell;
+        float slant = font.italic ? ITALIC_SLANT * scale : 0;
+        // Font units have y going up from the baseline; the cell's go down
+        // from its top
+        Transform m = {scale, slant, 0, -scale, 0, file->ascent * scale};
+        std::vector<Edge> edges;
+        AddGlyph(file, GlyphIndex(file, codePoint), m, &edges, 0);
+        FillEdges(edges, glyph);
+        return true;
+    }
+
+private:
+    std::string directory;
+    std::map<std::string, std::unique_ptr<TrueTypeFont>> files;  // NULL where a file would not load
+
+    const TrueTypeFont* Load(const std::string& name) {
+        std::map<std::string, std::unique_ptr<TrueTypeFont>>::iterator it = files.find(name);
+        if (it != files.end()) return it->second.get();
+        std::unique_ptr<TrueTypeFont> font(new TrueTypeFont());
+        if (!LoadTrueType(directory + "/" + name + ".ttf", font.get())) font.reset();
+        return (files[name] = std::move(font)).get();
+    }
+
+    const TrueTypeFont* Open(const TextFont& font) {
+        std::wstring face;
+        for (size_t i = 0; i < font.face.size(); i++) face.push_back((wchar_t)towlower(font.face[i]));
+        std::string family = "DejaVuSans";
+        if (face.find(L"mono") != std::wstring::npos) {
+            family = "DejaVuSansMono";
+        } else if (face.find(L"serif") != std::wstring::npos && face.find(L"sans") == std::wstring::npos) {
+            family = "DejaVuSerif";
+        }
+        const TrueTypeFont* file = font.weight >= 600 ? Load(family + "-Bold") : NULL;
+        return file ? file : Load(family);
+    }
+};
+
+GlyphRasterizer* GlyphRaster_FontFiles(const char* directory) {
+    return new FontFileRasterizer(directory ? directory : ".");
+}
+
+#ifdef _WIN32
+// GetGlyphOutlineW's 65 levels of grey, from a private memory DC
+class GdiRasterizer : public GlyphRasterizer {
+public:
+    GdiRasterizer() : hdc(NULL), hFont(NULL), currentHeight(0), ascent(0) {}
+
+    bool Rasterize(const TextFont& font, int height, uint32_t codePoint, GlyphBitmap* glyph) override {
+        if (codePoint > 0xFFFF || !Select(font, height)) return false;
+        GLYPHMETRICS metrics;
+        MAT2 identity = {{0, 1}, {0, 0}, {0, 0}, {0, 1}};
+        DWORD size = GetGlyphOutlineW(hdc, codePoint, GGO_GRAY8_BITMAP, &metrics, 0, NULL, &identity);
+        if (size == GDI_ERROR) return false;
+        glyph->left = metrics.gmptGlyphOrigin.x;
+        glyph->top = ascent - metrics.gmptGlyphOrigin.y;
+        glyph->width = size ? (int)metrics.gmBlackBoxX : 0;
+        glyph->height = size ? (int)metrics.gmBlackBoxY : 0;
+        glyph->coverage.assign((size_t)glyph->width * glyph->height, 0);
+        if (!size) return true;
+        std::vector<uint8_t> grey(size);
+        GetGlyphOutlineW(hdc, codePoint, GGO_GRAY8_BITMAP, &metrics, size, grey.data(), &identity);
+        size_t pitch = (glyph->width + 3) & ~3;
+        for (int y = 0; y < glyph->height; y++) {
+            for (int x = 0; x < glyph->width; x++) {
+                glyph->coverage[(size_t)y * glyph->width + x] = (uint8_t)(grey[y * pitch + x] * 255 / 64);
+            }
+        }
+        return true;
+    }
+
+private:
+    HDC hdc;
+    HFONT hFont;
+    TextFont current;
+    int currentHeight;
+    int ascent;
+
+    bool Select(const TextFont& font, int height) {
+        if (hFont && currentHeight == height && current.weight == font.weight && current.italic == font.italic &&
+            current.face == font.face) {
+            return true;
+        }
+        if (!hdc) hdc = CreateCompatibleDC(NULL);
+        if (!hdc) return false;
+        HFONT next = CreateFontW(height, 0, 0, 0, font.weight, font.italic, FALSE, FALSE, DEFAULT_CHARSET,
+                                 OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY,
+                                 DEFAULT_PITCH | FF_DONTCARE, font.face.c_str());
+        if (!next) return false;
+        SelectObject(hdc, next);
+        if (hFont) DeleteObject(hFont);
+        hFont = next;
+        current = font;
+        currentHeight = height;
+        TEXTMETRICW tm;
+        ascent = GetTextMetricsW(hdc, &tm) ? tm.tmAscent : height;
+        return true;
+    }
+};
+#endif
+
+GlyphRasterizer* GlyphRaster_Default() {
+#ifdef _WIN32
+    static GdiRasterizer rasterizer;
+    return &rasterizer;
+#else
+    static GlyphRasterizer* rasterizer = GlyphRaster_FontFiles("/usr/share/fonts/truetype/dejavu");
+    return rasterizer;
+#endif
+}
@@ -0,0 +1,36 @@
+#ifndef GLYPHRASTER_H
+#define GLYPHRASTER_H
+
+#include <cstdint>
+#include <vector>
+#include "textmeasure.h"
+
+// Coverage of one glyph at one size, for the software canvas's atlas
+struct GlyphBitmap {
+    int left;    // from the pen position to the first column
+    int top;     // from the top of the cell to the first row
+    int width;
+    int height;
+    std::vector<uint8_t> coverage;  // width * height; 255 is fully inside
+};
+
+class GlyphRasterizer {
+public:
+    virtual ~GlyphRasterizer() {}
+    // The glyph for 'codePoint' in 'font' with a cell 'height' pixels
+    // high. False if the font cannot be had; a glyph with no ink, such as
+    // a space, is an empty bitmap.
+    virtual bool Rasterize(const TextFont& font, int height, uint32_t codePoint, GlyphBitmap* glyph) = 0;
+};
+
+// GDI on Windows; elsewhere the DejaVu TrueType files of the system, the
+// fonts fontmetrics.txt was taken from. Lives for the rest of the run.
+GlyphRasterizer* GlyphRaster_Default();
+// TrueType outlines from DejaVuSans.ttf, DejaVuSansMono.ttf and
+// DejaVuSerif.ttf in 'directory', and their -Bold files. Faces are matched
+// on "Mono" and "Serif" in the name, the rest drawn as DejaVu Sans. There
+// are no italic files, so italics are slanted. Lives for the rest of the
+// run.
+GlyphRasterizer* GlyphRaster_FontFiles(const char* directory);
+
+#endif
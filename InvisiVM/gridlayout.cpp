@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <string>
+#include "gridlayout.h"
+
+// Rows measured from the top, where headers and short tables live
+static const size_t HEAD_SAMPLE = 256;
+// Rows measured at even steps through the rest
+static const size_t SPREAD_SAMPLE = 768;
+static const int MIN_CHARS = 3;
+static const int MAX_CHARS = 60;
+// Share of sampled cells a column is made wide enough for; the few long
+// ones are clipped rather than pushing every other column off screen
+static const double FIT_SHARE = 0.95;
+
+static int CharCount(const std::string& text) {
+    int count = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (((unsigned char)text[i] & 0xC0) != 0x80) count++;
+    }
+    return count;
+}
+
+void GridLayout_Measure(GridLayout* layout, const CsvTable* table, int charWidth, int padding) {
+    if (!layout || !table) return;
+    size_t columns = table->columnCount;
+
+    std::vector<size_t> rows;
+    for (size_t r = 0; r < table->rows && r < HEAD_SAMPLE; r++) rows.push_back(r);
+    if (table->rows > HEAD_SAMPLE) {
+        size_t rest = table->rows - HEAD_SAMPLE;
+        size_t step = std::max<size_t>(1, rest / SPREAD_SAMPLE);
+        for (size_t r = HEAD_SAMPLE; r < table->rows && rows.size() < HEAD_SAMPLE + SPREAD_SAMPLE; r += step) {
+            rows.push_back(r);
+        }
+    }
+
+    std::vector<std::vector<int>> lengths(columns);
+    std::string cell;
+    for (size_t i = 0; i < rows.size(); i++) {
+        for (size_t c = 0; c < columns; c++) {
+            cell.clear();
+            CsvTable_CellText(table, rows[i], c, &cell);
+            lengths[c].push_back(CharCount(cell));
+        }
+    }
+
+    layout->widths.assign(columns, 0);
+    layout->lefts.assign(columns + 1, 0);
+    for (size_t c = 0; c < columns; c++) {
+        std::vector<int>& l = lengths[c];
+        int chars = 0;
+        if (!l.empty()) {
+            // The header row always fits
+            int header = l[0];
+            size_t k = std::min(l.size() - 1, (size_t)(l.size() * FIT_SHARE));
+            std::nth_element(l.begin(), l.begin() + k, l.end());
+            chars = std::max(header, l[k]);
+        }
+        chars = std::max(MIN_CHARS, std::min(MAX_CHARS, chars));
+        layout->widths[c] = chars * charWidth + 2 * padding;
+        layout->lefts[c + 1] = layout->lefts[c] + layout->widths[c];
+    }
+}
+
+int64_t GridLayout_Width(const GridLayout* layout) {
+    return layout && !layout->lefts.empty() ? layout->lefts.back() : 0;
+}
+
+void GridLayout_Visible(const GridLayout* layout, size_t rowCount, size_t scrollRow, int64_t scrollX,
+                        int viewWidth, int viewHeight, int rowHeight, GridRange* range) {
+    size_t visibleRows = rowHeight > 0 ? (size_t)std::max(0, (viewHeight + rowHeight - 1) / rowHeight) : 0;
+    range->firstRow = std::min(scrollRow, rowCount);
+    range->endRow = std::min(rowCount, range->firstRow + visibleRows);
+
+    // lefts is sorted, so both edges are binary searches
+    const std::vector<int64_t>& lefts = layout->lefts;
+    size_t columns = layout->widths.size();
+    size_t first = (size_t)(std::upper_bound(lefts.begin(), lefts.end(), scrollX) - lefts.begin());
+    first = first > 0 ? first - 1 : 0;
+    size_t end = (size_t)(std::lower_bound(lefts.begin(), lefts.end(), scrollX + viewWidth) - lefts.begin());
+    range->firstColumn = std::min(first, columns);
+    range->endColumn = std::min(end, columns);
+    range->offsetX = range->firstColumn < columns ? (int)(lefts[range->firstColumn] - scrollX) : 0;
+}
@@ -0,0 +1,37 @@
+#ifndef GRIDLAYOUT_H
+#define GRIDLAYOUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "csvtable.h"
+
+// Column geometry for showing a table as a grid. Only a sample of rows is
+// measured, so sizing a 10M row table costs the same as a small one.
+struct GridLayout {
+    std::vector<int> widths;     // pixels per column
+    std::vector<int64_t> lefts;  // left edge of each column; the last entry is the total width
+
+    GridLayout() : lefts(1, 0) {}
+};
+
+// The part of the grid in view. Columns are [firstColumn, endColumn) and
+// the first one starts 'offsetX' pixels from the left of the view, which is
+// zero or negative when it is partly scrolled off.
+struct GridRange {
+    size_t firstRow;
+    size_t endRow;
+    size_t firstColumn;
+    size_t endColumn;
+    int offsetX;
+};
+
+// Sizes each column to fit most of its sampled cells: the first rows and an
+// even spread over the rest. 'charWidth' is an average character width.
+void GridLayout_Measure(GridLayout* layout, const CsvTable* table, int charWidth, int padding);
+int64_t GridLayout_Width(const GridLayout* layout);
+// Rows and columns that overlap a view of the given size
+void GridLayout_Visible(const GridLayout* layout, size_t rowCount, size_t scrollRow, int64_t scrollX,
+                        int viewWidth, int viewHeight, int rowHeight, GridRange* range);
+
+#endif
@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <cstring>
+#include "inflate.h"
+
+// Table driven inflater. Codes up to FAST_BITS long are resolved with a single
+// lookup; longer ones fall back to the canonical decode used by zlib's puff.
+static const int FAST_BITS = 10;
+static const int FAST_MASK = (1 << FAST_BITS) - 1;
+
+struct Huffman {
+    unsigned short fast[1 << FAST_BITS];  // (symbol << 4) | length, 0 = slow path
+    unsigned short count[16];
+    unsigned short symbol[288];
+};
+
+static const unsigned short kLenBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char kLenExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned short kDistBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char kDistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const unsigned char kCodeLenOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// LSB-first bit reader. Reading past the end feeds zero bytes and counts them
+// in 'pad' so truncation can be detected once a block finishes.
+struct BitReader {
+    const unsigned char* p;
+    const unsigned char* end;
+    unsigned long long bits;
+    int nbits;
+    size_t pad;
+
+    void Refill() {
+        while (nbits <= 56) {
+            if (p < end) bits |= (unsigned long long)*p++ << nbits;
+            else pad++;
+            nbits += 8;
+        }
+    }
+
+    unsigned Get(int n) {
+        if (n == 0) return 0;
+        if (nbits < n) Refill();
+        unsigned v = (unsigned)(bits & ((1ull << n) - 1));
+        bits >>= n;
+        nbits -= n;
+        return v;
+    }
+
+    void Drop(int n) { bits >>= n; nbits -= n; }
+
+    bool Overrun() const { return pad * 8 > (size_t)nbits; }
+
+    // Discard the partial byte and hand whole buffered bytes back to the input
+    void AlignToByte() {
+        Drop(nbits & 7);
+        size_t back = (size_t)nbits / 8;
+        if (back > pad) {
+            p -= back - pad;
+            pad = 0;
+        } else {
+            pad -= back;
+        }
+        bits = 0;
+        nbits = 0;
+    }
+};
+
+static bool BuildHuffman(Huffman* h, const unsigned char* lengths, int n) {
+    memset(h->count, 0, sizeof(h->count));
+    for (int s = 0; s < n; s++) h->count[lengths[s]]++;
+    h->count[0] = 0;
+
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left <<= 1;
+        left -= h->count[len];
+        if (left < 0) return false;  // over-subscribed
+    }
+
+    unsigned short offs[16];
+    offs[1] = 0;
+    for (int len = 1; len < 15; len++) offs[len + 1] = offs[len] + h->count[len];
+    for (int s = 0; s < n; s++) {
+        if (lengths[s]) h->symbol[offs[lengths[s]]++] = (unsigned short)s;
+    }
+
+    memset(h->fast, 0, sizeof(h->fast));
+    unsigned code = 0;
+    int index = 0;
+    for (int len = 1; len <= FAST_BITS; len++) {
+        for (int k = 0; k < h->count[len]; k++, code++) {
+            unsigned rev = 0;
+            for (int b = 0; b < len; b++) rev |= ((code >> b) & 1) << (len - 1 - b);
+            unsigned short entry = (unsigned short)((h->symbol[index++] << 4) | len);
+            for (unsigned r = rev; r <= (unsigned)FAST_MASK; r += 1u << len) h->fast[r] = entry;
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+static int DecodeSymbol(BitReader* br, const Huffman* h) {
+    if (br->nbits < 16) br->Refill();
+    unsigned entry = h->fast[br->bits & FAST_MASK];
+    if (entry) {
+        br->Drop(entry & 15);
+        return (int)(entry >> 4);
+    }
+
+    unsigned long long b = br->bits;
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; len++) {
+        code |= (int)(b & 1);
+        b >>= 1;
+        int count = h->count[len];
+        if (code - count < first) {
+            br->Drop(len);
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+struct FixedTables {
+    Huffman lit, dist;
+
+    FixedTables() {
+        unsigned char lengths[288];
+        int s = 0;
+        for (; s < 144; s++) lengths[s] = 8;
+        for (; s < 256; s++) lengths[s] = 9;
+        for (; s < 280; s++) lengths[s] = 7;
+        for (; s < 288; s++) lengths[s] = 8;
+        BuildHuffman(&lit, lengths, 288);
+        for (s = 0; s < 30; s++) lengths[s] = 5;
+        BuildHuffman(&dist, lengths, 30);
+    }
+};
+
+static const FixedTables& GetFixedTables() {
+    static const FixedTables tables;
+    return tables;
+}
+
+static bool ReadDynamicTables(BitReader* br, Huffman* lit, Huffman* dist) {
+    int nlen = (int)br->Get(5) + 257;
+    int ndist = (int)br->Get(5) + 1;
+    int ncode = (int)br->Get(4) + 4;
+    if (nlen > 286 || ndist > 30) return false;
+
+    unsigned char lengths[286 + 30];
+    memset(lengths, 0, 19);
+    for (int i = 0; i < ncode; i++) lengths[kCodeLenOrder[i]] = (unsigned char)br->Get(3);
+
+    Huffman codeLen;
+    if (!BuildHuffman(&codeLen, lengths, 19)) return false;
+
+    int index = 0;
+    while (index < nlen + ndist) {
+        int sym = DecodeSymbol(br, &codeLen);
+        if (sym < 0) return false;
+        if (sym < 16) {
+            lengths[index++] = (unsigned char)sym;
+            continue;
+        }
+        unsigned char value = 0;
+        int repeat;
+        if (sym == 16) {
+            if (index == 0) return false;
+            value = lengths[index - 1];
+            repeat = 3 + (int)br->Get(2);
+        } else if (sym == 17) {
+            repeat = 3 + (int)br->Get(3);
+        } else {
+            repeat = 11 + (int)br->Get(7);
+        }
+        if (index + repeat > nlen + ndist) return false;
+        while (repeat--) lengths[index++] = value;
+    }
+
+    if (lengths[256] == 0) return false;  // no end-of-block code
+    return BuildHuffman(lit, lengths, nlen) && BuildHuffman(dist, lengths + nlen, ndist);
+}
+
+// Back references reach at most this far
+static const size_t WINDOW_SIZE = 32768;
+
+// Decodes into 'out' from 'start'. With a sink, output is handed over
+// whenever 'flushAt' bytes are buffered and only the last WINDOW_SIZE bytes
+// are kept for back references, so memory stays bounded however large the
+// stream; 'out' is then only scratch space and is left as it is.
+static bool InflateInto(const unsigned char* data, size_t size, std::string* out, size_t start, size_t flushAt,
+                        const InflateSink* sink) {
+    if (!data || size == 0) return false;
+
+    BitReader br = {data, data + size, 0, 0, 0};
+    size_t pos = start;
+    size_t sent = pos;  // output before this has gone to the sink
+    // Room the caller reserved is used before any guess
+    size_t needed = std::max(pos + (sink ? flushAt + WINDOW_SIZE : size * 4) + 1024, out->capacity());
+    if (out->size() < needed) out->resize(needed);
+
+    // Hands over what is buffered and slides the window to the front
+    auto flush = [&]() {
+        if (!sink || pos - sent < flushAt) return true;
+        if (!(*sink)(out->data() + sent, pos - sent)) return false;
+        size_t keep = std::min(WINDOW_SIZE, pos - start);
+        memmove(&(*out)[start], out->data() + pos - keep, keep);
+        pos = start + keep;
+        sent = pos;
+        return true;
+    };
+
+    Huffman dynLit, dynDist;
+    bool ok = true;
+    bool last = false;
+
+    while (ok && !last) {
+        last = br.Get(1) != 0;
+        unsigned type = br.Get(2);
+
+        if (type == 0) {
+            if (!flush()) return false;
+            br.AlignToByte();
+            if (br.end - br.p < 4) { ok = false; break; }
+            unsigned len = br.p[0] | (br.p[1] << 8);
+            unsigned nlen = br.p[2] | (br.p[3] << 8);
+            br.p += 4;
+            if ((len ^ 0xFFFF) != nlen || (size_t)(br.end - br.p) < len) { ok = false; break; }
+            if (out->size() < pos + len) out->resize((pos + len) * 2);
+            memcpy(&(*out)[pos], br.p, len);
+            pos += len;
+            br.p += len;
+            continue;
+        }
+
+        const Huffman* lit;
+        const Huffman* dist;
+        if (type == 1) {
+            lit = &GetFixedTables().lit;
+            dist = &GetFixedTables().dist;
+        } else if (type == 2) {
+            if (!ReadDynamicTables(&br, &dynLit, &dynDist)) { ok = false; break; }
+            lit = &dynLit;
+            dist = &dynDist;
+        } else {
+            ok = false;
+            break;
+        }
+
+        for (;;) {
+            if (!flush()) return false;
+            int sym = DecodeSymbol(&br, lit);
+            if (sym < 0 || br.Overrun()) { ok = false; break; }
+            if (pos + 258 > out->size()) out->resize(out->size() * 2);
+            char* dst = &(*out)[0];
+
+            if (sym < 256) {
+                dst[pos++] = (char)sym;
+                continue;
+            }
+            if (sym == 256) break;
+
+            sym -= 257;
+            if (sym >= 29) { ok = false; break; }
+            unsigned len = kLenBase[sym] + br.Get(kLenExtra[sym]);
+
+            int dsym = DecodeSymbol(&br, dist);
+            if (dsym < 0 || dsym >= 30) { ok = false; break; }
+            size_t d = kDistBase[dsym] + br.Get(kDistExtra[dsym]);
+            if (d > pos - start) { ok = false; break; }
+
+            const char* src = dst + pos - d;
+            if (d >= len) {
+                memcpy(dst + pos, src, len);
+            } else {
+                for (unsigned k = 0; k < len; k++) dst[pos + k] = src[k];
+            }
+            pos += len;
+        }
+
+        if (br.Overrun()) ok = false;
+    }
+
+    if (sink) {
+        if (pos > sent && !(*sink)(out->data() + sent, pos - sent)) ok = false;
+        return ok;
+    }
+    out->resize(pos);
+    return ok;
+}
+
+bool Inflate_Raw(const unsigned char* data, size_t size, std::string* out) {
+    if (!out) return false;
+    return InflateInto(data, size, out, out->size(), 0, NULL);
+}
+
+bool Inflate_Stream(const unsigned char* data, size_t size, const InflateSink& sink, size_t chunkSize,
+                    InflateWindow* window) {
+    InflateWindow local;
+    if (!window) window = &local;
+    // A reused window is written over, never cleared, so it costs nothing
+    // to set up again
+    return InflateInto(data, size, &window->buffer, 0, std::max<size_t>(chunkSize, 1), &sink);
+}
+
+bool Inflate_Zlib(const unsigned char* data, size_t size, std::string* out) {
+    if (!data) return false;
+
+    // CMF/FLG pair: deflate method with a valid check value
+    if (size >= 2 && (data[0] & 0x0F) == 8 && ((data[0] << 8) | data[1]) % 31 == 0) {
+        size_t skip = (data[1] & 0x20) ? 6 : 2;  // FDICT adds a 4 byte dictionary id
+        if (size <= skip) return false;
+        return Inflate_Raw(data + skip, size - skip, out);
+    }
+    return Inflate_Raw(data, size, out);
+}
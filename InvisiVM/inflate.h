@@ -0,0 +1,33 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <string>
+#include <cstddef>
+#include <functional>
+
+// DEFLATE (RFC 1951) decoder used for PDF FlateDecode streams.
+// Output is appended to 'out'. Returns false on corrupt input; whatever was
+// decoded before the error is left in 'out' so callers can still show it.
+bool Inflate_Raw(const unsigned char* data, size_t size, std::string* out);
+
+// Receives decoded output a piece at a time; returning false stops decoding
+typedef std::function<bool(const char* data, size_t size)> InflateSink;
+
+// Working memory for Inflate_Stream: the 32 KB window plus a chunk of output.
+// Handing the same one to successive calls on a thread saves setting it up
+// for every stream.
+struct InflateWindow {
+    std::string buffer;
+};
+
+// Inflate_Raw for streams too big to hold decoded. Output goes to 'sink' in
+// pieces of about 'chunkSize' bytes while only the last 32 KB are kept.
+// 'window' may be NULL. Returns false on corrupt input or when the sink
+// stops early.
+bool Inflate_Stream(const unsigned char* data, size_t size, const InflateSink& sink, size_t chunkSize,
+                    InflateWindow* window);
+
+// Same as Inflate_Raw but skips a zlib (RFC 1950) header if one is present
+bool Inflate_Zlib(const unsigned char* data, size_t size, std::string* out);
+
+#endif
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LINEINDEX_SSE2 1
+#endif
+#include "lineindex.h"
+
+static inline uint64_t StartAt(const LineIndex* index, size_t i) {
+    return index->starts64.empty() ? index->starts32[i] : index->starts64[i];
+}
+
+static size_t StartCount(const LineIndex* index) {
+    return index->starts64.empty() ? index->starts32.size() : index->starts64.size();
+}
+
+static void PushStart(LineIndex* index, uint64_t pos) {
+    if (index->starts64.empty() && pos <= 0xFFFFFFFFu) {
+        index->starts32.push_back((uint32_t)pos);
+        return;
+    }
+    if (index->starts64.empty()) {
+        index->starts64.assign(index->starts32.begin(), index->starts32.end());
+        std::vector<uint32_t>().swap(index->starts32);
+    }
+    index->starts64.push_back(pos);
+}
+
+#ifdef LINEINDEX_SSE2
+static inline int LowestBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return (int)bit;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+void LineIndex_Reset(LineIndex* index) {
+    if (!index) return;
+    index->starts32.clear();
+    index->starts64.clear();
+    index->scanned = 0;
+}
+
+void LineIndex_Update(LineIndex* index, const char* text, size_t size) {
+    if (!index || size <= index->scanned) return;
+
+    size_t pos = index->scanned;
+    if (pos == 0) PushStart(index, 0);
+
+#ifdef LINEINDEX_SSE2
+    // 16 bytes per compare; a set bit in the mask is a '\n'
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (pos + 16 <= size) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(text + pos));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        while (mask) {
+            PushStart(index, pos + LowestBit(mask) + 1);
+            mask &= mask - 1;
+        }
+        pos += 16;
+    }
+#endif
+    while (pos < size) {
+        const char* hit = (const char*)memchr(text + pos, '\n', size - pos);
+        if (!hit) break;
+        pos = (size_t)(hit - text) + 1;
+        PushStart(index, pos);
+    }
+    index->scanned = size;
+}
+
+size_t LineIndex_Count(const LineIndex* index, size_t size) {
+    if (!index) return 0;
+    size_t count = StartCount(index);
+    if (count > 0 && (index->scanned < size || StartAt(index, count - 1) == size)) count--;
+    return count;
+}
+
+std::string_view LineIndex_Line(const LineIndex* index, const char* text, size_t size, size_t i) {
+    if (!index || i >= StartCount(index)) return std::string_view();
+
+    size_t start = (size_t)StartAt(index, i);
+    size_t end = i + 1 < StartCount(index) ? (size_t)StartAt(index, i + 1) - 1 : size;
+    if (end > start && text[end - 1] == '\r') end--;
+    return std::string_view(text + start, end - start);
+}
+
+size_t LineIndex_LineAt(const LineIndex* index, size_t offset) {
+    if (!index || StartCount(index) == 0) return 0;
+    size_t after = index->starts64.empty()
+                       ? std::upper_bound(index->starts32.begin(), index->starts32.end(), offset) -
+                             index->starts32.begin()
+                       : std::upper_bound(index->starts64.begin(), index->starts64.end(), (uint64_t)offset) -
+                             index->starts64.begin();
+    return after > 0 ? after - 1 : 0;
+}
@@ -0,0 +1,33 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Line starts for a text buffer that only grows at the end. Offsets are
+// packed as 32-bit values and widened to 64-bit only once the text passes
+// 4 GB, so a 20M line log costs 80 MB of index on top of the text itself
+// instead of a heap block per line.
+struct LineIndex {
+    std::vector<uint32_t> starts32;
+    std::vector<uint64_t> starts64;  // replaces starts32 past 4 GB
+    size_t scanned;                  // bytes of text already indexed
+
+    LineIndex() : scanned(0) {}
+};
+
+void LineIndex_Reset(LineIndex* index);
+// Indexes text[index->scanned, size). Call after every append, or with a
+// growing 'size' to index a large buffer a piece at a time.
+void LineIndex_Update(LineIndex* index, const char* text, size_t size);
+// Line count as std::getline would see it: no empty line after a final '\n'.
+// While only part of the text is indexed, counts the complete lines so far.
+size_t LineIndex_Count(const LineIndex* index, size_t size);
+// Line i without its line break. 'size' must be the indexed text size.
+std::string_view LineIndex_Line(const LineIndex* index, const char* text, size_t size, size_t i);
+// Line holding byte 'offset', or the last line indexed if it lies past that
+size_t LineIndex_LineAt(const LineIndex* index, size_t offset);
+
+#endif
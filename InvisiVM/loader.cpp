@@ -0,0 +1,364 @@
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstring>
+#include <cctype>
+#include <vector>
+#include <algorithm>
+#include "loader.h"
+#include "pdfparse.h"
+#include "worker.h"
+#include "diskcache.h"
+#include "docx.h"
+#include "threadpool.h"
+#include "xlsx.h"
+
+// PDF pages are only extracted this many lines past what a viewer asked for
+static const size_t LOOKAHEAD_LINES = 500;
+// DOCX text reaches the viewer in batches of about this many bytes
+static const size_t DOCX_CHUNK = 256 << 10;
+
+struct LoadJob {
+    std::mutex lock;        // held while the sink is being called
+    LoadSink* sink;         // NULL once cancelled
+    std::atomic<bool> cancelled;
+    std::atomic<int> refs;  // caller handle + loader thread
+    std::string path;
+    std::string expectedType;
+
+    std::mutex demandLock;  // never held while calling the sink
+    std::condition_variable demandChanged;
+    size_t linesWanted;
+    int pagesWanted;
+
+    LoadJob() : sink(NULL), cancelled(false), refs(2), linesWanted(0), pagesWanted(0) {}
+};
+
+static std::mutex g_runningLock;
+static std::condition_variable g_runningDone;
+static int g_running = 0;
+
+static void ReleaseJob(LoadJob* job) {
+    if (--job->refs == 0) delete job;
+}
+
+bool Loader_HasExtension(const char* path, const char* ext) {
+    if (!path || !ext) return false;
+    const char* dot = strrchr(path, '.');
+    if (!dot) return false;
+    const char* actual = dot + 1;
+    while (*actual && *ext) {
+        if (tolower((unsigned char)*actual) != tolower((unsigned char)*ext)) return false;
+        actual++;
+        ext++;
+    }
+    return *actual == '\0' && *ext == '\0';
+}
+
+static void SendChunk(LoadJob* job, std::string& text) {
+    std::lock_guard<std::mutex> guard(job->lock);
+    if (job->sink) job->sink->OnChunk(text);
+}
+
+static void SendTable(LoadJob* job, std::unique_ptr<LoadedTable>& table) {
+    std::lock_guard<std::mutex> guard(job->lock);
+    if (job->sink) job->sink->OnTable(table);
+}
+
+static void SendPages(LoadJob* job, const std::vector<size_t>& firstLines, int total) {
+    std::lock_guard<std::mutex> guard(job->lock);
+    if (job->sink) job->sink->OnPages(firstLines, total);
+}
+
+static void SendProgress(LoadJob* job, int done, int total) {
+    std::lock_guard<std::mutex> guard(job->lock);
+    if (job->sink) job->sink->OnProgress(done, total);
+}
+
+static void SendFinished(LoadJob* job, bool ok, const std::string& message) {
+    std::lock_guard<std::mutex> guard(job->lock);
+    if (job->sink) job->sink->OnFinished(ok, message);
+}
+
+// Pages finished by the pool, waiting for the ones before them
+struct PageBatch {
+    std::mutex lock;
+    std::condition_variable ready;
+    std::vector<std::string> pages;
+    std::vector<char> done;
+};
+
+// Extracts pages on every core and hands them to the sink in page order,
+// each run as soon as all pages before it are in. Pages are taken a round at
+// a time and only while a viewer wants lines near the end of what it has,
+// so a long document costs nothing past the part being read; a jump to a
+// page takes everything up to it in one round. 'all' collects the text and
+// 'firstLines' the line each page starts on; returns true once every page
+// is in.
+static bool ExtractPages(LoadJob* job, PDFDoc* doc, std::string* all, std::vector<size_t>* firstLines) {
+    int total = PDFParse_PageCount(doc);
+    int round = std::max(4, 2 * ThreadPool_Size());
+    PageBatch batch;
+    batch.pages.resize(total);
+    batch.done.assign(total, 0);
+    // One handle per pool thread, cloned on first use
+    std::vector<PDFDoc*> handles(ThreadPool_Size(), (PDFDoc*)NULL);
+
+    int next = 0;
+    size_t linesSent = 0;
+    std::string chunk;
+    std::vector<size_t> chunkPages;
+    while (next < total) {
+        int end;
+        {
+            std::unique_lock<std::mutex> demand(job->demandLock);
+            job->demandChanged.wait(demand, [&]() {
+                return job->cancelled || next < job->pagesWanted || linesSent < job->linesWanted ||
+                       linesSent - job->linesWanted < LOOKAHEAD_LINES;
+            });
+            end = std::min(total, std::max(next + round, job->pagesWanted));
+        }
+        if (job->cancelled) break;
+
+        for (int i = next; i < end; i++) {
+            ThreadPool_Submit([&batch, &handles, doc, job, i](int worker) {
+                std::string page;
+                if (!job->cancelled) {
+                    if (!handles[worker]) handles[worker] = PDFParse_Clone(doc);
+                    PDFParse_ExtractPage(handles[worker], i, &page);
+                    page.append("\n\n");
+                }
+                std::lock_guard<std::mutex> guard(batch.lock);
+                batch.pages[i].swap(page);
+                batch.done[i] = 1;
+                batch.ready.notify_one();
+            });
+        }
+
+        std::unique_lock<std::mutex> guard(batch.lock);
+        while (next < end) {
+            batch.ready.wait(guard, [&]() { return batch.done[next] != 0; });
+            chunk.clear();
+            chunkPages.clear();
+            size_t lines = linesSent;
+            while (next < end && batch.done[next]) {
+                const std::string& page = batch.pages[next];
+                chunkPages.push_back(lines);
+                lines += std::count(page.begin(), page.end(), '\n');
+                chunk += page;
+                std::string().swap(batch.pages[next]);
+                next++;
+            }
+            guard.unlock();
+            if (!job->cancelled) {
+                linesSent = lines;
+                firstLines->insert(firstLines->end(), chunkPages.begin(), chunkPages.end());
+                all->append(chunk);  // the sink may take 'chunk'
+                SendChunk(job, chunk);
+                SendPages(job, chunkPages, total);
+                SendProgress(job, next, total);
+            }
+            guard.lock();
+        }
+    }
+
+    // Every task submitted so far has finished by now
+    for (size_t i = 0; i < handles.size(); i++) PDFParse_Close(handles[i]);
+    return next == total && !job->cancelled;
+}
+
+// CSV and TSV are parsed straight from the mapped file; UTF-16 is converted
+// first since the parser works on bytes
+static bool LoadTable(LoadJob* job, char delimiter) {
+    std::unique_ptr<LoadedTable> loaded(new LoadedTable());
+    if (!MapFile_Open(job->path.c_str(), &loaded->file)) return false;
+
+    size_t bomSize;
+    const char* data = loaded->file.data;
+    size_t size = loaded->file.size;
+    loaded->encoding = TextEnc_Detect(data, size, &bomSize);
+    if (loaded->encoding == TEXT_UTF16LE || loaded->encoding == TEXT_UTF16BE) {
+        TextEnc_UTF16ToUTF8(data + bomSize, size - bomSize, loaded->encoding == TEXT_UTF16BE, &loaded->text);
+        MapFile_Close(&loaded->file);
+        loaded->encoding = TEXT_UTF8;
+        data = loaded->text.data();
+        size = loaded->text.size();
+    } else {
+        data += bomSize;
+        size -= bomSize;
+    }
+
+    SendProgress(job, 0, 0);
+    if (!CsvTable_Parse(&loaded->table, data, size, delimiter, &job->cancelled)) return job->cancelled;
+    SendTable(job, loaded);
+    SendFinished(job, true, "");
+    return true;
+}
+
+// Only the first sheet is read; it becomes CSV text and is shown like a CSV
+// file. program.py has no XLSX support, so there is nothing to fall back to.
+static void LoadWorkbook(LoadJob* job) {
+    std::string error;
+    XlsxBook* book = Xlsx_Open(job->path.c_str(), &error);
+    if (!book) {
+        SendFinished(job, false, error);
+        return;
+    }
+    if (Xlsx_SheetCount(book) == 0) {
+        Xlsx_Close(book);
+        SendFinished(job, false, "Error: The workbook has no sheets.");
+        return;
+    }
+
+    SendProgress(job, 0, 0);
+    std::unique_ptr<LoadedTable> loaded(new LoadedTable());
+    loaded->encoding = TEXT_UTF8;
+    bool read = Xlsx_ReadSheet(book, 0, &loaded->text, &job->cancelled, &error);
+    Xlsx_Close(book);
+    if (job->cancelled) return;
+    if (!read) {
+        SendFinished(job, false, error);
+        return;
+    }
+    if (!CsvTable_Parse(&loaded->table, loaded->text.data(), loaded->text.size(), ',', &job->cancelled)) return;
+    SendTable(job, loaded);
+    SendFinished(job, true, "");
+}
+
+// Paragraphs are shown as they are parsed. A document damaged part way
+// keeps what was read but is not cached.
+static void LoadDocx(LoadJob* job) {
+    SendProgress(job, 0, 0);
+    std::string all, error;
+    bool sent = false;
+    bool complete = Docx_Extract(job->path.c_str(), [&](std::string& text) {
+        if (job->cancelled) return false;
+        all.append(text);  // the sink may take 'text'
+        SendChunk(job, text);
+        sent = true;
+        return true;
+    }, DOCX_CHUNK, &error);
+    if (job->cancelled) return;
+    if (!complete && !sent) {
+        SendFinished(job, false, error);
+        return;
+    }
+    SendFinished(job, true, "");
+    if (complete) DiskCache_Store(job->path.c_str(), all, NULL);
+}
+
+static void RunJob(LoadJob* job) {
+    const std::string& path = job->path;
+
+    if (!job->expectedType.empty() && path.find_last_of('.') != std::string::npos &&
+        !Loader_HasExtension(path.c_str(), job->expectedType.c_str())) {
+        SendFinished(job, false, "Error: Wrong file type.");
+        return;
+    }
+
+    if (Loader_HasExtension(path.c_str(), "pdf")) {
+        std::string error;
+        PDFDoc* doc = PDFParse_Open(path.c_str(), &error);
+        if (doc) {
+            std::string all;
+            std::vector<size_t> firstLines;
+            bool complete = ExtractPages(job, doc, &all, &firstLines);
+            PDFParse_Close(doc);
+            SendFinished(job, true, "");
+            // Written after the viewer has everything, so it never waits on disk
+            if (complete) DiskCache_Store(path.c_str(), all, &firstLines);
+            return;
+        }
+    }
+
+    if (Loader_HasExtension(path.c_str(), "docx")) {
+        LoadDocx(job);
+        return;
+    }
+
+    if (Loader_HasExtension(path.c_str(), "xlsx")) {
+        LoadWorkbook(job);
+        return;
+    }
+
+    bool isTsv = Loader_HasExtension(path.c_str(), "tsv");
+    if ((isTsv || Loader_HasExtension(path.c_str(), "csv")) && LoadTable(job, isTsv ? '\t' : ',')) return;
+
+    // Python-backed formats arrive in one piece
+    SendProgress(job, 0, 0);
+    std::string text;
+    const char* type = job->expectedType.empty() ? NULL : job->expectedType.c_str();
+    if (!WorkerPool_Extract(path.c_str(), type, &text)) {
+        SendFinished(job, false, "Error: Failed to process file. Make sure Python and the required libraries are installed.");
+        return;
+    }
+    // program.py reports its own failures as text; those are not worth keeping
+    bool cacheable = text.compare(0, 5, "Error") != 0;
+    std::string copy;
+    if (cacheable) copy = text;
+    SendChunk(job, text);
+    SendFinished(job, true, "");
+    if (cacheable) DiskCache_Store(path.c_str(), copy, NULL);
+}
+
+LoadJob* Loader_Start(const char* path, const char* expectedType, LoadSink* sink) {
+    if (!path || !sink) return NULL;
+
+    LoadJob* job = new LoadJob();
+    job->path = path;
+    if (expectedType) job->expectedType = expectedType;
+    job->sink = sink;
+
+    {
+        std::lock_guard<std::mutex> guard(g_runningLock);
+        g_running++;
+    }
+
+    std::thread([job]() {
+        RunJob(job);
+        ReleaseJob(job);
+
+        std::lock_guard<std::mutex> guard(g_runningLock);
+        if (--g_running == 0) g_runningDone.notify_all();
+    }).detach();
+
+    return job;
+}
+
+void Loader_Request(LoadJob* job, size_t lines) {
+    if (!job) return;
+    std::lock_guard<std::mutex> guard(job->demandLock);
+    if (lines <= job->linesWanted) return;
+    job->linesWanted = lines;
+    job->demandChanged.notify_all();
+}
+
+void Loader_RequestPages(LoadJob* job, int pages) {
+    if (!job) return;
+    std::lock_guard<std::mutex> guard(job->demandLock);
+    if (pages <= job->pagesWanted) return;
+    job->pagesWanted = pages;
+    job->demandChanged.notify_all();
+}
+
+void Loader_Cancel(LoadJob* job) {
+    if (!job) return;
+    {
+        // Wakes a loader that is waiting for demand
+        std::lock_guard<std::mutex> guard(job->demandLock);
+        job->cancelled = true;
+        job->demandChanged.notify_all();
+    }
+    {
+        // Waits out a delivery that is already in progress
+        std::lock_guard<std::mutex> guard(job->lock);
+        job->sink = NULL;
+    }
+    ReleaseJob(job);
+}
+
+void Loader_Shutdown() {
+    std::unique_lock<std::mutex> guard(g_runningLock);
+    g_runningDone.wait(guard, []() { return g_running == 0; });
+}
@@ -0,0 +1,66 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "csvtable.h"
+#include "mapfile.h"
+#include "textenc.h"
+
+// A parsed CSV or TSV file and the bytes its cells point into
+struct LoadedTable {
+    MappedFile file;        // the file itself, unless 'text' holds a converted copy
+    std::string text;
+    TextEncoding encoding;
+    CsvTable table;
+
+    LoadedTable() : encoding(TEXT_UTF8) {}
+    ~LoadedTable() { MapFile_Close(&file); }
+};
+
+// Receives the output of a load job. Methods run on the loader thread and are
+// never called again once Loader_Cancel has returned.
+class LoadSink {
+public:
+    virtual ~LoadSink() {}
+
+    // Next piece of document text. The sink may take the contents of 'text'.
+    virtual void OnChunk(std::string& text) = 0;
+    // Follows the chunk holding the starts of these pages, with the line
+    // each one starts on counted from the top of the text. 'total' is the
+    // document's page count. Only paged formats report this.
+    virtual void OnPages(const std::vector<size_t>& firstLines, int total) {}
+    // A tabular file parsed natively, in place of any chunks. The sink may
+    // take ownership.
+    virtual void OnTable(std::unique_ptr<LoadedTable>& table) {}
+    // total is 0 while the amount of work is unknown
+    virtual void OnProgress(int done, int total) = 0;
+    // On failure 'message' explains why
+    virtual void OnFinished(bool ok, const std::string& message) = 0;
+};
+
+// Platform-neutral background document loader. Text is streamed to the sink
+// page by page where the format allows it, so a viewer can draw the first
+// screen long before a large document has finished extracting.
+struct LoadJob;
+
+LoadJob* Loader_Start(const char* path, const char* expectedType, LoadSink* sink);
+// A viewer needs the document through line 'lines'. PDFs are extracted a
+// little past the furthest line asked for, then the loader waits; (size_t)-1
+// asks for all of it. Never waits on a delivery, so it may be called with
+// the sink's own locks held.
+void Loader_Request(LoadJob* job, size_t lines);
+// A viewer jumps to page 'pages'. Every page up to it is extracted at once,
+// without stopping at the lookahead; the text only grows at the end, so the
+// pages before the target have to be in before it can be shown.
+void Loader_RequestPages(LoadJob* job, int pages);
+// Stops delivery to the sink and releases the job handle. Returns without
+// waiting for the extraction itself to wind down.
+void Loader_Cancel(LoadJob* job);
+// Waits for all loader threads to exit; call once every job has been cancelled
+void Loader_Shutdown();
+// Case-insensitive check of the part after the last '.'
+bool Loader_HasExtension(const char* path, const char* ext);
+
+#endif
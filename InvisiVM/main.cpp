@@ -4,8 +4,13 @@
 #include <string>
 #include "ui.h"
 #include "pdf.h"
+#include "worker.h"
+#include "threadpool.h"
 #include "apprun.h"
 #include "constants.h"
+#include "gdicanvas.h"
+#include "damage.h"
+#include "surface.h"
 
 // Global window counter
 static int g_windowCount = 0;
@@ -16,8 +21,15 @@ struct WindowData {
     PDFState pdfState;
     bool isPDFViewer;  // true for PDF viewer, false for home window
     bool isAppRunner;  // true when running embedded app
+    // Back buffer kept between paints, reallocated only when the size changes
+    Surface surface;
+    HDC bufferDC;
+    HBITMAP bufferBitmap;
+    HGDIOBJ oldBitmap;
+    GdiCanvas* canvas;  // draws on bufferDC
     
-    WindowData() : isPDFViewer(false), isAppRunner(false) {}
+    WindowData() : isPDFViewer(false), isAppRunner(false), bufferDC(NULL), bufferBitmap(NULL), oldBitmap(NULL),
+                   canvas(NULL) {}
 };
 
 // Forward declarations
@@ -110,6 +122,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         DispatchMessage(&msg);
     }
 
+    DocStore_Shutdown();
+    WorkerPool_Shutdown();
+    Loader_Shutdown();
+    ThreadPool_Shutdown();
     return (int)msg.wParam;
 }
 
@@ -128,13 +144,6 @@ HWND CreatePDFViewerWindow(HINSTANCE hInstance, const char* pdfPath, const char*
     data->uiState.skipIntro = true;
     data->uiState.showHomeUI = false;
     
-    // Process the file
-    if (!PDF_ProcessFile(pdfPath, &data->pdfState, expectedType)) {
-        MessageBoxA(NULL, "Failed to process file. Check that Python and required libraries are installed.", 
-                   "File Error", MB_OK | MB_ICONWARNING);
-        // Continue anyway to show error message in window
-    }
-    
     // Extract filename for window title
     const char* filename = strrchr(pdfPath, '\\');
     if (!filename) filename = strrchr(pdfPath, '/');
@@ -171,6 +180,9 @@ HWND CreatePDFViewerWindow(HINSTANCE hInstance, const char* pdfPath, const char*
         return NULL;
     }
     
+    // Extract in the background; text appears as pages arrive
+    PDF_StartLoad(hwnd, pdfPath, &data->pdfState, expectedType);
+    
     return hwnd;
 }
 
@@ -212,11 +224,127 @@ HWND CreateAppRunnerWindow(HINSTANCE hInstance) {
     return hwnd;
 }
 
+// Marks each damaged rectangle for the next WM_PAINT
+static void InvalidateDamage(HWND hwnd, const DamageRegion* damage) {
+    for (const RECT& rect : damage->rects) InvalidateRect(hwnd, &rect, FALSE);
+}
+
+// The rectangles Windows has gathered since the last paint, merged where
+// they meet. Must come before BeginPaint, which empties them.
+static void CollectDamage(HWND hwnd, Surface* surface) {
+    HRGN region = CreateRectRgn(0, 0, 0, 0);
+    if (GetUpdateRgn(hwnd, region, FALSE) > NULLREGION) {
+        DWORD size = GetRegionData(region, 0, NULL);
+        std::vector<char> buffer(size);
+        RGNDATA* regionData = (RGNDATA*)buffer.data();
+        if (size > 0 && GetRegionData(region, size, regionData)) {
+            const RECT* rects = (const RECT*)regionData->Buffer;
+            for (DWORD i = 0; i < regionData->rdh.nCount; i++) Surface_Damage(surface, rects[i]);
+        }
+    }
+    DeleteObject(region);
+}
+
+static void FreeBuffer(WindowData* data) {
+    if (!data->bufferDC) return;
+    delete data->canvas;
+    data->canvas = NULL;
+    SelectObject(data->bufferDC, data->oldBitmap);
+    DeleteObject(data->bufferBitmap);
+    DeleteDC(data->bufferDC);
+    data->bufferDC = NULL;
+}
+
+// Gives the back buffer the size of the client area. A minimized window
+// keeps the one it has. Returns false if there is none.
+static bool ResizeBuffer(HWND hwnd, WindowData* data) {
+    RECT clientRect;
+    GetClientRect(hwnd, &clientRect);
+    if (clientRect.right <= 0 || clientRect.bottom <= 0) return data->canvas != NULL;
+    if (!Surface_Resize(&data->surface, clientRect.right, clientRect.bottom) && data->canvas) return true;
+
+    FreeBuffer(data);
+    HDC windowDC = GetDC(hwnd);
+    data->bufferDC = CreateCompatibleDC(windowDC);
+    data->bufferBitmap = CreateCompatibleBitmap(windowDC, clientRect.right, clientRect.bottom);
+    ReleaseDC(hwnd, windowDC);
+    data->oldBitmap = SelectObject(data->bufferDC, data->bufferBitmap);
+    data->canvas = new GdiCanvas(data->bufferDC);
+    return true;
+}
+
+// Everything the window shows; parts outside the canvas's paint area are
+// skipped
+static void DrawWindow(Canvas* canvas, const RECT& clientRect, WindowData* data) {
+    if (!data->uiState.skipIntro && data->uiState.introState != INTRO_COMPLETE) {
+        if (data->uiState.showMainUIBehind) {
+            canvas->FillRect(clientRect, RGB(0, 0, 0));
+            PDF_DrawContent(canvas, clientRect, &data->pdfState);
+            UI_DrawBottomBar(canvas, clientRect, &data->uiState);
+        }
+        UI_DrawIntroSequence(canvas, clientRect, &data->uiState);
+    } else if (data->uiState.showHomeUI) {
+        UI_DrawHomeUI(canvas, clientRect, &data->uiState);
+    } else if (data->isAppRunner && AppRun_IsRunning(&data->uiState.embeddedApp)) {
+        // Draw embedded application view
+        canvas->FillRect(clientRect, RGB(0, 0, 0));
+
+        // Draw app with borders
+        AppRun_Draw(canvas, clientRect, &data->uiState.embeddedApp);
+
+        // Draw bottom bar
+        UI_DrawBottomBar(canvas, clientRect, &data->uiState);
+    } else {
+        // Normal PDF/file view
+        canvas->FillRect(clientRect, RGB(0, 0, 0));
+        PDF_DrawContent(canvas, clientRect, &data->pdfState);
+        UI_DrawBottomBar(canvas, clientRect, &data->uiState);
+    }
+}
+
+class WindowPainter : public SurfacePainter {
+public:
+    WindowPainter(WindowData* data, const RECT& clientRect) : data(data), clientRect(clientRect) {}
+
+    void Draw(Canvas* canvas) override { DrawWindow(canvas, clientRect, data); }
+
+private:
+    WindowData* data;
+    RECT clientRect;
+};
+
+// Moves the document's pixels by the scroll, on screen and in the back
+// buffer, so only what comes into view is drawn. The status bar shows the
+// page and is drawn again.
+static void ScrollView(HWND hwnd, WindowData* data, const PDFScroll& scroll) {
+    if (scroll.dx == 0 && scroll.dy == 0 && !scroll.jumped) return;
+    RECT clientRect;
+    GetClientRect(hwnd, &clientRect);
+    RECT area = PDF_ContentRect(clientRect);
+
+    // Whatever is waiting to be drawn moves with the pixels it covers
+    CollectDamage(hwnd, &data->surface);
+    ValidateRect(hwnd, NULL);
+    if (scroll.jumped || !data->canvas) {
+        Surface_Damage(&data->surface, area);
+    } else {
+        RECT kept = scroll.dy != 0 ? PDF_RowsRect(clientRect, &data->pdfState) : area;
+        RECT moved = Surface_Scroll(&data->surface, data->canvas, area, kept, scroll.dx, scroll.dy);
+        // Parts of the window hidden by others cannot be copied and are
+        // invalidated instead
+        if (!IsRectEmpty(&moved)) ScrollWindowEx(hwnd, scroll.dx, scroll.dy, &kept, &kept, NULL, NULL, SW_INVALIDATE);
+    }
+    Surface_Damage(&data->surface, PDF_StatusRect(clientRect));
+    InvalidateDamage(hwnd, &data->surface.damage);
+}
+
 void HandleMouseMove(HWND hwnd, int x, int y, WindowData* data) {
     if (!data) return;
     
-    UI_HandleMouseMove(x, y, &data->uiState);
-    InvalidateRect(hwnd, NULL, FALSE);
+    // Only buttons whose hover changed are drawn again
+    DamageRegion damage;
+    UI_HandleMouseMove(x, y, &data->uiState, &damage);
+    InvalidateDamage(hwnd, &damage);
 }
 
 void HandleButtonClick(HWND hwnd, int buttonIndex, WindowData* data) {
@@ -257,8 +385,9 @@ void HandleKeyPress(HWND hwnd, WPARAM key, WindowData* data) {
         case KEY_RESET:
             for (auto& button : data->uiState.buttons) {
                 button.Reset();
+                RECT area = UI_ButtonArea(button);
+                InvalidateRect(hwnd, &area, FALSE);
             }
-            InvalidateRect(hwnd, NULL, FALSE);
             break;
     }
 }
@@ -294,6 +423,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             GetClientRect(hwnd, &clientRect);
             UI_UpdateButtonPositions(clientRect, &data->uiState);
             PDF_UpdateScrollInfo(clientRect, &data->pdfState);
+            ResizeBuffer(hwnd, data);
             
             // Update embedded app position if running
             if (data->isAppRunner && AppRun_IsRunning(&data->uiState.embeddedApp)) {
@@ -322,81 +452,33 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             return 0;
 
         case WM_PAINT: {
+            CollectDamage(hwnd, &data->surface);
+
             PAINTSTRUCT ps;
             HDC hdc = BeginPaint(hwnd, &ps);
 
-            if (hdc) {
+            if (hdc && (data->canvas || ResizeBuffer(hwnd, data))) {
                 RECT clientRect;
                 GetClientRect(hwnd, &clientRect);
-                
-                HDC memDC = CreateCompatibleDC(hdc);
-                HBITMAP memBmp = CreateCompatibleBitmap(hdc, clientRect.right, clientRect.bottom);
-                HBITMAP oldBmp = (HBITMAP)SelectObject(memDC, memBmp);
+                if (Damage_Empty(&data->surface.damage)) Surface_Damage(&data->surface, ps.rcPaint);
 
                 // Update button positions
                 UI_UpdateButtonPositions(clientRect, &data->uiState);
 
-                if (!data->uiState.skipIntro && data->uiState.introState != INTRO_COMPLETE) {
-                    if (data->uiState.showMainUIBehind) {
-                        FillRect(memDC, &clientRect, (HBRUSH)GetStockObject(BLACK_BRUSH));
-                        PDF_DrawContent(memDC, clientRect, &data->pdfState);
-                        
-                        RECT bottomBarRect = clientRect;
-                        bottomBarRect.top = clientRect.bottom - BAR_HEIGHT;
-                        HBRUSH greyBrush = CreateSolidBrush(RGB(60, 60, 60));
-                        FillRect(memDC, &bottomBarRect, greyBrush);
-                        DeleteObject(greyBrush);
-
-                        for (const auto& button : data->uiState.buttons) {
-                            UI_DrawButton(memDC, button);
-                        }
-                    }
-                    UI_DrawIntroSequence(memDC, clientRect, &data->uiState);
-                } else {
-                    if (data->uiState.showHomeUI) {
-                        UI_DrawHomeUI(memDC, clientRect, &data->uiState);
-                    } else if (data->isAppRunner && AppRun_IsRunning(&data->uiState.embeddedApp)) {
-                        // Draw embedded application view
-                        FillRect(memDC, &clientRect, (HBRUSH)GetStockObject(BLACK_BRUSH));
-                        
-                        // Draw app with borders
-                        AppRun_Draw(memDC, clientRect, &data->uiState.embeddedApp);
-                        
-                        // Draw bottom bar
-                        RECT bottomBarRect = clientRect;
-                        bottomBarRect.top = clientRect.bottom - BAR_HEIGHT;
-                        HBRUSH greyBrush = CreateSolidBrush(RGB(60, 60, 60));
-                        FillRect(memDC, &bottomBarRect, greyBrush);
-                        DeleteObject(greyBrush);
-
-                        for (const auto& button : data->uiState.buttons) {
-                            UI_DrawButton(memDC, button);
-                        }
-                        
-                        // Update window title
-                        SetWindowTextW(hwnd, AppRun_GetWindowTitle(&data->uiState.embeddedApp).c_str());
-                    } else {
-                        // Normal PDF/file view
-                        FillRect(memDC, &clientRect, (HBRUSH)GetStockObject(BLACK_BRUSH));
-                        PDF_DrawContent(memDC, clientRect, &data->pdfState);
-
-                        RECT bottomBarRect = clientRect;
-                        bottomBarRect.top = clientRect.bottom - BAR_HEIGHT;
-                        HBRUSH greyBrush = CreateSolidBrush(RGB(60, 60, 60));
-                        FillRect(memDC, &bottomBarRect, greyBrush);
-                        DeleteObject(greyBrush);
-
-                        for (const auto& button : data->uiState.buttons) {
-                            UI_DrawButton(memDC, button);
-                        }
-                    }
+                // Only the damaged rectangles are drawn and copied out; the
+                // rest of the buffer still holds the last paint
+                WindowPainter painter(data, clientRect);
+                DamageRegion drawn;
+                Surface_Paint(&data->surface, data->canvas, &painter, &drawn);
+                for (const RECT& rect : drawn.rects) {
+                    BitBlt(hdc, rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top,
+                           data->bufferDC, rect.left, rect.top, SRCCOPY);
                 }
 
-                BitBlt(hdc, 0, 0, clientRect.right, clientRect.bottom, memDC, 0, 0, SRCCOPY);
-
-                SelectObject(memDC, oldBmp);
-                DeleteObject(memBmp);
-                DeleteDC(memDC);
+                // Update window title
+                if (data->isAppRunner && !data->uiState.showHomeUI && AppRun_IsRunning(&data->uiState.embeddedApp)) {
+                    SetWindowTextW(hwnd, AppRun_GetWindowTitle(&data->uiState.embeddedApp).c_str());
+                }
             }
 
             EndPaint(hwnd, &ps);
@@ -418,7 +500,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 FileType selectedType;
                 if (UI_HandleHomeButtonClick(x, y, &data->uiState, &selectedType)) {
                     SetCapture(hwnd);
-                    InvalidateRect(hwnd, NULL, FALSE);
+                    RECT area = UI_FileButtonArea(&data->uiState, selectedType);
+                    InvalidateRect(hwnd, &area, FALSE);
                     return 0;
                 }
             }
@@ -428,7 +511,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             if (data->uiState.clickedButton >= 0) {
                 data->uiState.buttons[data->uiState.clickedButton].state = STATE_CLICKED;
                 SetCapture(hwnd);
-                InvalidateRect(hwnd, NULL, FALSE);
+                RECT area = UI_ButtonArea(data->uiState.buttons[data->uiState.clickedButton]);
+                InvalidateRect(hwnd, &area, FALSE);
             }
             return 0;
         }
@@ -439,6 +523,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 
             if (data->uiState.showHomeUI && data->uiState.pressedFileButton >= 0) {
                 FileType selectedType = (FileType)data->uiState.pressedFileButton;
+                // The release clears the pressed look
+                RECT pressedArea = UI_FileButtonArea(&data->uiState, selectedType);
                 
                 // Handle application embedding
                 if (selectedType == FILE_APP) {
@@ -462,7 +548,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                             }
                         }
                         ReleaseCapture();
-                        InvalidateRect(hwnd, NULL, FALSE);
+                        InvalidateRect(hwnd, &pressedArea, FALSE);
                         return 0;
                     }
                 } else {
@@ -471,7 +557,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                                                   (HINSTANCE)GetWindowLongPtr(hwnd, GWLP_HINSTANCE),
                                                   selectedType)) {
                         ReleaseCapture();
-                        InvalidateRect(hwnd, NULL, FALSE);
+                        InvalidateRect(hwnd, &pressedArea, FALSE);
                         return 0;
                     }
                 }
@@ -482,25 +568,41 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                     HandleButtonClick(hwnd, data->uiState.clickedButton, data);
                 }
                 
+                RECT area = UI_ButtonArea(data->uiState.buttons[data->uiState.clickedButton]);
+                InvalidateRect(hwnd, &area, FALSE);
                 data->uiState.clickedButton = -1;
                 ReleaseCapture();
-                InvalidateRect(hwnd, NULL, FALSE);
             }
             return 0;
         }
 
         case WM_KEYDOWN:
+            // The find bar gets keys first so typing '1' in it does not close the window
+            if (data->isPDFViewer && PDF_HandleKeyDown(hwnd, wParam, &data->pdfState)) return 0;
             HandleKeyPress(hwnd, wParam, data);
             return 0;
 
+        case WM_CHAR:
+            if (data->isPDFViewer) PDF_HandleChar(hwnd, wParam, &data->pdfState);
+            return 0;
+
         case WM_VSCROLL:
-            PDF_HandleScroll(hwnd, msg, wParam, lParam, &data->pdfState);
-            InvalidateRect(hwnd, NULL, FALSE);
+            ScrollView(hwnd, data, PDF_HandleScroll(hwnd, msg, wParam, lParam, &data->pdfState));
             return 0;
         
+        case WM_HSCROLL:
+            ScrollView(hwnd, data, PDF_HandleHScroll(hwnd, wParam, &data->pdfState));
+            return 0;
+
         case WM_MOUSEWHEEL:
-            PDF_HandleMouseWheel(hwnd, wParam, &data->pdfState);
-            InvalidateRect(hwnd, NULL, FALSE);
+            ScrollView(hwnd, data, PDF_HandleMouseWheel(hwnd, wParam, &data->pdfState));
+            return 0;
+
+        case WM_PDF_LOADER:
+            if (!PDF_HandleLoaderUpdate(hwnd, &data->pdfState)) {
+                MessageBoxA(hwnd, "Failed to process file. Check that Python and required libraries are installed.", 
+                           "File Error", MB_OK | MB_ICONWARNING);
+            }
             return 0;
 
         case WM_DESTROY:
@@ -511,6 +613,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 AppRun_Cleanup(&data->uiState.embeddedApp);
             }
             
+            // Let go of the shared document before the state goes away
+            PDF_Cleanup(&data->pdfState);
+            FreeBuffer(data);
+            
             delete data;  // Clean up window data
             g_windowCount--;  // Decrement window count
             
@@ -0,0 +1,22 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only view of a whole file. Pages are faulted in by the OS as they
+// are touched, so opening is O(1) in the file size.
+struct MappedFile {
+    const char* data;
+    size_t size;
+
+    MappedFile() : data(NULL), size(0) {}
+};
+
+// An empty file maps successfully with data == NULL
+bool MapFile_Open(const char* path, MappedFile* file);
+void MapFile_Close(MappedFile* file);
+// Size and last write time, enough to tell whether a file changed
+bool MapFile_Stamp(const char* path, uint64_t* size, uint64_t* mtime);
+
+#endif
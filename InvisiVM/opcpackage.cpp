@@ -0,0 +1,127 @@
+#include <cstring>
+#include "opcpackage.h"
+
+// Parts are inflated and parsed this much at a time
+static const size_t STREAM_CHUNK = 1 << 20;
+
+static InflateSink FeedScanner(XmlScanner* xml, const std::atomic<bool>* cancel) {
+    return [xml, cancel](const char* data, size_t size) {
+        if (cancel && *cancel) return false;
+        Xml_Feed(xml, data, size);
+        return true;
+    };
+}
+
+bool Opc_ParsePart(const ZipArchive* zip, const std::string& part, XmlHandler* handler,
+                   const std::atomic<bool>* cancel, InflateWindow* window) {
+    const ZipEntry* entry = Zip_Find(zip, part);
+    if (!entry) return false;
+    XmlScanner xml;
+    Xml_Begin(&xml, handler);
+    bool ok = Zip_Stream(zip, entry, FeedScanner(&xml, cancel), STREAM_CHUNK, window);
+    return Xml_Finish(&xml) && ok;
+}
+
+void Opc_ParseParts(const ZipArchive* zip, const std::vector<std::string>& parts,
+                    const std::vector<XmlHandler*>& handlers, const std::atomic<bool>* cancel,
+                    std::vector<char>* ok) {
+    ok->assign(parts.size(), 0);
+    std::vector<XmlScanner> scanners(parts.size());
+    std::vector<const ZipEntry*> entries;
+    std::vector<InflateSink> sinks;
+    std::vector<size_t> present;  // index in 'parts' of each entry
+    for (size_t i = 0; i < parts.size() && i < handlers.size(); i++) {
+        const ZipEntry* entry = Zip_Find(zip, parts[i]);
+        if (!entry) continue;
+        Xml_Begin(&scanners[i], handlers[i]);
+        entries.push_back(entry);
+        sinks.push_back(FeedScanner(&scanners[i], cancel));
+        present.push_back(i);
+    }
+
+    std::vector<char> streamed;
+    Zip_StreamParallel(zip, entries, sinks, STREAM_CHUNK, &streamed);
+    for (size_t k = 0; k < present.size(); k++) {
+        size_t i = present[k];
+        (*ok)[i] = Xml_Finish(&scanners[i]) && streamed[k];
+    }
+}
+
+std::string Opc_Folder(const std::string& part) {
+    size_t slash = part.rfind('/');
+    return slash == std::string::npos ? std::string() : part.substr(0, slash + 1);
+}
+
+// Targets are relative to the source part's folder unless they start with '/'
+static std::string Resolve(const std::string& folder, const std::string& target) {
+    std::string path = !target.empty() && target[0] == '/' ? target.substr(1) : folder + target;
+    std::vector<std::string> parts;
+    size_t pos = 0;
+    while (pos <= path.size()) {
+        size_t slash = path.find('/', pos);
+        if (slash == std::string::npos) slash = path.size();
+        std::string part = path.substr(pos, slash - pos);
+        if (part == "..") {
+            if (!parts.empty()) parts.pop_back();
+        } else if (!part.empty() && part != ".") {
+            parts.push_back(part);
+        }
+        pos = slash + 1;
+    }
+    std::string joined;
+    for (size_t i = 0; i < parts.size(); i++) {
+        if (i > 0) joined.push_back('/');
+        joined += parts[i];
+    }
+    return joined;
+}
+
+class RelsReader : public XmlHandler {
+public:
+    RelsReader(const std::string& folder, std::vector<OpcRelationship>* rels) : folder(folder), rels(rels) {}
+
+    void OnStart(std::string_view name, const std::vector<XmlAttr>& attrs) override {
+        if (Xml_LocalName(name) != "Relationship") return;
+        OpcRelationship rel;
+        Xml_AppendText(Xml_Attr(attrs, "Id"), &rel.id);
+        Xml_AppendText(Xml_Attr(attrs, "Type"), &rel.type);
+        std::string target;
+        Xml_AppendText(Xml_Attr(attrs, "Target"), &target);
+        rel.target = Resolve(folder, target);
+        rels->push_back(rel);
+    }
+
+private:
+    std::string folder;
+    std::vector<OpcRelationship>* rels;
+};
+
+bool Opc_Relationships(const ZipArchive* zip, const std::string& part, std::vector<OpcRelationship>* rels) {
+    std::string folder = Opc_Folder(part);
+    std::string relsPart = folder + "_rels/" + part.substr(folder.size()) + ".rels";
+    RelsReader reader(folder, rels);
+    return Opc_ParsePart(zip, relsPart, &reader, NULL, NULL);
+}
+
+const OpcRelationship* Opc_FindType(const std::vector<OpcRelationship>& rels, const char* suffix) {
+    size_t n = strlen(suffix);
+    for (size_t i = 0; i < rels.size(); i++) {
+        const std::string& type = rels[i].type;
+        if (type.size() >= n && type.compare(type.size() - n, n, suffix) == 0) return &rels[i];
+    }
+    return NULL;
+}
+
+const OpcRelationship* Opc_FindId(const std::vector<OpcRelationship>& rels, const std::string& id) {
+    for (size_t i = 0; i < rels.size(); i++) {
+        if (rels[i].id == id) return &rels[i];
+    }
+    return NULL;
+}
+
+std::string Opc_MainPart(const ZipArchive* zip, const char* fallback) {
+    std::vector<OpcRelationship> rels;
+    Opc_Relationships(zip, "", &rels);
+    const OpcRelationship* main = Opc_FindType(rels, "/officeDocument");
+    return main ? main->target : std::string(fallback);
+}
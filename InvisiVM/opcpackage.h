@@ -0,0 +1,37 @@
+#ifndef OPCPACKAGE_H
+#define OPCPACKAGE_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "xmlscan.h"
+#include "ziparchive.h"
+
+// Office Open XML packaging shared by the DOCX and XLSX readers: parts are
+// zip members found through relationship (.rels) files.
+struct OpcRelationship {
+    std::string id;
+    std::string type;
+    std::string target;  // resolved to a member name
+};
+
+// Streams a part through the XML scanner. False if the part is missing or
+// damaged, or 'cancel' was set. 'window' may be NULL; see InflateWindow.
+bool Opc_ParsePart(const ZipArchive* zip, const std::string& part, XmlHandler* handler,
+                   const std::atomic<bool>* cancel, InflateWindow* window);
+// Parses independent parts at the same time with Zip_StreamParallel;
+// ok[i] is what Opc_ParsePart would have returned for parts[i]
+void Opc_ParseParts(const ZipArchive* zip, const std::vector<std::string>& parts,
+                    const std::vector<XmlHandler*>& handlers, const std::atomic<bool>* cancel,
+                    std::vector<char>* ok);
+// Relationships of 'part', or of the package itself when 'part' is empty
+bool Opc_Relationships(const ZipArchive* zip, const std::string& part, std::vector<OpcRelationship>* rels);
+// First relationship whose type URI ends with 'suffix', e.g. "/styles"
+const OpcRelationship* Opc_FindType(const std::vector<OpcRelationship>& rels, const char* suffix);
+const OpcRelationship* Opc_FindId(const std::vector<OpcRelationship>& rels, const std::string& id);
+// The package's main part, or 'fallback' if the package does not say
+std::string Opc_MainPart(const ZipArchive* zip, const char* fallback);
+// "xl/workbook.xml" -> "xl/"
+std::string Opc_Folder(const std::string& part);
+
+#endif
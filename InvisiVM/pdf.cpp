@@ -1,187 +1,745 @@
 #include <windows.h>
-#include <fstream>
-#include <sstream>
-#include <direct.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
 #include <algorithm>
 #include "pdf.h"
 #include "constants.h"
+#include "threadpool.h"
+
+static const int HSCROLL_STEP = 40;
+
+// Wakes a viewer window when its document changes. Several windows may
+// watch the same document; each coalesces to one pending message.
+class ViewerLink : public DocObserver {
+public:
+    explicit ViewerLink(HWND hwnd) : hwnd(hwnd), posted(false) {}
+
+    void OnDocumentChanged() override {
+        if (!posted.exchange(true)) PostMessage(hwnd, WM_PDF_LOADER, 0, 0);
+    }
+
+    // Called by the UI thread before it reads the document
+    void Clear() { posted = false; }
+
+private:
+    HWND hwnd;
+    std::atomic<bool> posted;
+};
+
+// Texts this small are searched on the spot. Larger ones are scanned on the
+// thread pool unless a literal search can use the document's index.
+static const size_t SCAN_SYNC_BYTES = 4 << 20;
+// Blocks between updates from a running scan, so hits show as they come
+static const size_t SCAN_POST_BLOCKS = 64;
+
+static void CancelScan(PDFState* state) {
+    if (state->matchScan) state->matchScan->cancel = true;
+    state->matchScan.reset();
+    state->matchOrdinal = 0;
+}
 
 void PDF_Initialize(PDFState* state) {
     if (!state) return;
     
-    state->extractedText = "No PDF loaded. Right-click a PDF file and select 'Open with InvisVM' to view content.";
+    PDF_Cleanup(state);
+    state->doc = DocStore_FromText("No PDF loaded. Right-click a PDF file and select 'Open with InvisVM' to view content.");
     state->scrollPos = 0;
+    state->scrollUnit = 0;
     state->maxScrollPos = 0;
     state->pageSize = 10;
     state->lineHeight = LINE_HEIGHT;
-    state->textLines.clear();
-}
-
-// Process PDF or other files via Python script
-bool PDF_ProcessFile(const char* pdfPath, PDFState* state, const char* expectedType) {
-    if (!state || !pdfPath || strlen(pdfPath) == 0) return false;
-
-    // Optional type validation
-    if (expectedType) {
-        std::string ext = pdfPath;
-        size_t dotPos = ext.find_last_of('.');
-        if (dotPos != std::string::npos) {
-            std::string actualExt = ext.substr(dotPos + 1);
-            if (_stricmp(actualExt.c_str(), expectedType) != 0) {
-                state->extractedText = "Error: Wrong file type.";
-                return false;
+}
+
+void PDF_StartLoad(HWND hwnd, const char* pdfPath, PDFState* state, const char* expectedType) {
+    if (!state || !pdfPath || strlen(pdfPath) == 0) return;
+
+    PDF_Cleanup(state);
+    state->filename = pdfPath;
+    state->scrollPos = 0;
+    state->scrollUnit = 0;
+    state->maxScrollPos = 0;
+    state->scrollX = 0;
+    state->maxScrollX = 0;
+    state->failureShown = false;
+
+    // Another window may already have this file open or loading, in which
+    // case both share one copy of the text
+    state->link = new ViewerLink(hwnd);
+    state->doc = DocStore_Open(pdfPath, expectedType, state->link);
+    // Picks up whatever the document already has
+    state->link->OnDocumentChanged();
+}
+
+void PDF_Cleanup(PDFState* state) {
+    if (!state) return;
+    // After the release the link is never called again
+    DocStore_Release(state->doc, state->link);
+    delete state->link;
+    state->link = NULL;
+    TextEnc_ClearCache(&state->wideLines);
+    Wrap_Clear(&state->wrap);
+    state->grid = GridLayout();
+    state->gridTable = NULL;
+    CancelScan(state);
+    state->matchAt = SEARCH_NONE;
+    state->gotoOpen = false;
+    state->pendingPage = 0;
+}
+
+void PDF_Invalidate(HWND hwnd, bool content) {
+    RECT clientRect;
+    GetClientRect(hwnd, &clientRect);
+    RECT statusRect = PDF_StatusRect(clientRect);
+    InvalidateRect(hwnd, &statusRect, FALSE);
+    if (content) {
+        RECT contentRect = PDF_ContentRect(clientRect);
+        InvalidateRect(hwnd, &contentRect, FALSE);
+    }
+}
+
+// Both scroll bars from the state; the horizontal one only shows for a grid
+// wider than the window
+static void ApplyScrollBars(HWND hwnd, PDFState* state) {
+    SetScrollRange(hwnd, SB_VERT, 0, std::max(1, state->maxScrollPos), FALSE);
+    SetScrollPos(hwnd, SB_VERT, state->scrollPos, TRUE);
+
+    bool showH = state->maxScrollX > 0;
+    if (showH != state->hScrollShown) {
+        state->hScrollShown = showH;
+        ShowScrollBar(hwnd, SB_HORZ, showH);
+    }
+    if (showH) {
+        SetScrollRange(hwnd, SB_HORZ, 0, state->maxScrollX, FALSE);
+        SetScrollPos(hwnd, SB_HORZ, state->scrollX, TRUE);
+    }
+}
+
+// Advances in the font selected into a DC. The viewer never changes fonts,
+// so a window DC measures the same as the one painted on.
+class GdiMeasurer : public GlyphMeasurer {
+public:
+    explicit GdiMeasurer(HDC hdc) : hdc(hdc) {}
+
+    void Measure(wchar_t first, wchar_t last, int* advances) override {
+        if (!GetCharWidth32W(hdc, first, last, advances)) std::fill(advances, advances + (last - first + 1), 0);
+    }
+
+private:
+    HDC hdc;
+};
+
+// Line i of the text laid out for the current width. Needs the document lock.
+static const WrapLine* WrappedLine(PDFState* state, const Document* doc, size_t i, GlyphMeasurer* measurer) {
+    std::string scratch;
+    std::string_view line = Doc_Line(doc, i, &scratch);
+    const std::wstring& wide = TextEnc_CachedLine(&state->wideLines, i, line, doc->encoding);
+    return Wrap_Line(&state->wrap, i, wide, measurer);
+}
+
+// Moves (*line, *unit) by 'delta' rows of wrapped text within the first
+// 'lineCount' lines. Returns how many rows it moved. Needs the document lock.
+static int StepRows(PDFState* state, const Document* doc, GlyphMeasurer* measurer, size_t lineCount,
+                    size_t* line, size_t* unit, int delta) {
+    int moved = 0;
+    for (; delta > 0 && *line < lineCount; delta--, moved++) {
+        const WrapLine* wrapped = WrappedLine(state, doc, *line, measurer);
+        size_t row = Wrap_RowAt(wrapped, *unit);
+        if (row + 1 < Wrap_Rows(wrapped)) {
+            *unit = wrapped->starts[row + 1];
+        } else if (*line + 1 < lineCount) {
+            (*line)++;
+            *unit = 0;
+        } else {
+            break;
+        }
+    }
+    for (; delta < 0 && *line < lineCount; delta++, moved++) {
+        const WrapLine* wrapped = WrappedLine(state, doc, *line, measurer);
+        size_t row = Wrap_RowAt(wrapped, *unit);
+        if (row > 0) {
+            *unit = wrapped->starts[row - 1];
+        } else if (*line > 0) {
+            (*line)--;
+            *unit = WrappedLine(state, doc, *line, measurer)->starts.back();
+        } else {
+            break;
+        }
+    }
+    return moved;
+}
+
+// Scrolls by rows as drawn: wrapped rows of text, or rows of a table. Once
+// the whole text is known the last row never rises above the bottom of the
+// view, which the scroll range alone cannot promise for wrapped lines.
+// Returns how many rows the view moved down, negative for up.
+static int ScrollRows(HWND hwnd, PDFState* state, int delta) {
+    if (!state->doc) return 0;
+    if (state->gridTable || state->wrap.width <= 0) {
+        int from = state->scrollPos;
+        state->scrollPos = std::max(0, std::min(state->scrollPos + delta, state->maxScrollPos));
+        state->scrollUnit = 0;
+        SetScrollPos(hwnd, SB_VERT, state->scrollPos, TRUE);
+        return state->scrollPos - from;
+    }
+
+    HDC hdc = GetDC(hwnd);
+    GdiMeasurer measurer(hdc);
+    int moved;
+    {
+        std::lock_guard<std::mutex> guard(state->doc->lock);
+        Document* doc = state->doc.get();
+        // Every row is at least a line, so this many lines cover the move
+        Doc_IndexThrough(doc, (size_t)state->scrollPos + std::max(delta, 0) + state->pageSize);
+        size_t lineCount = Doc_LineCount(doc);
+        size_t line = (size_t)state->scrollPos;
+        size_t unit = state->scrollUnit;
+        moved = StepRows(state, doc, &measurer, lineCount, &line, &unit, delta);
+        if (delta < 0) moved = -moved;
+
+        size_t size;
+        Doc_Text(doc, &size);
+        if (!doc->loading && doc->lines.scanned >= size) {
+            size_t endLine = line, endUnit = unit;
+            int below = StepRows(state, doc, &measurer, lineCount, &endLine, &endUnit, state->pageSize - 1);
+            if (below < state->pageSize - 1) {
+                moved -= StepRows(state, doc, &measurer, lineCount, &line, &unit, below - (state->pageSize - 1));
             }
         }
+        state->scrollPos = (int)std::min<size_t>(line, 0x7FFFFFFF);
+        state->scrollUnit = unit;
     }
+    ReleaseDC(hwnd, hdc);
+    SetScrollPos(hwnd, SB_VERT, state->scrollPos, TRUE);
+    return moved;
+}
+
+// Column widths come from the window's font the first time a table shows up
+static void MeasureGrid(HWND hwnd, PDFState* state) {
+    std::lock_guard<std::mutex> guard(state->doc->lock);
+    const CsvTable* table = state->doc->table ? &state->doc->table->table : NULL;
+    if (table == state->gridTable) return;
+
+    state->grid = GridLayout();
+    state->gridTable = table;
+    if (!table) return;
 
-    // Get executable directory
-    char exeDir[MAX_PATH];
-    if (GetModuleFileNameA(NULL, exeDir, MAX_PATH) == 0) {
-        state->extractedText = "Error: Failed to get executable path.";
-        return false;
+    int charWidth = 8;
+    HDC hdc = GetDC(hwnd);
+    if (hdc) {
+        TEXTMETRIC tm;
+        if (GetTextMetrics(hdc, &tm) && tm.tmAveCharWidth > 0) charWidth = tm.tmAveCharWidth;
+        ReleaseDC(hwnd, hdc);
+    }
+    GridLayout_Measure(&state->grid, table, charWidth, CELL_PADDING);
+}
+
+// A document that is still partly indexed or extracted gets a better line
+// count estimate, and asks for more text, each time the view settles
+static void RefineScrollRange(HWND hwnd, PDFState* state) {
+    if (!state->doc) return;
+    {
+        std::lock_guard<std::mutex> guard(state->doc->lock);
+        size_t size;
+        Doc_Text(state->doc.get(), &size);
+        bool partlyIndexed = state->doc->mapped.data && state->doc->lines.scanned < size;
+        if (!partlyIndexed && !state->doc->loading) return;
     }
 
-    char* lastSlash = strrchr(exeDir, '\\');
-    if (lastSlash) *lastSlash = '\0';
+    RECT clientRect;
+    GetClientRect(hwnd, &clientRect);
+    PDF_UpdateScrollInfo(clientRect, state);
+    ApplyScrollBars(hwnd, state);
+}
 
-    if (_chdir(exeDir) != 0) {
-        state->extractedText = "Error: Failed to change directory.";
-        return false;
+// Scans the text once it is final, starting at 'from'. The task keeps the
+// document alive and posts WM_PDF_LOADER as hits come in and when it is done.
+static void StartScan(HWND hwnd, PDFState* state, size_t from) {
+    CancelScan(state);
+    std::shared_ptr<Document> doc = state->doc;
+    std::shared_ptr<const SearchIndex> index;
+    size_t size;
+    {
+        std::lock_guard<std::mutex> guard(doc->lock);
+        if (doc->loading || !PDF_HasQuery(state)) return;
+        Doc_SearchText(doc.get(), &size);
+        index = doc->search;
     }
 
-    // Check Python script
-    std::ifstream scriptCheck("program.py");
-    if (!scriptCheck.good()) {
-        state->extractedText = "Error: program.py not found in executable directory.";
-        return false;
+    std::shared_ptr<MatchScan> scan = std::make_shared<MatchScan>();
+    Search_StartCounts(&state->query, size);
+    scan->query = state->query;
+    scan->from = std::min(from, size);
+    scan->size = size;
+    state->searchFrom = scan->from;
+    state->matchScan = scan;
+    ThreadPool_Submit([doc, index, scan, hwnd](int) {
+        size_t size;
+        const char* text = Doc_SearchText(doc.get(), &size);
+        const SearchQuery* query = &scan->query;
+        size_t blocks = query->counts->blocks;
+        size_t start = scan->from / SEARCH_BLOCK;
+        size_t lastPost = 0;
+        for (size_t i = 0; i < blocks; i++) {
+            if (scan->cancel) return;
+            size_t b = (start + i) % blocks;
+            size_t count = Search_CountBlock(index.get(), query, text, size, b);
+            scan->found += count;
+            bool first = false;
+            if (count > 0 && scan->firstHit == SEARCH_NONE) {
+                // The starting block may only have matches before 'from'
+                size_t hit = Search_Next(index.get(), query, text, size, i == 0 ? scan->from : b * SEARCH_BLOCK, NULL);
+                if (hit < (b + 1) * SEARCH_BLOCK) {
+                    scan->firstHit = hit;
+                    first = true;
+                }
+            }
+            if (first || i - lastPost >= SCAN_POST_BLOCKS) {
+                PostMessage(hwnd, WM_PDF_LOADER, 0, 0);
+                lastPost = i;
+            }
+        }
+        if (scan->firstHit == SEARCH_NONE && scan->found > 0) {
+            scan->firstHit = Search_Next(index.get(), query, text, size, 0, NULL);
+        }
+        scan->done = true;
+        PostMessage(hwnd, WM_PDF_LOADER, 0, 0);
+    });
+}
+
+// Needs the document lock
+static void UpdateOrdinal(PDFState* state, const Document* doc) {
+    state->matchOrdinal = 0;
+    const MatchScan* scan = state->matchScan.get();
+    if (!scan || !scan->done || state->matchAt == SEARCH_NONE) return;
+    size_t size;
+    const char* text = Doc_SearchText(doc, &size);
+    const SearchCounts* counts = scan->query.counts.get();
+    size_t block = state->matchAt / SEARCH_BLOCK;
+    size_t before = 0;
+    for (size_t b = 0; b < block && b < counts->blocks; b++) before += counts->perBlock[b].load();
+    before += Search_Count(doc->search.get(), &state->query, text, size, block * SEARCH_BLOCK, state->matchAt);
+    state->matchOrdinal = before + 1;
+}
+
+// Where a new search starts: the first line in view
+static size_t ViewOffset(const PDFState* state, const Document* doc, const char* text) {
+    std::string_view line;
+    std::string scratch;
+    if (doc->table) {
+        line = CsvTable_RawCell(&doc->table->table, state->scrollPos, 0);
+    } else {
+        line = Doc_Line(doc, state->scrollPos, &scratch);
     }
-    scriptCheck.close();
+    return line.data() ? (size_t)(line.data() - text) : 0;
+}
+
+// Brings the current match into view, a third of the way down so the
+// lines before it show too
+static void ShowMatch(HWND hwnd, PDFState* state) {
+    size_t top = (size_t)state->scrollPos;
+    if (state->matchAt != SEARCH_NONE &&
+        (state->matchLine < top || state->matchLine >= top + (size_t)state->pageSize)) {
+        size_t target = state->matchLine - std::min<size_t>(state->matchLine, state->pageSize / 3);
+        state->scrollPos = (int)std::min<size_t>(target, 0x7FFFFFFF);
+        state->scrollUnit = 0;
+        RECT clientRect;
+        GetClientRect(hwnd, &clientRect);
+        PDF_UpdateScrollInfo(clientRect, state);
+        ApplyScrollBars(hwnd, state);
+    }
+    PDF_Invalidate(hwnd, true);
+}
 
-    // Build command
-    std::string command = "python program.py \"";
-    command += pdfPath;
-    command += "\" 2>nul"; // suppress stderr
+// Needs the document lock
+static void SetMatch(PDFState* state, Document* doc, size_t at, size_t length) {
+    state->matchAt = at;
+    state->matchLength = length;
+    if (at != SEARCH_NONE) state->matchLine = Doc_LineAtOffset(doc, at);
+    UpdateOrdinal(state, doc);
+}
 
-    int result = system(command.c_str());
-    if (result != 0) {
-        state->extractedText = "Error: Failed to process PDF file. Make sure Python and pypdf are installed.";
-        return false;
+// Moves to the next or previous match, wrapping at either end. A changed
+// query starts at the current match, or the view if there is none, so
+// typing more of a word keeps the match in place.
+static void FindMatch(HWND hwnd, PDFState* state, bool forward, bool again) {
+    Document* doc = state->doc.get();
+    {
+        std::lock_guard<std::mutex> guard(doc->lock);
+        size_t size;
+        const char* text = Doc_SearchText(doc, &size);
+        const SearchIndex* index = doc->search.get();
+        size_t from = state->matchAt != SEARCH_NONE ? state->matchAt : ViewOffset(state, doc, text);
+        size_t found, length = 0;
+        if (forward) {
+            if (again && state->matchAt != SEARCH_NONE) from++;
+            found = Search_Next(index, &state->query, text, size, from, &length);
+            if (found == SEARCH_NONE && from > 0) found = Search_Next(index, &state->query, text, size, 0, &length);
+        } else {
+            found = Search_Prev(index, &state->query, text, size, from, &length);
+            if (found == SEARCH_NONE) found = Search_Prev(index, &state->query, text, size, size, &length);
+        }
+        SetMatch(state, doc, found, length);
     }
+    ShowMatch(hwnd, state);
+}
 
-    // Read extracted text
-    std::ifstream file("text.txt");
-    if (!file.is_open()) {
-        state->extractedText = "Error: Failed to read extracted text file.";
-        return false;
+// A new query is looked for at once where that is quick. Otherwise the
+// background scan finds the first match, and the view jumps there when it
+// reports in.
+static void QueryChanged(HWND hwnd, PDFState* state) {
+    CancelScan(state);
+    std::string pattern;
+    size_t from;
+    bool searchNow;
+    {
+        std::lock_guard<std::mutex> guard(state->doc->lock);
+        Document* doc = state->doc.get();
+        TextEnc_FromWide(state->findText.data(), state->findText.size(), doc->encoding, &pattern);
+        // A PDF extracted on demand is taken to the end so all of it is searched
+        if (!pattern.empty() && doc->loading && doc->job) Loader_Request(doc->job, (size_t)-1);
+        size_t size;
+        const char* text = Doc_SearchText(doc, &size);
+        from = state->matchAt != SEARCH_NONE ? state->matchAt : ViewOffset(state, doc, text);
+        searchNow = doc->loading || size < SCAN_SYNC_BYTES || (doc->search && !state->findRegex);
+    }
+    state->findError = !Search_Prepare(&state->query, pattern, state->findRegex);
+    if (!PDF_HasQuery(state)) {
+        state->matchAt = SEARCH_NONE;
+        PDF_Invalidate(hwnd, true);
+        return;
     }
+    if (searchNow) {
+        FindMatch(hwnd, state, true, false);
+        if (state->matchAt != SEARCH_NONE) from = state->matchAt;
+    } else {
+        state->matchAt = SEARCH_NONE;
+        PDF_Invalidate(hwnd, true);
+    }
+    StartScan(hwnd, state, from);
+}
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    state->extractedText = buffer.str();
-    file.close();
+// Catches the find bar up with the scan and the document: the scan's first
+// hit is shown if nothing was found before it, a finished scan numbers the
+// current match, and a load that has finished gets scanned
+static void RefreshSearch(HWND hwnd, PDFState* state) {
+    bool loading, jump = false;
+    size_t size;
+    {
+        std::lock_guard<std::mutex> guard(state->doc->lock);
+        Document* doc = state->doc.get();
+        loading = doc->loading;
+        const char* text = Doc_SearchText(doc, &size);
+        const MatchScan* scan = state->matchScan.get();
+        if (scan && state->matchAt == SEARCH_NONE && scan->firstHit != SEARCH_NONE) {
+            size_t length = 0;
+            size_t at = Search_Next(doc->search.get(), &state->query, text, size, scan->firstHit, &length);
+            SetMatch(state, doc, at, length);
+            jump = true;
+        } else if (scan && scan->done && state->matchOrdinal == 0) {
+            UpdateOrdinal(state, doc);
+        }
+    }
+    if (jump) ShowMatch(hwnd, state);
+    if (loading || (state->matchScan && state->matchScan->size == size)) return;
+    if (state->matchAt == SEARCH_NONE) FindMatch(hwnd, state, true, false);
+    StartScan(hwnd, state, state->matchAt != SEARCH_NONE ? state->matchAt : state->searchFrom);
+}
+
+// Shows the top of state->pendingPage. A page not extracted yet is asked
+// for, and the jump is made from PDF_HandleLoaderUpdate once it is in.
+static void GoToPage(HWND hwnd, PDFState* state) {
+    size_t line;
+    {
+        std::lock_guard<std::mutex> guard(state->doc->lock);
+        Document* doc = state->doc.get();
+        size_t page = (size_t)state->pendingPage;
+        if (page > doc->pageLines.size()) {
+            if (doc->loading && doc->job) {
+                Loader_RequestPages(doc->job, state->pendingPage);
+            } else {
+                state->pendingPage = 0;  // the load ended short of it
+            }
+            PDF_Invalidate(hwnd, false);
+            return;
+        }
+        line = doc->pageLines[page - 1];
+    }
+    state->pendingPage = 0;
+    state->scrollPos = (int)std::min<size_t>(line, 0x7FFFFFFF);
+    state->scrollUnit = 0;
+    RECT clientRect;
+    GetClientRect(hwnd, &clientRect);
+    PDF_UpdateScrollInfo(clientRect, state);
+    ApplyScrollBars(hwnd, state);
+    PDF_Invalidate(hwnd, true);
+}
 
-    // Split into lines
-    state->textLines.clear();
-    std::stringstream ss(state->extractedText);
-    std::string line;
-    while (std::getline(ss, line)) state->textLines.push_back(line);
+bool PDF_HandleLoaderUpdate(HWND hwnd, PDFState* state) {
+    if (!state || !state->doc) return true;
+    if (state->link) state->link->Clear();
 
-    state->maxScrollPos = std::max(0, (int)state->textLines.size() - state->pageSize);
-    state->scrollPos = 0;
+    bool failed;
+    {
+        std::lock_guard<std::mutex> guard(state->doc->lock);
+        failed = state->doc->failed && !state->failureShown;
+    }
+    if (failed) state->failureShown = true;
+    MeasureGrid(hwnd, state);
+    if (state->findOpen && PDF_HasQuery(state)) RefreshSearch(hwnd, state);
+    if (state->pendingPage > 0) GoToPage(hwnd, state);
 
-    return true;
+    RECT clientRect;
+    GetClientRect(hwnd, &clientRect);
+    PDF_UpdateScrollInfo(clientRect, state);
+    ApplyScrollBars(hwnd, state);
+    PDF_Invalidate(hwnd, true);
+    return !failed;
 }
 
-void PDF_DrawContent(HDC hdc, const RECT& clientRect, PDFState* state) {
-    if (!state) return;
-    
-    // Draw status bar
-    RECT statusRect = clientRect;
-    statusRect.bottom = statusRect.top + 30;
-    
-    HBRUSH darkBrush = CreateSolidBrush(RGB(30, 30, 30));
-    if (darkBrush) {
-        FillRect(hdc, &statusRect, darkBrush);
-        DeleteObject(darkBrush);
+bool PDF_IsLoaded(PDFState* state) {
+    if (!state || !state->doc) return false;
+    std::lock_guard<std::mutex> guard(state->doc->lock);
+    size_t size;
+    Doc_Text(state->doc.get(), &size);
+    return !state->doc->loading && (size > 0 || state->doc->table);
+}
+
+// Keys for the page bar: Enter jumps, Escape closes
+static void HandleGotoKey(HWND hwnd, WPARAM key, PDFState* state) {
+    switch (key) {
+        case VK_ESCAPE:
+            state->gotoOpen = false;
+            break;
+        case VK_RETURN: {
+            int pageCount;
+            {
+                std::lock_guard<std::mutex> guard(state->doc->lock);
+                pageCount = state->doc->pageCount;
+            }
+            int page = 0;  // at most 9 digits
+            for (size_t i = 0; i < state->gotoText.size(); i++) page = page * 10 + (state->gotoText[i] - L'0');
+            state->gotoOpen = false;
+            if (page > 0) {
+                state->pendingPage = std::min(page, pageCount);
+                GoToPage(hwnd, state);
+            }
+            break;
+        }
+        case VK_BACK:
+            if (!state->gotoText.empty()) state->gotoText.pop_back();
+            break;
     }
-    
-    SetTextColor(hdc, RGB(200, 200, 200));
-    SetBkMode(hdc, TRANSPARENT);
-    
-    const char* instructions = "VM Running";
-    DrawTextA(hdc, instructions, -1, &statusRect, DT_CENTER | DT_VCENTER | DT_SINGLELINE);
-
-    // Draw PDF content
-    RECT contentRect = clientRect;
-    contentRect.top += 35;
-    contentRect.bottom -= BAR_HEIGHT + 5;
-    contentRect.left += 10;
-    contentRect.right -= 30;
-    
-    SetTextColor(hdc, RGB(240, 240, 240));
-    SetBkMode(hdc, TRANSPARENT);
-    
-    // Ensure lines are split if needed
-    if (state->textLines.empty() && !state->extractedText.empty()) {
-        std::stringstream ss(state->extractedText);
-        std::string line;
-        while (std::getline(ss, line)) {
-            state->textLines.push_back(line);
+    PDF_Invalidate(hwnd, false);
+}
+
+bool PDF_HandleKeyDown(HWND hwnd, WPARAM key, PDFState* state) {
+    if (!state || !state->doc) return false;
+    bool shift = GetKeyState(VK_SHIFT) < 0;
+    bool control = GetKeyState(VK_CONTROL) < 0;
+
+    if (key == 'G' && control) {
+        {
+            std::lock_guard<std::mutex> guard(state->doc->lock);
+            if (state->doc->pageCount == 0) return false;
         }
+        state->gotoOpen = true;
+        state->gotoText.clear();
+        state->findOpen = false;
+        CancelScan(state);
+        PDF_Invalidate(hwnd, true);
+        return true;
     }
-    
-    // Draw visible lines
-    int visibleLines = (contentRect.bottom - contentRect.top) / state->lineHeight;
-    for (int i = 0; i < visibleLines && ((size_t)(state->scrollPos + i) < state->textLines.size()); i++) {
-        int y = contentRect.top + (i * state->lineHeight);
-        const std::string& line = state->textLines[state->scrollPos + i];
-        TextOutA(hdc, contentRect.left, y, line.c_str(), (int)line.length());
+    if (key == 'F' && control) {
+        state->findOpen = true;
+        state->gotoOpen = false;
+        PDF_Invalidate(hwnd, true);
+        return true;
     }
+    if (state->gotoOpen) {
+        HandleGotoKey(hwnd, key, state);
+        return true;
+    }
+    if (key == VK_F3 || (state->findOpen && key == VK_RETURN)) {
+        // F3 also brings a closed bar back with the last query
+        state->findOpen = true;
+        if (PDF_HasQuery(state)) {
+            FindMatch(hwnd, state, !shift, true);
+            if (!state->matchScan) StartScan(hwnd, state, state->matchAt != SEARCH_NONE ? state->matchAt : 0);
+        }
+        PDF_Invalidate(hwnd, true);
+        return true;
+    }
+    if (!state->findOpen) return false;
+
+    switch (key) {
+        case VK_ESCAPE:
+            state->findOpen = false;
+            CancelScan(state);
+            break;
+        case 'R':
+            if (control) {
+                state->findRegex = !state->findRegex;
+                QueryChanged(hwnd, state);
+            }
+            break;
+        case VK_BACK:
+            if (!state->findText.empty()) {
+                wchar_t last = state->findText.back();
+                state->findText.pop_back();
+                if (last >= 0xDC00 && last <= 0xDFFF && !state->findText.empty()) state->findText.pop_back();
+                QueryChanged(hwnd, state);
+            }
+            break;
+    }
+    PDF_Invalidate(hwnd, true);
+    return true;
+}
+
+bool PDF_HandleChar(HWND hwnd, WPARAM ch, PDFState* state) {
+    if (!state || !state->doc) return false;
+    if (state->gotoOpen) {
+        if (ch >= '0' && ch <= '9' && state->gotoText.size() < 9) {
+            state->gotoText.push_back((wchar_t)ch);
+            PDF_Invalidate(hwnd, false);
+        }
+        return true;
+    }
+    if (!state->findOpen) return false;
+    // Control characters belong to keys PDF_HandleKeyDown has dealt with
+    if (ch < 32 || ch == 127) return true;
+    state->findText.push_back((wchar_t)ch);
+    // The second half of a surrogate pair follows in its own WM_CHAR
+    if (ch >= 0xD800 && ch <= 0xDBFF) return true;
+    QueryChanged(hwnd, state);
+    return true;
 }
 
 void PDF_UpdateScrollInfo(const RECT& clientRect, PDFState* state) {
-    if (!state || state->textLines.empty()) return;
+    if (!state || !state->doc) return;
+    
+    RECT contentRect = PDF_ContentRect(clientRect);
+    int visibleLines = (contentRect.bottom - contentRect.top) / state->lineHeight;
+    int lineCount;
+    {
+        std::lock_guard<std::mutex> guard(state->doc->lock);
+        Doc_IndexThrough(state->doc.get(), state->scrollPos + std::max(1, visibleLines));
+        lineCount = (int)std::min<size_t>(Doc_EstimatedLineCount(state->doc.get()), 0x7FFFFFFF);
+    }
+    if (lineCount == 0) return;
     
-    int visibleLines = (clientRect.bottom - clientRect.top - 35 - BAR_HEIGHT - 5) / state->lineHeight;
     state->pageSize = std::max(1, visibleLines);
-    state->maxScrollPos = std::max(0, (int)state->textLines.size() - state->pageSize);
-    state->scrollPos = std::min(state->scrollPos, state->maxScrollPos);
+    // Wrapped lines take a varying number of rows, so any line may be the
+    // top one; ScrollRows keeps the end of the text at the bottom
+    bool wrapped = !state->gridTable && state->wrap.width > 0;
+    state->maxScrollPos = std::max(0, lineCount - (wrapped ? 1 : state->pageSize));
+    if (state->scrollPos > state->maxScrollPos) {
+        state->scrollPos = state->maxScrollPos;
+        state->scrollUnit = 0;
+    }
+
+    int contentWidth = contentRect.right - contentRect.left;
+    int64_t gridWidth = state->gridTable ? GridLayout_Width(&state->grid) : 0;
+    state->maxScrollX = (int)std::min<int64_t>(std::max<int64_t>(0, gridWidth - contentWidth), 0x7FFFFFFF);
+    state->scrollX = std::min(state->scrollX, state->maxScrollX);
 }
 
-void PDF_HandleScroll(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam, PDFState* state) {
-    if (!state) return;
+// A scroll of 'rows' rows as PDFScroll. RefineScrollRange can still pull
+// the view back, which is a jump from where the rows left it.
+static PDFScroll RowsScrolled(PDFState* state, int rows, int pos, size_t unit) {
+    PDFScroll scroll = {0, -rows * state->lineHeight, false};
+    scroll.jumped = state->scrollPos != pos || state->scrollUnit != unit;
+    return scroll;
+}
+
+PDFScroll PDF_HandleScroll(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam, PDFState* state) {
+    PDFScroll scroll = {0, 0, false};
+    if (!state) return scroll;
     
     int scrollRequest = LOWORD(wParam);
-    int newPos = state->scrollPos;
+    int rows;
     
     switch (scrollRequest) {
-        case SB_LINEUP:   newPos--; break;
-        case SB_LINEDOWN: newPos++; break;
-        case SB_PAGEUP:   newPos -= state->pageSize; break;
-        case SB_PAGEDOWN: newPos += state->pageSize; break;
-        case SB_THUMBTRACK: newPos = HIWORD(wParam); break;
+        case SB_LINEUP:   rows = ScrollRows(hwnd, state, -1); break;
+        case SB_LINEDOWN: rows = ScrollRows(hwnd, state, 1); break;
+        case SB_PAGEUP:   rows = ScrollRows(hwnd, state, -state->pageSize); break;
+        case SB_PAGEDOWN: rows = ScrollRows(hwnd, state, state->pageSize); break;
+        case SB_THUMBTRACK: {
+            // HIWORD(wParam) is only 16 bits; long documents need the 32-bit position
+            SCROLLINFO si = {};
+            si.cbSize = sizeof(si);
+            si.fMask = SIF_TRACKPOS;
+            int newPos = GetScrollInfo(hwnd, SB_VERT, &si) ? si.nTrackPos : HIWORD(wParam);
+            newPos = std::max(0, std::min(newPos, state->maxScrollPos));
+            if (newPos != state->scrollPos) {
+                // Lines are rows unless they wrap
+                bool shifts = (state->gridTable || state->wrap.width <= 0) && state->scrollUnit == 0;
+                scroll.dy = (state->scrollPos - newPos) * state->lineHeight;
+                scroll.jumped = !shifts;
+                state->scrollPos = newPos;
+                state->scrollUnit = 0;
+                SetScrollPos(hwnd, SB_VERT, state->scrollPos, TRUE);
+            }
+            // Changing the range mid-drag would move the thumb under the cursor
+            return scroll;
+        }
+        default:
+            // A drag let go near the end settles with the last row at the bottom
+            rows = ScrollRows(hwnd, state, 0);
+            break;
     }
-    
-    newPos = std::max(0, std::min(newPos, state->maxScrollPos));
-    
-    if (newPos != state->scrollPos) {
-        state->scrollPos = newPos;
-        SetScrollPos(hwnd, SB_VERT, state->scrollPos, TRUE);
+    int pos = state->scrollPos;
+    size_t unit = state->scrollUnit;
+    RefineScrollRange(hwnd, state);
+    return RowsScrolled(state, rows, pos, unit);
+}
+
+PDFScroll PDF_HandleHScroll(HWND hwnd, WPARAM wParam, PDFState* state) {
+    PDFScroll scroll = {0, 0, false};
+    if (!state) return scroll;
+
+    RECT clientRect;
+    GetClientRect(hwnd, &clientRect);
+    int page = std::max(HSCROLL_STEP, clientRect.right - clientRect.left - 40);
+    int newPos = state->scrollX;
+    switch (LOWORD(wParam)) {
+        case SB_LINELEFT:  newPos -= HSCROLL_STEP; break;
+        case SB_LINERIGHT: newPos += HSCROLL_STEP; break;
+        case SB_PAGELEFT:  newPos -= page; break;
+        case SB_PAGERIGHT: newPos += page; break;
+        case SB_THUMBTRACK: {
+            SCROLLINFO si = {};
+            si.cbSize = sizeof(si);
+            si.fMask = SIF_TRACKPOS;
+            newPos = GetScrollInfo(hwnd, SB_HORZ, &si) ? si.nTrackPos : HIWORD(wParam);
+            break;
+        }
     }
+
+    newPos = std::max(0, std::min(newPos, state->maxScrollX));
+    scroll.dx = state->scrollX - newPos;
+    state->scrollX = newPos;
+    SetScrollPos(hwnd, SB_HORZ, state->scrollX, TRUE);
+    return scroll;
 }
 
-void PDF_HandleMouseWheel(HWND hwnd, WPARAM wParam, PDFState* state) {
-    if (!state) return;
+PDFScroll PDF_HandleMouseWheel(HWND hwnd, WPARAM wParam, PDFState* state) {
+    PDFScroll scroll = {0, 0, false};
+    if (!state) return scroll;
     
     int delta = GET_WHEEL_DELTA_WPARAM(wParam);
-    int scrollLines = 3;
-    
-    if (delta > 0) {
-        state->scrollPos -= scrollLines;
-    } else {
-        state->scrollPos += scrollLines;
+    if ((GET_KEYSTATE_WPARAM(wParam) & MK_SHIFT) && state->maxScrollX > 0) {
+        int step = delta > 0 ? -3 * HSCROLL_STEP : 3 * HSCROLL_STEP;
+        int newPos = std::max(0, std::min(state->scrollX + step, state->maxScrollX));
+        scroll.dx = state->scrollX - newPos;
+        state->scrollX = newPos;
+        SetScrollPos(hwnd, SB_HORZ, state->scrollX, TRUE);
+        return scroll;
     }
-    
-    state->scrollPos = std::max(0, std::min(state->scrollPos, state->maxScrollPos));
-    SetScrollPos(hwnd, SB_VERT, state->scrollPos, TRUE);
+    int scrollLines = 3;
+    int rows = ScrollRows(hwnd, state, delta > 0 ? -scrollLines : scrollLines);
+    int pos = state->scrollPos;
+    size_t unit = state->scrollUnit;
+    RefineScrollRange(hwnd, state);
+    return RowsScrolled(state, rows, pos, unit);
 }
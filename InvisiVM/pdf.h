@@ -1,30 +1,120 @@
 #ifndef PDF_H
 #define PDF_H
 
-#include <windows.h>
+#include <atomic>
 #include <string>
 #include <vector>
+#include <memory>
+#include "platform.h"
+#include "canvas.h"
 #include "constants.h" // Added: ensure LINE_HEIGHT is defined
+#include "docstore.h"
+#include "gridlayout.h"
+#include "wraplayout.h"
+
+// Posted to the viewer window whenever its document has new text
+#define WM_PDF_LOADER (WM_APP + 1)
+
+class ViewerLink;
+
+// A query counted on the thread pool a block at a time, from the view on
+// and wrapping around, so the first match after the view turns up early.
+// The counts land in the query's SearchCounts, which the viewer's own
+// searches use to skip empty blocks.
+struct MatchScan {
+    std::atomic<bool> cancel;
+    std::atomic<bool> done;
+    std::atomic<size_t> firstHit;  // first match from 'from' on, wrapping
+    std::atomic<size_t> found;
+    SearchQuery query;
+    size_t from;
+    size_t size;                   // text size scanned
+
+    MatchScan() : cancel(false), done(false), firstHit(SEARCH_NONE), found(0), from(0), size(0) {}
+};
 
 // PDF State structure - encapsulates all PDF state for a window
 struct PDFState {
-    std::string extractedText;
-    std::vector<std::string> textLines;
-    int scrollPos;
+    std::shared_ptr<Document> doc;  // shared with other windows showing the same file
+    ViewerLink* link;               // how the document wakes this window
+    int scrollPos;              // top line
+    size_t scrollUnit;          // where in it the view starts, once wrapped
     int maxScrollPos;
     int pageSize;
     int lineHeight;
     std::string filename;
+    bool failureShown;
+    WideLineCache wideLines;  // visible lines as UTF-16 for TextOutW
+    WrapLayout wrap;          // rows of the lines around the view
+    // Tables are drawn as a grid that also scrolls sideways, in pixels
+    int scrollX;
+    int maxScrollX;
+    bool hScrollShown;
+    GridLayout grid;
+    const CsvTable* gridTable;  // the table 'grid' was measured for
+    // Find bar, opened with Ctrl+F and drawn over the status bar
+    bool findOpen;
+    bool findRegex;             // Ctrl+R in the bar
+    bool findError;             // the expression does not compile
+    std::wstring findText;      // as typed
+    SearchQuery query;          // findText in the document's encoding
+    size_t searchFrom;          // where the background scan started
+    size_t matchAt;             // offset in Doc_SearchText; SEARCH_NONE if none
+    size_t matchLength;
+    size_t matchLine;           // line or table row holding it
+    size_t matchOrdinal;        // 1-based; 0 until the scan is done
+    std::shared_ptr<MatchScan> matchScan;
+    // Page bar, opened with Ctrl+G in its place
+    bool gotoOpen;
+    std::wstring gotoText;      // digits as typed
+    int pendingPage;            // 1-based page to show once extracted; 0 if none
+
+    PDFState() : link(NULL), scrollPos(0), scrollUnit(0), maxScrollPos(0), pageSize(10), lineHeight(LINE_HEIGHT),
+                 failureShown(false), scrollX(0), maxScrollX(0), hScrollShown(false), gridTable(NULL),
+                 findOpen(false), findRegex(false), findError(false), searchFrom(0), matchAt(SEARCH_NONE),
+                 matchLength(0), matchLine(0), matchOrdinal(0), gotoOpen(false), pendingPage(0) {}
+};
+
+// How a scroll moved the document in the view, so the pixels already drawn
+// can be moved with it and only what comes into view drawn
+struct PDFScroll {
+    int dx, dy;    // pixels the document moved right and down
+    bool jumped;   // moved some way no shift matches, so the view is drawn again
 };
 
 // PDF functions - now take PDFState pointer
 void PDF_Initialize(PDFState* state);
-// FIX: Added the third argument 'const char* expectedType = nullptr'
-bool PDF_ProcessFile(const char* pdfPath, PDFState* state, const char* expectedType = nullptr);
-void PDF_DrawContent(HDC hdc, const RECT& clientRect, PDFState* state);
+// Starts extracting the file in the background; text appears as it arrives
+void PDF_StartLoad(HWND hwnd, const char* pdfPath, PDFState* state, const char* expectedType = nullptr);
+// Lets go of the document; call before the state goes away
+void PDF_Cleanup(PDFState* state);
+// Handles WM_PDF_LOADER. Returns false once if the load failed.
+bool PDF_HandleLoaderUpdate(HWND hwnd, PDFState* state);
+// Drawing, in pdfdraw.cpp, works on any canvas
+void PDF_DrawContent(Canvas* canvas, const RECT& clientRect, PDFState* state);
+// A query is typed and compiles
+bool PDF_HasQuery(const PDFState* state);
+// Where the status bar and the document go in a window
+RECT PDF_StatusRect(const RECT& clientRect);
+RECT PDF_ContentRect(const RECT& clientRect);
+// The part of the content drawn in whole rows, which moves with a scroll;
+// a partial row below it is drawn again
+RECT PDF_RowsRect(const RECT& clientRect, const PDFState* state);
+// Marks the status bar for repainting, and with 'content' the document
+// under it; the bottom bar is left alone
+void PDF_Invalidate(HWND hwnd, bool content);
 void PDF_UpdateScrollInfo(const RECT& clientRect, PDFState* state);
-void PDF_HandleScroll(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam, PDFState* state);
-void PDF_HandleMouseWheel(HWND hwnd, WPARAM wParam, PDFState* state);
+PDFScroll PDF_HandleScroll(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam, PDFState* state);
+// WM_HSCROLL; only tables are wider than the window
+PDFScroll PDF_HandleHScroll(HWND hwnd, WPARAM wParam, PDFState* state);
+// Scrolls sideways while Shift is held
+PDFScroll PDF_HandleMouseWheel(HWND hwnd, WPARAM wParam, PDFState* state);
 bool PDF_IsLoaded(PDFState* state);
+// Ctrl+F, F3 and the find bar's keys, Ctrl+R among them for a regular
+// expression, and Ctrl+G for the page bar. Returns true if the key was
+// used; while either bar is open every key is.
+bool PDF_HandleKeyDown(HWND hwnd, WPARAM key, PDFState* state);
+// WM_CHAR; typing goes to whichever bar is open
+bool PDF_HandleChar(HWND hwnd, WPARAM ch, PDFState* state);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include "pdf.h"
+#include "constants.h"
+
+// Drawing for the viewer. Nothing here touches Windows, so a document can
+// be drawn on any canvas.
+
+// The viewer's text is in the device's own font
+static const CanvasFont VIEWER_FONT = {L"", 0, FW_NORMAL, false};
+static const COLORREF STATUS_TEXT = RGB(200, 200, 200);
+static const COLORREF MATCH_COLOR = RGB(100, 80, 20);
+static const COLORREF CURRENT_MATCH_COLOR = RGB(200, 120, 20);
+
+bool PDF_HasQuery(const PDFState* state) {
+    return !state->findText.empty() && !state->findError;
+}
+
+RECT PDF_StatusRect(const RECT& clientRect) {
+    RECT statusRect = clientRect;
+    statusRect.bottom = statusRect.top + 30;
+    return statusRect;
+}
+
+RECT PDF_ContentRect(const RECT& clientRect) {
+    RECT contentRect = clientRect;
+    contentRect.top += 35;
+    contentRect.bottom -= BAR_HEIGHT + 5;
+    contentRect.left += 10;
+    contentRect.right -= 30;
+    return contentRect;
+}
+
+RECT PDF_RowsRect(const RECT& clientRect, const PDFState* state) {
+    RECT rowsRect = PDF_ContentRect(clientRect);
+    int rows = (rowsRect.bottom - rowsRect.top) / state->lineHeight;
+    rowsRect.bottom = rowsRect.top + std::max(0, rows) * state->lineHeight;
+    return rowsRect;
+}
+
+// Only the cells in view are fetched and drawn, so the cost of a frame does
+// not depend on how many rows or columns the table has
+static void DrawGrid(Canvas* canvas, const RECT& area, PDFState* state, const Document* doc, bool marks) {
+    const CsvTable* table = &doc->table->table;
+    int rowHeight = state->lineHeight;
+    GridRange range;
+    GridLayout_Visible(&state->grid, table->rows, state->scrollPos, state->scrollX,
+                       area.right - area.left, area.bottom - area.top, rowHeight, &range);
+
+    canvas->SetClip(&area);
+
+    std::string cell;
+    std::wstring wide;
+    for (size_t r = range.firstRow; r < range.endRow; r++) {
+        int y = area.top + (int)(r - range.firstRow) * rowHeight;
+        RECT rowRect = {area.left, y, area.right, y + rowHeight};
+        if (!canvas->Visible(rowRect)) continue;
+        int x = area.left + range.offsetX;
+        for (size_t c = range.firstColumn; c < range.endColumn; c++) {
+            int width = state->grid.widths[c];
+            RECT cellRect = {x + CELL_PADDING, y, x + width - CELL_PADDING, y + rowHeight};
+            cell.clear();
+            CsvTable_CellText(table, r, c, &cell);
+            if (marks && Search_Next(NULL, &state->query, cell.data(), cell.size(), 0, NULL) != SEARCH_NONE) {
+                RECT mark = {x, y, x + width - 1, y + rowHeight - 1};
+                canvas->FillRect(mark, r == state->matchLine ? CURRENT_MATCH_COLOR : MATCH_COLOR);
+            }
+            wide.clear();
+            TextEnc_ToWide(cell.data(), cell.size(), doc->encoding, &wide);
+            canvas->Text(VIEWER_FONT, RGB(240, 240, 240), cellRect.left, y, wide.c_str(), wide.length(), &cellRect);
+            x += width;
+        }
+    }
+
+    // Lines between cells, over the rows and columns drawn
+    COLORREF lineColor = RGB(60, 60, 60);
+    int bottom = area.top + (int)(range.endRow - range.firstRow) * rowHeight;
+    int x = area.left + range.offsetX;
+    for (size_t c = range.firstColumn; c < range.endColumn; c++) {
+        x += state->grid.widths[c];
+        canvas->Line(x - 1, area.top, x - 1, bottom, 1, lineColor);
+    }
+    int right = std::min<int>(x, area.right);
+    for (int y = area.top + rowHeight; y <= bottom; y += rowHeight) {
+        canvas->Line(area.left, y - 1, right, y - 1, 1, lineColor);
+    }
+
+    canvas->SetClip(NULL);
+}
+
+// Marks the matches in rows [firstRow, endRow) of a wrapped line, the
+// first of them drawn at (x, y). Positions come from the line's advances,
+// so a match running onto the next row is marked on both.
+static void DrawLineMatches(Canvas* canvas, int x, int y, const PDFState* state, const Document* doc,
+                            std::string_view line, size_t lineStart, const std::wstring& wide,
+                            const WrapLine* wrapped, size_t firstRow, size_t endRow) {
+    std::wstring prefix;
+    size_t length = 0;
+    for (size_t at = Search_Next(NULL, &state->query, line.data(), line.size(), 0, &length); at != SEARCH_NONE;
+         at = Search_Next(NULL, &state->query, line.data(), line.size(), at + 1, &length)) {
+        prefix.clear();
+        TextEnc_ToWide(line.data(), at, doc->encoding, &prefix);
+        size_t begin = std::min(prefix.size(), wide.size());
+        TextEnc_ToWide(line.data() + at, length, doc->encoding, &prefix);
+        size_t end = std::min(prefix.size(), wide.size());
+        COLORREF color = lineStart + at == state->matchAt ? CURRENT_MATCH_COLOR : MATCH_COLOR;
+        for (size_t r = firstRow; r < endRow; r++) {
+            size_t rowBegin, rowEnd;
+            Wrap_RowRange(wrapped, r, &rowBegin, &rowEnd);
+            size_t left = std::max(begin, rowBegin), right = std::min(end, rowEnd);
+            if (left >= right) continue;
+            int top = y + (int)(r - firstRow) * state->lineHeight;
+            int origin = x - wrapped->x[rowBegin];
+            RECT mark = {origin + wrapped->x[left], top, origin + wrapped->x[right], top + state->lineHeight};
+            canvas->FillRect(mark, color);
+        }
+    }
+}
+
+// Query on the left of the status bar, where the current match stands on
+// the right
+static void DrawFindBar(Canvas* canvas, const RECT& statusRect, const PDFState* state, const Document* doc) {
+    RECT textRect = statusRect;
+    textRect.left += 10;
+    textRect.right -= 10;
+    std::wstring prompt = (state->findRegex ? L"Regex: " : L"Find: ") + state->findText + L"_";
+    canvas->TextInRect(VIEWER_FONT, STATUS_TEXT, textRect, prompt.c_str(), (int)prompt.length(),
+                       DT_LEFT | DT_VCENTER | DT_SINGLELINE);
+
+    char status[64] = "";
+    const MatchScan* scan = state->matchScan.get();
+    bool scanning = doc->loading || (scan && !scan->done);
+    if (state->findText.empty()) {
+        // Nothing to report yet
+    } else if (state->findError) {
+        snprintf(status, sizeof(status), "Invalid expression");
+    } else if (state->matchOrdinal > 0) {
+        snprintf(status, sizeof(status), "%llu of %llu", (unsigned long long)state->matchOrdinal,
+                 (unsigned long long)scan->found);
+    } else if (scanning) {
+        unsigned long long found = scan ? (unsigned long long)scan->found : 0;
+        snprintf(status, sizeof(status), "%llu found, searching...", found);
+    } else if (state->matchAt == SEARCH_NONE) {
+        snprintf(status, sizeof(status), "No matches");
+    }
+    Canvas_TextInRectA(canvas, VIEWER_FONT, STATUS_TEXT, textRect, status, DT_RIGHT | DT_VCENTER | DT_SINGLELINE);
+}
+
+// Page number being typed on the left, the page count on the right
+static void DrawGotoBar(Canvas* canvas, const RECT& statusRect, const PDFState* state, const Document* doc) {
+    RECT textRect = statusRect;
+    textRect.left += 10;
+    textRect.right -= 10;
+    std::wstring prompt = L"Go to page: " + state->gotoText + L"_";
+    canvas->TextInRect(VIEWER_FONT, STATUS_TEXT, textRect, prompt.c_str(), (int)prompt.length(),
+                       DT_LEFT | DT_VCENTER | DT_SINGLELINE);
+
+    char status[32];
+    snprintf(status, sizeof(status), "of %d", doc->pageCount);
+    Canvas_TextInRectA(canvas, VIEWER_FONT, STATUS_TEXT, textRect, status, DT_RIGHT | DT_VCENTER | DT_SINGLELINE);
+}
+
+// Page and load progress, or the find or page bar when open
+static void DrawStatusBar(Canvas* canvas, const RECT& statusRect, const PDFState* state, const Document* doc) {
+    canvas->FillRect(statusRect, RGB(30, 30, 30));
+
+    char instructions[96] = "VM Running";
+    char extracted[48] = "";
+    if (doc->loading) {
+        if (doc->loadTotal > 0) {
+            snprintf(extracted, sizeof(extracted), "%d / %d pages extracted", doc->loadDone, doc->loadTotal);
+        } else {
+            snprintf(instructions, sizeof(instructions), "Loading...");
+        }
+    }
+    if (state->pendingPage > 0) {
+        snprintf(instructions, sizeof(instructions), "Going to page %d%s%s", state->pendingPage,
+                 extracted[0] ? ", " : "", extracted);
+    } else if (doc->pageCount > 0 && !doc->pageLines.empty()) {
+        unsigned long long page = Doc_PageAtLine(doc, state->scrollPos) + 1;
+        snprintf(instructions, sizeof(instructions), "Page %llu of %d%s%s", page, doc->pageCount,
+                 extracted[0] ? ", " : "", extracted);
+    } else if (extracted[0]) {
+        snprintf(instructions, sizeof(instructions), "%s", extracted);
+    }
+    if (state->gotoOpen) {
+        DrawGotoBar(canvas, statusRect, state, doc);
+    } else if (state->findOpen) {
+        DrawFindBar(canvas, statusRect, state, doc);
+    } else {
+        Canvas_TextInRectA(canvas, VIEWER_FONT, STATUS_TEXT, statusRect, instructions,
+                           DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+    }
+
+    // Progress strip along the bottom of the status bar
+    if (doc->loading && doc->loadTotal > 0) {
+        RECT progressRect = statusRect;
+        progressRect.top = progressRect.bottom - 2;
+        progressRect.right = progressRect.left +
+            (int)((long long)(statusRect.right - statusRect.left) * doc->loadDone / doc->loadTotal);
+        canvas->FillRect(progressRect, RGB(40, 201, 64));
+    }
+}
+
+void PDF_DrawContent(Canvas* canvas, const RECT& clientRect, PDFState* state) {
+    if (!state || !state->doc) return;
+    Document* doc = state->doc.get();
+    std::lock_guard<std::mutex> guard(doc->lock);
+
+    // Draw status bar
+    RECT statusRect = PDF_StatusRect(clientRect);
+    if (canvas->Visible(statusRect)) DrawStatusBar(canvas, statusRect, state, doc);
+
+    // Draw PDF content
+    RECT contentRect = PDF_ContentRect(clientRect);
+    if (!canvas->Visible(contentRect)) return;
+
+    COLORREF textColor = RGB(240, 240, 240);
+
+    // Matches are only marked while the find bar is open
+    bool marks = state->findOpen && PDF_HasQuery(state);
+
+    if (doc->table && state->gridTable == &doc->table->table) {
+        DrawGrid(canvas, contentRect, state, doc, marks);
+    } else {
+        // Draw visible rows straight out of the text buffer, wrapped to the
+        // width of the view. Only these lines are laid out, so a resize
+        // reflows one screen whatever the length of the document.
+        GlyphMeasurer* measurer = canvas->Measurer(VIEWER_FONT);
+        Wrap_SetWidth(&state->wrap, contentRect.right - contentRect.left);
+        int visibleRows = (contentRect.bottom - contentRect.top) / state->lineHeight;
+        Doc_IndexThrough(doc, state->scrollPos + visibleRows);
+        size_t lineCount = Doc_LineCount(doc);
+        size_t size;
+        const char* text = Doc_Text(doc, &size);
+        std::string scratch;
+        int y = contentRect.top;
+        int shown = 0;
+        for (size_t lineNumber = state->scrollPos; shown < visibleRows && lineNumber < lineCount; lineNumber++) {
+            std::string_view line = Doc_Line(doc, lineNumber, &scratch);
+            const std::wstring& wide = TextEnc_CachedLine(&state->wideLines, lineNumber, line, doc->encoding);
+            const WrapLine* wrapped = Wrap_Line(&state->wrap, lineNumber, wide, measurer);
+            size_t firstRow = lineNumber == (size_t)state->scrollPos ? Wrap_RowAt(wrapped, state->scrollUnit) : 0;
+            size_t endRow = std::min(Wrap_Rows(wrapped), firstRow + (size_t)(visibleRows - shown));
+            int lineBottom = y + (int)(endRow - firstRow) * state->lineHeight;
+            if (marks && canvas->Visible({contentRect.left, y, contentRect.right, lineBottom})) {
+                DrawLineMatches(canvas, contentRect.left, y, state, doc, line, (size_t)(line.data() - text), wide,
+                                wrapped, firstRow, endRow);
+            }
+            for (size_t r = firstRow; r < endRow; r++, shown++) {
+                RECT rowRect = {contentRect.left, y, contentRect.right, y + state->lineHeight};
+                if (canvas->Visible(rowRect)) {
+                    size_t begin, end;
+                    Wrap_RowRange(wrapped, r, &begin, &end);
+                    canvas->Text(VIEWER_FONT, textColor, contentRect.left, y, wide.c_str() + begin, end - begin, NULL);
+                }
+                y += state->lineHeight;
+            }
+        }
+    }
+}
@@ -0,0 +1,1630 @@
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <string_view>
+#include <map>
+#include <set>
+#include <memory>
+#include <vector>
+#include "pdfparse.h"
+#include "inflate.h"
+#include "mapfile.h"
+
+// ---------------------------------------------------------------------------
+// Object model
+// ---------------------------------------------------------------------------
+
+struct PdfObj;
+typedef std::vector<PdfObj> PdfArray;
+typedef std::map<std::string, PdfObj> PdfDict;
+
+struct PdfObj {
+    enum Type { NONE, BOOL, NUM, NAME, STR, ARRAY, DICT, REF, STREAM };
+
+    Type type;
+    double num;          // BOOL/NUM value, object number for REF
+    int gen;             // generation for REF
+    std::string str;     // NAME or STR bytes
+    std::shared_ptr<PdfArray> arr;
+    std::shared_ptr<PdfDict> dict;  // DICT and STREAM
+    size_t streamPos;    // offset of the stream body in the file
+
+    PdfObj() : type(NONE), num(0), gen(0), streamPos(0) {}
+
+    bool Is(Type t) const { return type == t; }
+    bool IsName(const char* name) const { return type == NAME && str == name; }
+
+    const PdfObj& Get(const char* key) const;
+};
+
+static const PdfObj kNullObj;
+
+const PdfObj& PdfObj::Get(const char* key) const {
+    if (!dict) return kNullObj;
+    PdfDict::const_iterator it = dict->find(key);
+    return it == dict->end() ? kNullObj : it->second;
+}
+
+// ---------------------------------------------------------------------------
+// Lexer
+// ---------------------------------------------------------------------------
+
+enum TokenKind {
+    TOK_EOF, TOK_NUM, TOK_NAME, TOK_STR, TOK_KEYWORD,
+    TOK_ARRAY_OPEN, TOK_ARRAY_CLOSE, TOK_DICT_OPEN, TOK_DICT_CLOSE
+};
+
+struct Token {
+    TokenKind kind;
+    double num;
+    bool isInt;
+    std::string text;
+};
+
+struct Lexer {
+    const char* data;
+    size_t size;
+    size_t pos;
+
+    Lexer(const char* d, size_t n, size_t p = 0) : data(d), size(n), pos(p) {}
+};
+
+static inline bool IsWhite(unsigned char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+}
+
+static inline bool IsDelim(unsigned char c) {
+    return c == '(' || c == ')' || c == '<' || c == '>' || c == '[' || c == ']' ||
+           c == '{' || c == '}' || c == '/' || c == '%';
+}
+
+static inline int HexValue(unsigned char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void SkipWhite(Lexer& lx) {
+    while (lx.pos < lx.size) {
+        unsigned char c = lx.data[lx.pos];
+        if (IsWhite(c)) {
+            lx.pos++;
+        } else if (c == '%') {
+            while (lx.pos < lx.size && lx.data[lx.pos] != '\n' && lx.data[lx.pos] != '\r') lx.pos++;
+        } else {
+            break;
+        }
+    }
+}
+
+static void ReadLiteralString(Lexer& lx, std::string* out) {
+    int depth = 1;
+    while (lx.pos < lx.size) {
+        char c = lx.data[lx.pos++];
+        if (c == '(') {
+            depth++;
+        } else if (c == ')') {
+            if (--depth == 0) return;
+        } else if (c == '\\' && lx.pos < lx.size) {
+            char e = lx.data[lx.pos++];
+            switch (e) {
+                case 'n': out->push_back('\n'); break;
+                case 'r': out->push_back('\r'); break;
+                case 't': out->push_back('\t'); break;
+                case 'b': out->push_back('\b'); break;
+                case 'f': out->push_back('\f'); break;
+                case '\r':
+                    if (lx.pos < lx.size && lx.data[lx.pos] == '\n') lx.pos++;
+                    break;
+                case '\n':
+                    break;
+                default:
+                    if (e >= '0' && e <= '7') {
+                        int v = e - '0';
+                        for (int k = 0; k < 2 && lx.pos < lx.size &&
+                                        lx.data[lx.pos] >= '0' && lx.data[lx.pos] <= '7'; k++) {
+                            v = v * 8 + (lx.data[lx.pos++] - '0');
+                        }
+                        out->push_back((char)v);
+                    } else {
+                        out->push_back(e);
+                    }
+                    break;
+            }
+            continue;
+        }
+        out->push_back(c);
+    }
+}
+
+static void ReadHexString(Lexer& lx, std::string* out) {
+    int hi = -1;
+    while (lx.pos < lx.size) {
+        unsigned char c = lx.data[lx.pos++];
+        if (c == '>') break;
+        int v = HexValue(c);
+        if (v < 0) continue;
+        if (hi < 0) {
+            hi = v;
+        } else {
+            out->push_back((char)(hi * 16 + v));
+            hi = -1;
+        }
+    }
+    if (hi >= 0) out->push_back((char)(hi * 16));
+}
+
+static bool NextToken(Lexer& lx, Token* tok) {
+    SkipWhite(lx);
+    tok->text.clear();
+    tok->isInt = false;
+    if (lx.pos >= lx.size) {
+        tok->kind = TOK_EOF;
+        return false;
+    }
+
+    unsigned char c = lx.data[lx.pos];
+    switch (c) {
+        case '/':
+            lx.pos++;
+            while (lx.pos < lx.size) {
+                unsigned char n = lx.data[lx.pos];
+                if (IsWhite(n) || IsDelim(n)) break;
+                if (n == '#' && lx.pos + 2 < lx.size &&
+                    HexValue(lx.data[lx.pos + 1]) >= 0 && HexValue(lx.data[lx.pos + 2]) >= 0) {
+                    tok->text.push_back((char)(HexValue(lx.data[lx.pos + 1]) * 16 + HexValue(lx.data[lx.pos + 2])));
+                    lx.pos += 3;
+                    continue;
+                }
+                tok->text.push_back((char)n);
+                lx.pos++;
+            }
+            tok->kind = TOK_NAME;
+            return true;
+        case '(':
+            lx.pos++;
+            ReadLiteralString(lx, &tok->text);
+            tok->kind = TOK_STR;
+            return true;
+        case '<':
+            if (lx.pos + 1 < lx.size && lx.data[lx.pos + 1] == '<') {
+                lx.pos += 2;
+                tok->kind = TOK_DICT_OPEN;
+            } else {
+                lx.pos++;
+                ReadHexString(lx, &tok->text);
+                tok->kind = TOK_STR;
+            }
+            return true;
+        case '>':
+            lx.pos += (lx.pos + 1 < lx.size && lx.data[lx.pos + 1] == '>') ? 2 : 1;
+            tok->kind = TOK_DICT_CLOSE;
+            return true;
+        case '[':
+            lx.pos++;
+            tok->kind = TOK_ARRAY_OPEN;
+            return true;
+        case ']':
+            lx.pos++;
+            tok->kind = TOK_ARRAY_CLOSE;
+            return true;
+        case '{':
+        case '}':
+        case ')':
+            lx.pos++;
+            tok->kind = TOK_KEYWORD;
+            tok->text.push_back((char)c);
+            return true;
+        default:
+            break;
+    }
+
+    if ((c >= '0' && c <= '9') || c == '+' || c == '-' || c == '.') {
+        bool neg = false;
+        if (c == '+' || c == '-') {
+            neg = (c == '-');
+            lx.pos++;
+        }
+        double value = 0;
+        bool isInt = true;
+        while (lx.pos < lx.size && lx.data[lx.pos] >= '0' && lx.data[lx.pos] <= '9') {
+            value = value * 10 + (lx.data[lx.pos++] - '0');
+        }
+        if (lx.pos < lx.size && lx.data[lx.pos] == '.') {
+            isInt = false;
+            lx.pos++;
+            double scale = 0.1;
+            while (lx.pos < lx.size && lx.data[lx.pos] >= '0' && lx.data[lx.pos] <= '9') {
+                value += (lx.data[lx.pos++] - '0') * scale;
+                scale *= 0.1;
+            }
+        }
+        // Malformed numbers such as "--5" or "1.2.3" are swallowed like Acrobat does
+        while (lx.pos < lx.size && !IsWhite(lx.data[lx.pos]) && !IsDelim(lx.data[lx.pos])) lx.pos++;
+        tok->kind = TOK_NUM;
+        tok->num = neg ? -value : value;
+        tok->isInt = isInt;
+        return true;
+    }
+
+    while (lx.pos < lx.size && !IsWhite(lx.data[lx.pos]) && !IsDelim(lx.data[lx.pos])) {
+        tok->text.push_back(lx.data[lx.pos++]);
+    }
+    tok->kind = TOK_KEYWORD;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Parser
+// ---------------------------------------------------------------------------
+
+static const int MAX_NESTING = 64;
+
+static bool ParseObject(Lexer& lx, PdfObj* out, bool allowRefs, int depth = 0);
+
+static bool ParseFromToken(Lexer& lx, const Token& tok, PdfObj* out, bool allowRefs, int depth) {
+    if (depth > MAX_NESTING) return false;
+
+    switch (tok.kind) {
+        case TOK_NUM: {
+            out->type = PdfObj::NUM;
+            out->num = tok.num;
+            if (allowRefs && tok.isInt && tok.num >= 0) {
+                size_t save = lx.pos;
+                Token genTok, rTok;
+                if (NextToken(lx, &genTok) && genTok.kind == TOK_NUM && genTok.isInt &&
+                    NextToken(lx, &rTok) && rTok.kind == TOK_KEYWORD && rTok.text == "R") {
+                    out->type = PdfObj::REF;
+                    out->gen = (int)genTok.num;
+                    return true;
+                }
+                lx.pos = save;
+            }
+            return true;
+        }
+        case TOK_NAME:
+            out->type = PdfObj::NAME;
+            out->str = tok.text;
+            return true;
+        case TOK_STR:
+            out->type = PdfObj::STR;
+            out->str = tok.text;
+            return true;
+        case TOK_ARRAY_OPEN: {
+            out->type = PdfObj::ARRAY;
+            out->arr = std::make_shared<PdfArray>();
+            Token t;
+            while (NextToken(lx, &t) && t.kind != TOK_ARRAY_CLOSE) {
+                if (t.kind == TOK_DICT_CLOSE) continue;
+                PdfObj item;
+                if (!ParseFromToken(lx, t, &item, allowRefs, depth + 1)) return false;
+                out->arr->push_back(item);
+            }
+            return true;
+        }
+        case TOK_DICT_OPEN: {
+            out->type = PdfObj::DICT;
+            out->dict = std::make_shared<PdfDict>();
+            Token key;
+            while (NextToken(lx, &key) && key.kind != TOK_DICT_CLOSE) {
+                if (key.kind != TOK_NAME) continue;  // tolerate junk between entries
+                PdfObj value;
+                if (!ParseObject(lx, &value, allowRefs, depth + 1)) return false;
+                (*out->dict)[key.text] = value;
+            }
+            return true;
+        }
+        case TOK_KEYWORD:
+            if (tok.text == "true" || tok.text == "false") {
+                out->type = PdfObj::BOOL;
+                out->num = (tok.text == "true") ? 1 : 0;
+            } else {
+                out->type = PdfObj::NONE;  // null and anything unexpected
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool ParseObject(Lexer& lx, PdfObj* out, bool allowRefs, int depth) {
+    Token tok;
+    if (!NextToken(lx, &tok)) return false;
+    return ParseFromToken(lx, tok, out, allowRefs, depth);
+}
+
+// ---------------------------------------------------------------------------
+// Document
+// ---------------------------------------------------------------------------
+
+struct XrefEntry {
+    int type;       // -1 unset, 0 free, 1 in file, 2 in object stream
+    size_t offset;  // file offset, or object stream number for type 2
+    int index;      // index inside the object stream
+
+    XrefEntry() : type(-1), offset(0), index(0) {}
+};
+
+struct ObjectStream {
+    std::string data;
+    std::map<int, size_t> offsets;  // object number -> offset into data
+};
+
+// code -> UTF-8, from a ToUnicode CMap
+typedef std::map<unsigned, std::string> CMapTable;
+
+struct FontInfo {
+    bool twoByte;
+    const CMapTable* toUnicode;           // shared cache entry or ownCMap
+    std::unique_ptr<CMapTable> ownCMap;   // when the shared cache is full
+    unsigned short encoding[256];
+    double widths[256];
+    std::map<unsigned, double> cidWidths;
+    double defaultWidth;
+
+    FontInfo() : twoByte(false), toUnicode(NULL), defaultWidth(500) {}
+};
+
+struct PDFDoc {
+    std::shared_ptr<MappedFile> fileData;  // shared with clones
+    std::string_view file;
+    std::vector<XrefEntry> xref;
+    PdfObj trailer;
+    std::map<int, PdfObj> objects;
+    std::map<int, ObjectStream> objectStreams;
+    std::map<int, FontInfo> fonts;
+    std::vector<PdfObj> pages;
+    std::vector<PdfObj> pageResources;
+    int resolveDepth;
+
+    explicit PDFDoc(const std::shared_ptr<MappedFile>& data)
+        : fileData(data), file(data->data, data->size), resolveDepth(0) {}
+};
+
+static PdfObj LoadObject(PDFDoc* doc, int num);
+
+// Decoded objects, object streams and fonts kept per handle. Past this the
+// caches are dropped between pages and rebuilt by whatever page needs them.
+static const size_t CACHE_BUDGET = 32 << 20;
+
+// Rough heap held by the caches; object sizes are an average guess
+static size_t CacheBytes(const PDFDoc* doc) {
+    size_t bytes = doc->objects.size() * 160;
+    for (std::map<int, ObjectStream>::const_iterator it = doc->objectStreams.begin(); it != doc->objectStreams.end(); ++it) {
+        bytes += it->second.data.capacity() + it->second.offsets.size() * 48;
+    }
+    for (std::map<int, FontInfo>::const_iterator it = doc->fonts.begin(); it != doc->fonts.end(); ++it) {
+        bytes += sizeof(FontInfo) + it->second.cidWidths.size() * 48;
+        if (it->second.ownCMap) bytes += it->second.ownCMap->size() * 64;
+    }
+    return bytes;
+}
+
+// Only between pages, while no FontInfo pointer is held
+static void TrimCaches(PDFDoc* doc) {
+    if (CacheBytes(doc) <= CACHE_BUDGET) return;
+    doc->objects.clear();
+    doc->objectStreams.clear();
+    doc->fonts.clear();
+}
+
+static PdfObj Resolve(PDFDoc* doc, const PdfObj& obj) {
+    if (obj.type != PdfObj::REF) return obj;
+    if (doc->resolveDepth > MAX_NESTING) return PdfObj();
+    doc->resolveDepth++;
+    PdfObj result = LoadObject(doc, (int)obj.num);
+    doc->resolveDepth--;
+    return result;
+}
+
+static double NumberOf(PDFDoc* doc, const PdfObj& obj, double def) {
+    PdfObj r = Resolve(doc, obj);
+    return r.type == PdfObj::NUM ? r.num : def;
+}
+
+static void SetXref(PDFDoc* doc, int num, const XrefEntry& entry) {
+    if (num < 0 || num > 10000000) return;
+    if ((size_t)num >= doc->xref.size()) doc->xref.resize(num + 1);
+    XrefEntry& cur = doc->xref[num];
+    // Newer sections are read first; a free entry must not hide a later real one
+    if (cur.type == -1 || (cur.type == 0 && entry.type != 0)) cur = entry;
+}
+
+static bool FindStreamBody(std::string_view file, size_t* pos) {
+    size_t p = *pos;
+    Lexer lx(file.data(), file.size(), p);
+    SkipWhite(lx);
+    if (file.compare(lx.pos, 6, "stream") != 0) return false;
+    p = lx.pos + 6;
+    if (p < file.size() && file[p] == '\r') p++;
+    if (p < file.size() && file[p] == '\n') p++;
+    *pos = p;
+    return true;
+}
+
+// Parses "num gen obj <object> [stream]" at a file offset
+static bool ParseIndirectAt(PDFDoc* doc, size_t offset, int* numOut, PdfObj* out) {
+    if (offset >= doc->file.size()) return false;
+    Lexer lx(doc->file.data(), doc->file.size(), offset);
+    Token numTok, genTok, objTok;
+    if (!NextToken(lx, &numTok) || numTok.kind != TOK_NUM) return false;
+    if (!NextToken(lx, &genTok) || genTok.kind != TOK_NUM) return false;
+    if (!NextToken(lx, &objTok) || objTok.kind != TOK_KEYWORD || objTok.text != "obj") return false;
+    if (!ParseObject(lx, out, true)) return false;
+    if (numOut) *numOut = (int)numTok.num;
+
+    if (out->type == PdfObj::DICT) {
+        size_t body = lx.pos;
+        if (FindStreamBody(doc->file, &body)) {
+            out->type = PdfObj::STREAM;
+            out->streamPos = body;
+        }
+    }
+    return true;
+}
+
+static bool GetStreamBytes(PDFDoc* doc, const PdfObj& stream, const char** data, size_t* size) {
+    if (stream.type != PdfObj::STREAM) return false;
+    std::string_view file = doc->file;
+    size_t start = stream.streamPos;
+    if (start > file.size()) return false;
+
+    double len = NumberOf(doc, stream.Get("Length"), -1);
+    if (len >= 0 && start + (size_t)len <= file.size()) {
+        // Trust /Length only when endstream actually follows it
+        Lexer lx(file.data(), file.size(), start + (size_t)len);
+        SkipWhite(lx);
+        if (file.compare(lx.pos, 9, "endstream") == 0) {
+            *data = file.data() + start;
+            *size = (size_t)len;
+            return true;
+        }
+    }
+
+    size_t end = file.find("endstream", start);
+    if (end == std::string::npos) return false;
+    if (end > start && file[end - 1] == '\n') end--;
+    if (end > start && file[end - 1] == '\r') end--;
+    *data = file.data() + start;
+    *size = end - start;
+    return true;
+}
+
+static bool ApplyPredictor(const PdfObj& parms, std::string* data) {
+    if (parms.type != PdfObj::DICT) return true;
+    int predictor = (int)(parms.Get("Predictor").type == PdfObj::NUM ? parms.Get("Predictor").num : 1);
+    if (predictor < 10) return true;  // TIFF predictor is never used for text streams
+
+    int colors = parms.Get("Colors").type == PdfObj::NUM ? (int)parms.Get("Colors").num : 1;
+    int bpc = parms.Get("BitsPerComponent").type == PdfObj::NUM ? (int)parms.Get("BitsPerComponent").num : 8;
+    int columns = parms.Get("Columns").type == PdfObj::NUM ? (int)parms.Get("Columns").num : 1;
+    if (colors < 1 || bpc < 1 || columns < 1) return false;
+
+    size_t bpp = std::max<size_t>(1, (size_t)(colors * bpc) / 8);
+    size_t rowLen = ((size_t)columns * colors * bpc + 7) / 8;
+    std::string result;
+    result.reserve(data->size());
+    std::vector<unsigned char> prev(rowLen, 0), row(rowLen);
+
+    for (size_t pos = 0; pos + 1 + rowLen <= data->size(); pos += rowLen + 1) {
+        unsigned char filter = (unsigned char)(*data)[pos];
+        const unsigned char* src = (const unsigned char*)data->data() + pos + 1;
+        for (size_t i = 0; i < rowLen; i++) {
+            unsigned left = i >= bpp ? row[i - bpp] : 0;
+            unsigned up = prev[i];
+            unsigned upLeft = i >= bpp ? prev[i - bpp] : 0;
+            unsigned v = src[i];
+            switch (filter) {
+                case 1: v += left; break;
+                case 2: v += up; break;
+                case 3: v += (left + up) / 2; break;
+                case 4: {
+                    int p = (int)left + (int)up - (int)upLeft;
+                    int pa = std::abs(p - (int)left), pb = std::abs(p - (int)up), pc = std::abs(p - (int)upLeft);
+                    v += (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft);
+                    break;
+                }
+                default: break;
+            }
+            row[i] = (unsigned char)v;
+        }
+        result.append((const char*)row.data(), rowLen);
+        prev.swap(row);
+    }
+    data->swap(result);
+    return true;
+}
+
+static bool DecodeASCIIHex(const std::string& in, std::string* out) {
+    Lexer lx(in.data(), in.size());
+    ReadHexString(lx, out);
+    return true;
+}
+
+static bool DecodeASCII85(const std::string& in, std::string* out) {
+    unsigned long tuple = 0;
+    int count = 0;
+    for (size_t i = 0; i < in.size(); i++) {
+        unsigned char c = (unsigned char)in[i];
+        if (c == '~') break;
+        if (IsWhite(c)) continue;
+        if (c == 'z' && count == 0) {
+            out->append(4, '\0');
+            continue;
+        }
+        if (c < '!' || c > 'u') return false;
+        tuple = tuple * 85 + (c - '!');
+        if (++count == 5) {
+            for (int k = 3; k >= 0; k--) out->push_back((char)((tuple >> (k * 8)) & 0xFF));
+            tuple = 0;
+            count = 0;
+        }
+    }
+    if (count > 1) {
+        for (int k = count; k < 5; k++) tuple = tuple * 85 + 84;
+        for (int k = 0; k < count - 1; k++) out->push_back((char)((tuple >> ((3 - k) * 8)) & 0xFF));
+    }
+    return true;
+}
+
+static bool DecodeLZW(const std::string& in, std::string* out, int earlyChange) {
+    std::vector<std::string> table;
+    auto reset = [&table]() {
+        table.clear();
+        for (int i = 0; i < 256; i++) table.push_back(std::string(1, (char)i));
+        table.push_back(std::string());  // 256 clear
+        table.push_back(std::string());  // 257 end of data
+    };
+    reset();
+
+    unsigned long bits = 0;
+    int nbits = 0, codeLen = 9;
+    std::string prev;
+    for (size_t i = 0; i < in.size(); i++) {
+        bits = (bits << 8) | (unsigned char)in[i];
+        nbits += 8;
+        while (nbits >= codeLen) {
+            int code = (int)((bits >> (nbits - codeLen)) & ((1u << codeLen) - 1));
+            nbits -= codeLen;
+            if (code == 256) {
+                reset();
+                codeLen = 9;
+                prev.clear();
+                continue;
+            }
+            if (code == 257) return true;
+
+            std::string entry;
+            if (code < (int)table.size()) {
+                entry = table[code];
+            } else if (code == (int)table.size() && !prev.empty()) {
+                entry = prev + prev[0];
+            } else {
+                return false;
+            }
+            out->append(entry);
+            if (!prev.empty() && table.size() < 4096) table.push_back(prev + entry[0]);
+            prev = entry;
+
+            size_t next = table.size() + earlyChange;
+            codeLen = next >= 2048 ? 12 : next >= 1024 ? 11 : next >= 512 ? 10 : 9;
+        }
+    }
+    return true;
+}
+
+static bool DecodeStream(PDFDoc* doc, const PdfObj& stream, std::string* out) {
+    const char* raw;
+    size_t rawSize;
+    if (!GetStreamBytes(doc, stream, &raw, &rawSize)) return false;
+
+    std::vector<PdfObj> filters, parms;
+    PdfObj f = Resolve(doc, stream.Get("Filter"));
+    PdfObj p = Resolve(doc, stream.Get("DecodeParms"));
+    if (f.type == PdfObj::ARRAY) {
+        for (size_t i = 0; i < f.arr->size(); i++) filters.push_back(Resolve(doc, (*f.arr)[i]));
+    } else if (f.type == PdfObj::NAME) {
+        filters.push_back(f);
+    }
+    if (p.type == PdfObj::ARRAY) {
+        for (size_t i = 0; i < p.arr->size(); i++) parms.push_back(Resolve(doc, (*p.arr)[i]));
+    } else {
+        parms.push_back(p);
+    }
+
+    std::string data(raw, rawSize);
+    for (size_t i = 0; i < filters.size(); i++) {
+        const PdfObj& parm = i < parms.size() ? parms[i] : kNullObj;
+        std::string decoded;
+        const std::string& name = filters[i].str;
+        if (name == "FlateDecode" || name == "Fl") {
+            // Keep what was recovered from slightly damaged streams
+            if (!Inflate_Zlib((const unsigned char*)data.data(), data.size(), &decoded) && decoded.empty()) {
+                return false;
+            }
+            if (!ApplyPredictor(parm, &decoded)) return false;
+        } else if (name == "ASCIIHexDecode" || name == "AHx") {
+            DecodeASCIIHex(data, &decoded);
+        } else if (name == "ASCII85Decode" || name == "A85") {
+            if (!DecodeASCII85(data, &decoded)) return false;
+        } else if (name == "LZWDecode" || name == "LZW") {
+            int early = parm.Get("EarlyChange").type == PdfObj::NUM ? (int)parm.Get("EarlyChange").num : 1;
+            if (!DecodeLZW(data, &decoded, early)) return false;
+            if (!ApplyPredictor(parm, &decoded)) return false;
+        } else {
+            return false;  // image codecs carry no text
+        }
+        data.swap(decoded);
+    }
+    out->swap(data);
+    return true;
+}
+
+static ObjectStream* LoadObjectStream(PDFDoc* doc, int num) {
+    std::map<int, ObjectStream>::iterator it = doc->objectStreams.find(num);
+    if (it != doc->objectStreams.end()) return &it->second;
+
+    ObjectStream& os = doc->objectStreams[num];
+    PdfObj stream = LoadObject(doc, num);
+    if (stream.type != PdfObj::STREAM || !DecodeStream(doc, stream, &os.data)) return &os;
+
+    int n = (int)NumberOf(doc, stream.Get("N"), 0);
+    size_t first = (size_t)NumberOf(doc, stream.Get("First"), 0);
+    Lexer lx(os.data.data(), os.data.size());
+    for (int i = 0; i < n; i++) {
+        Token objNum, objOff;
+        if (!NextToken(lx, &objNum) || !NextToken(lx, &objOff)) break;
+        if (objNum.kind != TOK_NUM || objOff.kind != TOK_NUM) break;
+        os.offsets[(int)objNum.num] = first + (size_t)objOff.num;
+    }
+    return &os;
+}
+
+static PdfObj LoadObject(PDFDoc* doc, int num) {
+    std::map<int, PdfObj>::iterator it = doc->objects.find(num);
+    if (it != doc->objects.end()) return it->second;
+
+    // Placeholder guards against reference cycles while parsing
+    doc->objects[num] = PdfObj();
+    if (num < 0 || (size_t)num >= doc->xref.size()) return PdfObj();
+
+    PdfObj result;
+    const XrefEntry entry = doc->xref[num];
+    if (entry.type == 1) {
+        int parsedNum = -1;
+        if (!ParseIndirectAt(doc, entry.offset, &parsedNum, &result) || parsedNum != num) {
+            result = PdfObj();
+        }
+    } else if (entry.type == 2) {
+        ObjectStream* os = LoadObjectStream(doc, (int)entry.offset);
+        std::map<int, size_t>::iterator off = os->offsets.find(num);
+        if (off != os->offsets.end() && off->second < os->data.size()) {
+            Lexer lx(os->data.data(), os->data.size(), off->second);
+            if (!ParseObject(lx, &result, true)) result = PdfObj();
+        }
+    }
+
+    doc->objects[num] = result;
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Cross-reference tables
+// ---------------------------------------------------------------------------
+
+static bool ReadXrefStream(PDFDoc* doc, size_t offset, PdfObj* dictOut) {
+    PdfObj stream;
+    if (!ParseIndirectAt(doc, offset, NULL, &stream) || stream.type != PdfObj::STREAM) return false;
+    if (!stream.Get("Type").IsName("XRef")) return false;
+
+    std::string data;
+    if (!DecodeStream(doc, stream, &data)) return false;
+
+    const PdfObj& w = stream.Get("W");
+    if (w.type != PdfObj::ARRAY || w.arr->size() < 3) return false;
+    int widths[3];
+    for (int i = 0; i < 3; i++) {
+        widths[i] = (int)(*w.arr)[i].num;
+        if (widths[i] < 0 || widths[i] > 8) return false;
+    }
+    size_t rowLen = (size_t)(widths[0] + widths[1] + widths[2]);
+    if (rowLen == 0) return false;
+
+    std::vector<int> index;
+    const PdfObj& idx = stream.Get("Index");
+    if (idx.type == PdfObj::ARRAY) {
+        for (size_t i = 0; i < idx.arr->size(); i++) index.push_back((int)(*idx.arr)[i].num);
+    } else {
+        index.push_back(0);
+        index.push_back((int)stream.Get("Size").num);
+    }
+
+    size_t pos = 0;
+    for (size_t s = 0; s + 1 < index.size(); s += 2) {
+        for (int k = 0; k < index[s + 1] && pos + rowLen <= data.size(); k++, pos += rowLen) {
+            unsigned long long fields[3] = {0, 0, 0};
+            size_t p = pos;
+            for (int f = 0; f < 3; f++) {
+                for (int b = 0; b < widths[f]; b++) fields[f] = (fields[f] << 8) | (unsigned char)data[p++];
+            }
+            if (widths[0] == 0) fields[0] = 1;
+
+            XrefEntry entry;
+            entry.type = (int)fields[0];
+            if (entry.type > 2) continue;
+            entry.offset = (size_t)fields[1];
+            entry.index = (int)fields[2];
+            SetXref(doc, index[s] + k, entry);
+        }
+    }
+
+    *dictOut = stream;
+    dictOut->type = PdfObj::DICT;
+    return true;
+}
+
+static bool ReadXrefSection(PDFDoc* doc, size_t offset, std::set<size_t>* visited) {
+    if (offset >= doc->file.size() || visited->count(offset) || visited->size() > 256) return false;
+    visited->insert(offset);
+
+    Lexer lx(doc->file.data(), doc->file.size(), offset);
+    Token tok;
+    if (!NextToken(lx, &tok)) return false;
+
+    PdfObj trailer;
+    if (tok.kind == TOK_KEYWORD && tok.text == "xref") {
+        for (;;) {
+            Token start, count;
+            if (!NextToken(lx, &start)) return false;
+            if (start.kind == TOK_KEYWORD && start.text == "trailer") break;
+            if (!NextToken(lx, &count) || start.kind != TOK_NUM || count.kind != TOK_NUM) return false;
+
+            for (int i = 0; i < (int)count.num; i++) {
+                Token off, gen, use;
+                if (!NextToken(lx, &off) || !NextToken(lx, &gen) || !NextToken(lx, &use)) return false;
+                XrefEntry entry;
+                entry.type = (use.text == "n") ? 1 : 0;
+                entry.offset = (size_t)off.num;
+                if (entry.type == 1 && entry.offset == 0) entry.type = 0;
+                SetXref(doc, (int)start.num + i, entry);
+            }
+        }
+        if (!ParseObject(lx, &trailer, true) || trailer.type != PdfObj::DICT) return false;
+
+        // Hybrid-reference files keep compressed objects in a side xref stream
+        const PdfObj& xrefStm = trailer.Get("XRefStm");
+        if (xrefStm.type == PdfObj::NUM) {
+            PdfObj ignored;
+            ReadXrefStream(doc, (size_t)xrefStm.num, &ignored);
+        }
+    } else {
+        if (!ReadXrefStream(doc, offset, &trailer)) return false;
+    }
+
+    if (doc->trailer.type == PdfObj::NONE) doc->trailer = trailer;
+
+    const PdfObj& prev = trailer.Get("Prev");
+    if (prev.type == PdfObj::NUM) ReadXrefSection(doc, (size_t)prev.num, visited);
+    return true;
+}
+
+static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Rebuilds the xref by scanning for "n g obj" headers when the table is damaged
+static void ReconstructXref(PDFDoc* doc) {
+    std::string_view file = doc->file;
+    doc->xref.clear();
+    doc->objects.clear();
+    doc->objectStreams.clear();
+
+    size_t pos = 0;
+    while ((pos = file.find("obj", pos)) != std::string::npos) {
+        size_t end = pos + 3;
+        size_t p = pos;
+        pos = end;
+        if (end < file.size() && !IsWhite(file[end]) && !IsDelim(file[end])) continue;
+
+        // Walk backwards over "<num> <gen> "
+        while (p > 0 && IsWhite(file[p - 1])) p--;
+        size_t genEnd = p;
+        while (p > 0 && IsDigit(file[p - 1])) p--;
+        if (p == genEnd) continue;
+        while (p > 0 && IsWhite(file[p - 1])) p--;
+        size_t numEnd = p;
+        while (p > 0 && IsDigit(file[p - 1])) p--;
+        if (p == numEnd) continue;
+
+        int num = atoi(file.data() + p);  // digits stop before "obj"
+        if (num <= 0 || num > 10000000) continue;
+        if ((size_t)num >= doc->xref.size()) doc->xref.resize(num + 1);
+        doc->xref[num].type = 1;  // later definitions win, as with incremental updates
+        doc->xref[num].offset = p;
+    }
+
+    size_t trailerPos = file.rfind("trailer");
+    if (trailerPos != std::string::npos) {
+        Lexer lx(file.data(), file.size(), trailerPos + 7);
+        PdfObj trailer;
+        if (ParseObject(lx, &trailer, true) && trailer.type == PdfObj::DICT) doc->trailer = trailer;
+    }
+    if (doc->trailer.Get("Root").type == PdfObj::REF) return;
+
+    // Xref-stream files: any XRef stream dict carries the Root
+    for (size_t num = 0; num < doc->xref.size(); num++) {
+        if (doc->xref[num].type != 1) continue;
+        PdfObj obj = LoadObject(doc, (int)num);
+        if (obj.type == PdfObj::STREAM && obj.Get("Type").IsName("XRef") &&
+            obj.Get("Root").type == PdfObj::REF) {
+            doc->trailer = obj;
+            doc->trailer.type = PdfObj::DICT;
+            return;
+        }
+    }
+}
+
+static bool LoadXref(PDFDoc* doc) {
+    std::string_view file = doc->file;
+    size_t searchFrom = file.size() > 2048 ? file.size() - 2048 : 0;
+    size_t sx = file.rfind("startxref");
+    if (sx != std::string::npos && sx >= searchFrom) {
+        Lexer lx(file.data(), file.size(), sx + 9);
+        Token off;
+        std::set<size_t> visited;
+        if (NextToken(lx, &off) && off.kind == TOK_NUM && ReadXrefSection(doc, (size_t)off.num, &visited) &&
+            doc->trailer.Get("Root").type == PdfObj::REF) {
+            return true;
+        }
+    }
+
+    doc->trailer = PdfObj();
+    ReconstructXref(doc);
+    return doc->trailer.Get("Root").type == PdfObj::REF;
+}
+
+// ---------------------------------------------------------------------------
+// Page tree
+// ---------------------------------------------------------------------------
+
+static void CollectPages(PDFDoc* doc, const PdfObj& nodeRef, const PdfObj& inherited,
+                         std::set<int>* visited, int depth) {
+    if (depth > MAX_NESTING) return;
+    if (nodeRef.type == PdfObj::REF) {
+        if (visited->count((int)nodeRef.num)) return;
+        visited->insert((int)nodeRef.num);
+    }
+
+    PdfObj node = Resolve(doc, nodeRef);
+    if (node.type != PdfObj::DICT) return;
+
+    PdfObj resources = node.Get("Resources");
+    if (resources.type == PdfObj::NONE) resources = inherited;
+
+    const PdfObj kids = Resolve(doc, node.Get("Kids"));
+    if (kids.type == PdfObj::ARRAY && !node.Get("Type").IsName("Page")) {
+        for (size_t i = 0; i < kids.arr->size(); i++) {
+            CollectPages(doc, (*kids.arr)[i], resources, visited, depth + 1);
+        }
+        return;
+    }
+
+    doc->pages.push_back(node);
+    doc->pageResources.push_back(Resolve(doc, resources));
+}
+
+// ---------------------------------------------------------------------------
+// Fonts and encodings
+// ---------------------------------------------------------------------------
+
+static const unsigned short kWinAnsiHigh[32] = {
+    0x20AC, 0, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0, 0x017D, 0,
+    0, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0, 0x017E, 0x0178};
+
+static const unsigned short kMacRomanHigh[128] = {
+    0x00C4, 0x00C5, 0x00C7, 0x00C9, 0x00D1, 0x00D6, 0x00DC, 0x00E1,
+    0x00E0, 0x00E2, 0x00E4, 0x00E3, 0x00E5, 0x00E7, 0x00E9, 0x00E8,
+    0x00EA, 0x00EB, 0x00ED, 0x00EC, 0x00EE, 0x00EF, 0x00F1, 0x00F3,
+    0x00F2, 0x00F4, 0x00F6, 0x00F5, 0x00FA, 0x00F9, 0x00FB, 0x00FC,
+    0x2020, 0x00B0, 0x00A2, 0x00A3, 0x00A7, 0x2022, 0x00B6, 0x00DF,
+    0x00AE, 0x00A9, 0x2122, 0x00B4, 0x00A8, 0x2260, 0x00C6, 0x00D8,
+    0x221E, 0x00B1, 0x2264, 0x2265, 0x00A5, 0x00B5, 0x2202, 0x2211,
+    0x220F, 0x03C0, 0x222B, 0x00AA, 0x00BA, 0x03A9, 0x00E6, 0x00F8,
+    0x00BF, 0x00A1, 0x00AC, 0x221A, 0x0192, 0x2248, 0x2206, 0x00AB,
+    0x00BB, 0x2026, 0x00A0, 0x00C0, 0x00C3, 0x00D5, 0x0152, 0x0153,
+    0x2013, 0x2014, 0x201C, 0x201D, 0x2018, 0x2019, 0x00F7, 0x25CA,
+    0x00FF, 0x0178, 0x2044, 0x20AC, 0x2039, 0x203A, 0xFB01, 0xFB02,
+    0x2021, 0x00B7, 0x201A, 0x201E, 0x2030, 0x00C2, 0x00CA, 0x00C1,
+    0x00CB, 0x00C8, 0x00CD, 0x00CE, 0x00CF, 0x00CC, 0x00D3, 0x00D4,
+    0xF8FF, 0x00D2, 0x00DA, 0x00DB, 0x00D9, 0x0131, 0x02C6, 0x02DC,
+    0x00AF, 0x02D8, 0x02D9, 0x02DA, 0x00B8, 0x02DD, 0x02DB, 0x02C7};
+
+struct GlyphName {
+    const char* name;
+    unsigned short code;
+};
+
+// Glyph names that commonly appear in /Differences arrays
+static const GlyphName kGlyphNames[] = {
+    {"space", 0x20}, {"exclam", 0x21}, {"quotedbl", 0x22}, {"numbersign", 0x23},
+    {"dollar", 0x24}, {"percent", 0x25}, {"ampersand", 0x26}, {"quotesingle", 0x27},
+    {"parenleft", 0x28}, {"parenright", 0x29}, {"asterisk", 0x2A}, {"plus", 0x2B},
+    {"comma", 0x2C}, {"hyphen", 0x2D}, {"period", 0x2E}, {"slash", 0x2F},
+    {"zero", 0x30}, {"one", 0x31}, {"two", 0x32}, {"three", 0x33}, {"four", 0x34},
+    {"five", 0x35}, {"six", 0x36}, {"seven", 0x37}, {"eight", 0x38}, {"nine", 0x39},
+    {"colon", 0x3A}, {"semicolon", 0x3B}, {"less", 0x3C}, {"equal", 0x3D},
+    {"greater", 0x3E}, {"question", 0x3F}, {"at", 0x40}, {"bracketleft", 0x5B},
+    {"backslash", 0x5C}, {"bracketright", 0x5D}, {"asciicircum", 0x5E},
+    {"underscore", 0x5F}, {"grave", 0x60}, {"braceleft", 0x7B}, {"bar", 0x7C},
+    {"braceright", 0x7D}, {"asciitilde", 0x7E}, {"bullet", 0x2022},
+    {"endash", 0x2013}, {"emdash", 0x2014}, {"quoteleft", 0x2018},
+    {"quoteright", 0x2019}, {"quotedblleft", 0x201C}, {"quotedblright", 0x201D},
+    {"quotesinglbase", 0x201A}, {"quotedblbase", 0x201E}, {"ellipsis", 0x2026},
+    {"dagger", 0x2020}, {"daggerdbl", 0x2021}, {"trademark", 0x2122},
+    {"copyright", 0x00A9}, {"registered", 0x00AE}, {"degree", 0x00B0},
+    {"fi", 0xFB01}, {"fl", 0xFB02}, {"minus", 0x2212}, {"nbspace", 0x00A0},
+    {"section", 0x00A7}, {"paragraph", 0x00B6}, {"periodcentered", 0x00B7},
+    {"Euro", 0x20AC}, {"sterling", 0x00A3}, {"yen", 0x00A5}, {"cent", 0x00A2},
+    {"eacute", 0x00E9}, {"egrave", 0x00E8}, {"agrave", 0x00E0}, {"ccedilla", 0x00E7},
+    {"udieresis", 0x00FC}, {"odieresis", 0x00F6}, {"adieresis", 0x00E4},
+    {"germandbls", 0x00DF}, {"multiply", 0x00D7}, {"divide", 0x00F7}};
+
+static unsigned GlyphNameToUnicode(const std::string& name) {
+    if (name.size() == 1) return (unsigned char)name[0];
+    for (size_t i = 0; i < sizeof(kGlyphNames) / sizeof(kGlyphNames[0]); i++) {
+        if (name == kGlyphNames[i].name) return kGlyphNames[i].code;
+    }
+    if (name.size() == 7 && name.compare(0, 3, "uni") == 0) return (unsigned)strtoul(name.c_str() + 3, NULL, 16);
+    if (name.size() >= 5 && name.size() <= 7 && name[0] == 'u') return (unsigned)strtoul(name.c_str() + 1, NULL, 16);
+    return 0;
+}
+
+static void AppendUTF8(std::string* out, unsigned cp) {
+    if (cp < 0x80) {
+        out->push_back((char)cp);
+    } else if (cp < 0x800) {
+        out->push_back((char)(0xC0 | (cp >> 6)));
+        out->push_back((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out->push_back((char)(0xE0 | (cp >> 12)));
+        out->push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out->push_back((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x110000) {
+        out->push_back((char)(0xF0 | (cp >> 18)));
+        out->push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+        out->push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out->push_back((char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+static std::string UTF16BEToUTF8(const std::string& bytes) {
+    std::string out;
+    for (size_t i = 0; i + 1 < bytes.size(); i += 2) {
+        unsigned u = ((unsigned char)bytes[i] << 8) | (unsigned char)bytes[i + 1];
+        if (u >= 0xD800 && u < 0xDC00 && i + 3 < bytes.size()) {
+            unsigned lo = ((unsigned char)bytes[i + 2] << 8) | (unsigned char)bytes[i + 3];
+            if (lo >= 0xDC00 && lo < 0xE000) {
+                u = 0x10000 + ((u - 0xD800) << 10) + (lo - 0xDC00);
+                i += 2;
+            }
+        }
+        AppendUTF8(&out, u);
+    }
+    if (bytes.size() == 1) AppendUTF8(&out, (unsigned char)bytes[0]);
+    return out;
+}
+
+static unsigned BytesToCode(const std::string& s) {
+    unsigned v = 0;
+    for (size_t i = 0; i < s.size() && i < 4; i++) v = (v << 8) | (unsigned char)s[i];
+    return v;
+}
+
+static void ParseToUnicode(const std::string& cmap, CMapTable* table) {
+    Lexer lx(cmap.data(), cmap.size());
+    Token tok;
+    std::vector<Token> operands;
+    while (NextToken(lx, &tok)) {
+        if (tok.kind != TOK_KEYWORD) {
+            if (tok.kind == TOK_ARRAY_OPEN) {
+                // Only bfrange uses arrays: <lo> <hi> [<dst> <dst> ...]
+                if (operands.size() < 2) continue;
+                unsigned lo = BytesToCode(operands[operands.size() - 2].text);
+                unsigned hi = BytesToCode(operands[operands.size() - 1].text);
+                Token item;
+                for (unsigned code = lo; NextToken(lx, &item) && item.kind != TOK_ARRAY_CLOSE; code++) {
+                    if (code <= hi && item.kind == TOK_STR) (*table)[code] = UTF16BEToUTF8(item.text);
+                }
+                operands.clear();
+                continue;
+            }
+            operands.push_back(tok);
+            continue;
+        }
+
+        if (tok.text == "endbfchar") {
+            for (size_t i = 0; i + 1 < operands.size(); i += 2) {
+                (*table)[BytesToCode(operands[i].text)] = UTF16BEToUTF8(operands[i + 1].text);
+            }
+        } else if (tok.text == "endbfrange") {
+            for (size_t i = 0; i + 2 < operands.size(); i += 3) {
+                unsigned lo = BytesToCode(operands[i].text);
+                unsigned hi = BytesToCode(operands[i + 1].text);
+                std::string dst = operands[i + 2].text;
+                if (hi < lo || hi - lo > 0xFFFF || dst.empty()) continue;
+                for (unsigned code = lo; code <= hi; code++) {
+                    (*table)[code] = UTF16BEToUTF8(dst);
+                    dst[dst.size() - 1]++;  // ranges increment the last byte only
+                }
+            }
+        }
+        operands.clear();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Shared ToUnicode cache
+// ---------------------------------------------------------------------------
+
+// Parsed CMaps are shared by every document and thread in the process, since
+// the same embedded fonts recur across pages and across reports from one
+// source. Entries are immutable once published and live until exit, so
+// lookups walk the buckets without taking a lock.
+struct CMapEntry {
+    uint64_t hash;
+    std::string content;  // decoded CMap, compared on a hash match
+    CMapTable table;
+    CMapEntry* next;
+};
+
+static const size_t CMAP_BUCKETS = 1024;
+// Past this, new CMaps are parsed per font instead of being shared
+static const size_t CMAP_CACHE_BUDGET = 32 << 20;
+
+struct CMapCache {
+    std::atomic<CMapEntry*> buckets[CMAP_BUCKETS];
+    std::atomic<size_t> bytes;
+    std::atomic<size_t> entries;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+
+    CMapCache() : bytes(0), entries(0), hits(0), misses(0) {
+        for (size_t i = 0; i < CMAP_BUCKETS; i++) buckets[i].store(NULL, std::memory_order_relaxed);
+    }
+    ~CMapCache() {
+        for (size_t i = 0; i < CMAP_BUCKETS; i++) {
+            CMapEntry* e = buckets[i].load(std::memory_order_relaxed);
+            while (e) {
+                CMapEntry* next = e->next;
+                delete e;
+                e = next;
+            }
+        }
+    }
+};
+
+static CMapCache g_cmaps;
+
+static uint64_t ContentHash(const std::string& data) {
+    // FNV-1a
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < data.size(); i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// Searches from 'e' up to, not including, 'stop'
+static CMapEntry* FindCMap(CMapEntry* e, CMapEntry* stop, uint64_t hash, const std::string& content) {
+    for (; e != stop; e = e->next) {
+        if (e->hash == hash && e->content == content) return e;
+    }
+    return NULL;
+}
+
+// The parsed table for a decoded CMap, from the shared cache when possible.
+// Falls back to a private copy in 'own' once the cache is full.
+static const CMapTable* GetCMap(const std::string& content, std::unique_ptr<CMapTable>* own) {
+    uint64_t hash = ContentHash(content);
+    std::atomic<CMapEntry*>& bucket = g_cmaps.buckets[hash % CMAP_BUCKETS];
+    CMapEntry* head = bucket.load(std::memory_order_acquire);
+    CMapEntry* found = FindCMap(head, NULL, hash, content);
+    if (found) {
+        g_cmaps.hits.fetch_add(1, std::memory_order_relaxed);
+        return &found->table;
+    }
+
+    g_cmaps.misses.fetch_add(1, std::memory_order_relaxed);
+    if (g_cmaps.bytes.load(std::memory_order_relaxed) > CMAP_CACHE_BUDGET) {
+        own->reset(new CMapTable());
+        ParseToUnicode(content, own->get());
+        return own->get();
+    }
+
+    CMapEntry* entry = new CMapEntry();
+    entry->hash = hash;
+    entry->content = content;
+    ParseToUnicode(content, &entry->table);
+    entry->next = head;
+    while (!bucket.compare_exchange_weak(entry->next, entry, std::memory_order_release,
+                                         std::memory_order_acquire)) {
+        // Another thread may have published the same CMap meanwhile
+        found = FindCMap(entry->next, head, hash, content);
+        if (found) {
+            delete entry;
+            return &found->table;
+        }
+        head = entry->next;
+    }
+    g_cmaps.bytes.fetch_add(content.size() + entry->table.size() * 64, std::memory_order_relaxed);
+    g_cmaps.entries.fetch_add(1, std::memory_order_relaxed);
+    return &entry->table;
+}
+
+void PDFParse_CacheStats(PDFCacheStats* stats) {
+    stats->hits = g_cmaps.hits.load(std::memory_order_relaxed);
+    stats->misses = g_cmaps.misses.load(std::memory_order_relaxed);
+    stats->entries = g_cmaps.entries.load(std::memory_order_relaxed);
+    stats->bytes = g_cmaps.bytes.load(std::memory_order_relaxed);
+}
+
+static void LoadSimpleEncoding(PDFDoc* doc, const PdfObj& encObj, FontInfo* font) {
+    PdfObj enc = Resolve(doc, encObj);
+    std::string base = enc.type == PdfObj::NAME ? enc.str : "";
+    if (enc.type == PdfObj::DICT) {
+        PdfObj be = Resolve(doc, enc.Get("BaseEncoding"));
+        if (be.type == PdfObj::NAME) base = be.str;
+    }
+
+    for (int c = 0; c < 256; c++) {
+        if (base == "MacRomanEncoding" && c >= 128) {
+            font->encoding[c] = kMacRomanHigh[c - 128];
+        } else if (c >= 0x80 && c < 0xA0) {
+            font->encoding[c] = kWinAnsiHigh[c - 0x80];
+        } else {
+            font->encoding[c] = (unsigned short)c;
+        }
+    }
+    if (base == "StandardEncoding") {
+        font->encoding[0x27] = 0x2019;
+        font->encoding[0x60] = 0x2018;
+    }
+
+    if (enc.type == PdfObj::DICT) {
+        PdfObj diffs = Resolve(doc, enc.Get("Differences"));
+        if (diffs.type == PdfObj::ARRAY) {
+            int code = 0;
+            for (size_t i = 0; i < diffs.arr->size(); i++) {
+                const PdfObj& d = (*diffs.arr)[i];
+                if (d.type == PdfObj::NUM) {
+                    code = (int)d.num;
+                } else if (d.type == PdfObj::NAME) {
+                    if (code >= 0 && code < 256) font->encoding[code] = (unsigned short)GlyphNameToUnicode(d.str);
+                    code++;
+                }
+            }
+        }
+    }
+}
+
+static void LoadFont(PDFDoc* doc, const PdfObj& fontDict, FontInfo* font) {
+    for (int c = 0; c < 256; c++) font->widths[c] = 0;
+
+    if (fontDict.Get("Subtype").IsName("Type0")) {
+        font->twoByte = true;
+        PdfObj descendants = Resolve(doc, fontDict.Get("DescendantFonts"));
+        if (descendants.type == PdfObj::ARRAY && !descendants.arr->empty()) {
+            PdfObj cid = Resolve(doc, (*descendants.arr)[0]);
+            font->defaultWidth = NumberOf(doc, cid.Get("DW"), 1000);
+            PdfObj w = Resolve(doc, cid.Get("W"));
+            if (w.type == PdfObj::ARRAY) {
+                const PdfArray& a = *w.arr;
+                for (size_t i = 0; i + 1 < a.size();) {
+                    unsigned first = (unsigned)a[i].num;
+                    PdfObj next = Resolve(doc, a[i + 1]);
+                    if (next.type == PdfObj::ARRAY) {
+                        for (size_t k = 0; k < next.arr->size(); k++) {
+                            font->cidWidths[first + (unsigned)k] = NumberOf(doc, (*next.arr)[k], 0);
+                        }
+                        i += 2;
+                    } else if (i + 2 < a.size()) {
+                        unsigned last = (unsigned)next.num;
+                        double width = NumberOf(doc, a[i + 2], 0);
+                        for (unsigned c = first; c <= last && c - first < 0x10000; c++) font->cidWidths[c] = width;
+                        i += 3;
+                    } else {
+                        break;
+                    }
+                }
+            }
+        }
+    } else {
+        LoadSimpleEncoding(doc, fontDict.Get("Encoding"), font);
+        PdfObj widths = Resolve(doc, fontDict.Get("Widths"));
+        int firstChar = (int)NumberOf(doc, fontDict.Get("FirstChar"), 0);
+        if (widths.type == PdfObj::ARRAY) {
+            for (size_t i = 0; i < widths.arr->size(); i++) {
+                int c = firstChar + (int)i;
+                if (c >= 0 && c < 256) font->widths[c] = NumberOf(doc, (*widths.arr)[i], 0);
+            }
+        }
+    }
+
+    PdfObj toUnicode = Resolve(doc, fontDict.Get("ToUnicode"));
+    std::string cmap;
+    if (toUnicode.type == PdfObj::STREAM && DecodeStream(doc, toUnicode, &cmap)) {
+        font->toUnicode = GetCMap(cmap, &font->ownCMap);
+    }
+}
+
+static FontInfo* GetFont(PDFDoc* doc, const PdfObj& resources, const std::string& name,
+                         std::map<std::string, FontInfo>* localFonts) {
+    PdfObj fonts = Resolve(doc, resources.Get("Font"));
+    const PdfObj& ref = fonts.Get(name.c_str());
+
+    if (ref.type == PdfObj::REF) {
+        int num = (int)ref.num;
+        std::map<int, FontInfo>::iterator it = doc->fonts.find(num);
+        if (it != doc->fonts.end()) return &it->second;
+        FontInfo& font = doc->fonts[num];
+        LoadFont(doc, Resolve(doc, ref), &font);
+        return &font;
+    }
+
+    std::map<std::string, FontInfo>::iterator it = localFonts->find(name);
+    if (it != localFonts->end()) return &it->second;
+    FontInfo& font = (*localFonts)[name];
+    LoadFont(doc, ref, &font);
+    return &font;
+}
+
+// ---------------------------------------------------------------------------
+// Content stream interpretation
+// ---------------------------------------------------------------------------
+
+struct Matrix {
+    double a, b, c, d, e, f;
+
+    Matrix() : a(1), b(0), c(0), d(1), e(0), f(0) {}
+    Matrix(double a_, double b_, double c_, double d_, double e_, double f_)
+        : a(a_), b(b_), c(c_), d(d_), e(e_), f(f_) {}
+
+    // this x m, row-vector convention as in the PDF spec
+    Matrix Times(const Matrix& m) const {
+        return Matrix(a * m.a + b * m.c, a * m.b + b * m.d,
+                      c * m.a + d * m.c, c * m.b + d * m.d,
+                      e * m.a + f * m.c + m.e, e * m.b + f * m.d + m.f);
+    }
+};
+
+struct GraphicsState {
+    Matrix ctm;
+    FontInfo* font;
+    double fontSize;
+    double charSpacing;
+    double wordSpacing;
+    double hScale;
+    double leading;
+    double rise;
+
+    GraphicsState() : font(NULL), fontSize(0), charSpacing(0), wordSpacing(0),
+                      hScale(1), leading(0), rise(0) {}
+};
+
+struct TextWriter {
+    std::string* out;
+    bool haveLast;
+    double lastX, lastY, lastSize;
+};
+
+static void EmitRun(TextWriter* w, const std::string& text, double x, double y, double xEnd, double size) {
+    if (text.empty()) return;
+    std::string& out = *w->out;
+
+    if (w->haveLast) {
+        double tolerance = std::max(1.0, std::min(size, w->lastSize) * 0.5);
+        if (std::fabs(y - w->lastY) > tolerance) {
+            out.push_back('\n');
+        } else if (x - w->lastX > size * 0.15 && !out.empty() &&
+                   out[out.size() - 1] != ' ' && text[0] != ' ') {
+            out.push_back(' ');
+        }
+    }
+
+    out += text;
+    w->haveLast = true;
+    w->lastX = xEnd;
+    w->lastY = y;
+    w->lastSize = size;
+}
+
+static void ShowString(const std::string& bytes, GraphicsState* gs, Matrix* tm, TextWriter* w) {
+    FontInfo* font = gs->font;
+    if (!font) return;
+
+    Matrix start = tm->Times(gs->ctm);
+    double size = gs->fontSize * std::sqrt(start.c * start.c + start.d * start.d);
+
+    std::string text;
+    size_t step = font->twoByte ? 2 : 1;
+    for (size_t i = 0; i + step <= bytes.size(); i += step) {
+        unsigned code = step == 2 ? (((unsigned char)bytes[i] << 8) | (unsigned char)bytes[i + 1])
+                                  : (unsigned char)bytes[i];
+
+        CMapTable::const_iterator u;
+        if (font->toUnicode && (u = font->toUnicode->find(code)) != font->toUnicode->end()) {
+            text += u->second;
+        } else if (!font->twoByte) {
+            unsigned cp = font->encoding[code];
+            if (cp >= 0x20) AppendUTF8(&text, cp);
+        } else if (code >= 0x20) {
+            AppendUTF8(&text, code);
+        }
+
+        double width;
+        if (font->twoByte) {
+            std::map<unsigned, double>::const_iterator cw = font->cidWidths.find(code);
+            width = cw != font->cidWidths.end() ? cw->second : font->defaultWidth;
+        } else {
+            width = font->widths[code] > 0 ? font->widths[code] : font->defaultWidth;
+        }
+
+        double tx = width / 1000.0 * gs->fontSize + gs->charSpacing;
+        if (step == 1 && code == 32) tx += gs->wordSpacing;
+        *tm = Matrix(1, 0, 0, 1, tx * gs->hScale, 0).Times(*tm);
+    }
+
+    Matrix end = tm->Times(gs->ctm);
+    EmitRun(w, text, start.e, start.f, end.e, size);
+}
+
+static void SkipInlineImage(Lexer& lx) {
+    // Operands run up to ID, then binary data terminated by whitespace + EI
+    Token tok;
+    while (NextToken(lx, &tok)) {
+        if (tok.kind == TOK_KEYWORD && tok.text == "ID") break;
+    }
+    lx.pos++;
+    while (lx.pos + 2 <= lx.size) {
+        if (lx.data[lx.pos] == 'E' && lx.data[lx.pos + 1] == 'I' && IsWhite(lx.data[lx.pos - 1]) &&
+            (lx.pos + 2 == lx.size || IsWhite(lx.data[lx.pos + 2]))) {
+            lx.pos += 2;
+            return;
+        }
+        lx.pos++;
+    }
+    lx.pos = lx.size;
+}
+
+static double OperandNum(const std::vector<PdfObj>& ops, size_t fromEnd) {
+    if (ops.size() < fromEnd) return 0;
+    const PdfObj& o = ops[ops.size() - fromEnd];
+    return o.type == PdfObj::NUM ? o.num : 0;
+}
+
+static void RunContent(PDFDoc* doc, const std::string& content, const PdfObj& resources,
+                       const Matrix& baseCtm, TextWriter* w, int depth);
+
+static void RunFormXObject(PDFDoc* doc, const PdfObj& resources, const std::string& name,
+                           const GraphicsState& gs, TextWriter* w, int depth) {
+    if (depth > 8) return;
+    PdfObj xobjects = Resolve(doc, resources.Get("XObject"));
+    PdfObj form = Resolve(doc, xobjects.Get(name.c_str()));
+    if (form.type != PdfObj::STREAM || !form.Get("Subtype").IsName("Form")) return;
+
+    std::string content;
+    if (!DecodeStream(doc, form, &content)) return;
+
+    Matrix ctm = gs.ctm;
+    PdfObj m = Resolve(doc, form.Get("Matrix"));
+    if (m.type == PdfObj::ARRAY && m.arr->size() == 6) {
+        const PdfArray& a = *m.arr;
+        ctm = Matrix(a[0].num, a[1].num, a[2].num, a[3].num, a[4].num, a[5].num).Times(ctm);
+    }
+
+    PdfObj formResources = Resolve(doc, form.Get("Resources"));
+    RunContent(doc, content, formResources.type == PdfObj::DICT ? formResources : resources, ctm, w, depth + 1);
+}
+
+static void RunContent(PDFDoc* doc, const std::string& content, const PdfObj& resources,
+                       const Matrix& baseCtm, TextWriter* w, int depth) {
+    std::map<std::string, FontInfo> localFonts;
+    std::vector<GraphicsState> stack;
+    GraphicsState gs;
+    gs.ctm = baseCtm;
+    Matrix tm, tlm;
+
+    Lexer lx(content.data(), content.size());
+    std::vector<PdfObj> ops;
+    Token tok;
+
+    while (NextToken(lx, &tok)) {
+        if (tok.kind != TOK_KEYWORD || tok.text == "true" || tok.text == "false" || tok.text == "null") {
+            PdfObj operand;
+            if (ParseFromToken(lx, tok, &operand, false, 0) && ops.size() < 64) ops.push_back(operand);
+            continue;
+        }
+
+        const std::string& op = tok.text;
+        if (op == "BT") {
+            tm = tlm = Matrix();
+        } else if (op == "Tf" && ops.size() >= 2) {
+            const PdfObj& nameObj = ops[ops.size() - 2];
+            if (nameObj.type == PdfObj::NAME) gs.font = GetFont(doc, resources, nameObj.str, &localFonts);
+            gs.fontSize = OperandNum(ops, 1);
+        } else if (op == "Td" || op == "TD") {
+            double tx = OperandNum(ops, 2), ty = OperandNum(ops, 1);
+            if (op == "TD") gs.leading = -ty;
+            tlm = Matrix(1, 0, 0, 1, tx, ty).Times(tlm);
+            tm = tlm;
+        } else if (op == "Tm" && ops.size() >= 6) {
+            tlm = Matrix(OperandNum(ops, 6), OperandNum(ops, 5), OperandNum(ops, 4),
+                         OperandNum(ops, 3), OperandNum(ops, 2), OperandNum(ops, 1));
+            tm = tlm;
+        } else if (op == "T*") {
+            tlm = Matrix(1, 0, 0, 1, 0, -gs.leading).Times(tlm);
+            tm = tlm;
+        } else if (op == "TL") {
+            gs.leading = OperandNum(ops, 1);
+        } else if (op == "Tc") {
+            gs.charSpacing = OperandNum(ops, 1);
+        } else if (op == "Tw") {
+            gs.wordSpacing = OperandNum(ops, 1);
+        } else if (op == "Tz") {
+            gs.hScale = OperandNum(ops, 1) / 100.0;
+        } else if (op == "Ts") {
+            gs.rise = OperandNum(ops, 1);
+        } else if (op == "Tj" && !ops.empty() && ops.back().type == PdfObj::STR) {
+            ShowString(ops.back().str, &gs, &tm, w);
+        } else if (op == "'" && !ops.empty() && ops.back().type == PdfObj::STR) {
+            tlm = Matrix(1, 0, 0, 1, 0, -gs.leading).Times(tlm);
+            tm = tlm;
+            ShowString(ops.back().str, &gs, &tm, w);
+        } else if (op == "\"" && ops.size() >= 3 && ops.back().type == PdfObj::STR) {
+            gs.wordSpacing = OperandNum(ops, 3);
+            gs.charSpacing = OperandNum(ops, 2);
+            tlm = Matrix(1, 0, 0, 1, 0, -gs.leading).Times(tlm);
+            tm = tlm;
+            ShowString(ops.back().str, &gs, &tm, w);
+        } else if (op == "TJ" && !ops.empty() && ops.back().type == PdfObj::ARRAY) {
+            const PdfArray& items = *ops.back().arr;
+            for (size_t i = 0; i < items.size(); i++) {
+                if (items[i].type == PdfObj::STR) {
+                    ShowString(items[i].str, &gs, &tm, w);
+                } else if (items[i].type == PdfObj::NUM) {
+                    double tx = -items[i].num / 1000.0 * gs.fontSize * gs.hScale;
+                    tm = Matrix(1, 0, 0, 1, tx, 0).Times(tm);
+                }
+            }
+        } else if (op == "cm" && ops.size() >= 6) {
+            gs.ctm = Matrix(OperandNum(ops, 6), OperandNum(ops, 5), OperandNum(ops, 4),
+                            OperandNum(ops, 3), OperandNum(ops, 2), OperandNum(ops, 1)).Times(gs.ctm);
+        } else if (op == "q") {
+            if (stack.size() < 256) stack.push_back(gs);
+        } else if (op == "Q") {
+            if (!stack.empty()) {
+                gs = stack.back();
+                stack.pop_back();
+            }
+        } else if (op == "Do" && !ops.empty() && ops.back().type == PdfObj::NAME) {
+            RunFormXObject(doc, resources, ops.back().str, gs, w, depth);
+        } else if (op == "BI") {
+            SkipInlineImage(lx);
+        }
+        ops.clear();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Public interface
+// ---------------------------------------------------------------------------
+
+PDFDoc* PDFParse_Open(const char* path, std::string* error) {
+    if (!path) return NULL;
+
+    // Mapped, so image data and pages nobody reads never leave the disk
+    std::shared_ptr<MappedFile> mapped(new MappedFile(), [](MappedFile* file) {
+        MapFile_Close(file);
+        delete file;
+    });
+    if (!MapFile_Open(path, mapped.get())) {
+        if (error) *error = "Error: Could not open file.";
+        return NULL;
+    }
+
+    PDFDoc* doc = new PDFDoc(mapped);
+
+    if (doc->file.compare(0, 5, "%PDF-") != 0 && doc->file.find("%PDF-") > 1024) {
+        if (error) *error = "Error: Not a PDF file.";
+        delete doc;
+        return NULL;
+    }
+
+    if (!LoadXref(doc)) {
+        if (error) *error = "Error: Could not read PDF cross-reference table.";
+        delete doc;
+        return NULL;
+    }
+
+    if (Resolve(doc, doc->trailer.Get("Encrypt")).type != PdfObj::NONE) {
+        if (error) *error = "Error: Encrypted PDF files are not supported natively.";
+        delete doc;
+        return NULL;
+    }
+
+    PdfObj root = Resolve(doc, doc->trailer.Get("Root"));
+    std::set<int> visited;
+    CollectPages(doc, root.Get("Pages"), PdfObj(), &visited, 0);
+    if (doc->pages.empty()) {
+        if (error) *error = "Error: PDF has no pages.";
+        delete doc;
+        return NULL;
+    }
+    return doc;
+}
+
+PDFDoc* PDFParse_Clone(const PDFDoc* doc) {
+    if (!doc) return NULL;
+    // Parsed objects are never modified, so copies can share their arrays
+    // and dictionaries across threads
+    PDFDoc* clone = new PDFDoc(doc->fileData);
+    clone->xref = doc->xref;
+    clone->trailer = doc->trailer;
+    clone->objects = doc->objects;
+    clone->pages = doc->pages;
+    clone->pageResources = doc->pageResources;
+    return clone;
+}
+
+void PDFParse_Close(PDFDoc* doc) {
+    delete doc;
+}
+
+int PDFParse_PageCount(PDFDoc* doc) {
+    return doc ? (int)doc->pages.size() : 0;
+}
+
+bool PDFParse_ExtractPage(PDFDoc* doc, int pageIndex, std::string* out) {
+    if (!doc || !out || pageIndex < 0 || pageIndex >= (int)doc->pages.size()) return false;
+    TrimCaches(doc);
+
+    const PdfObj& page = doc->pages[pageIndex];
+    PdfObj contents = Resolve(doc, page.Get("Contents"));
+
+    std::string content;
+    if (contents.type == PdfObj::STREAM) {
+        DecodeStream(doc, contents, &content);
+    } else if (contents.type == PdfObj::ARRAY) {
+        for (size_t i = 0; i < contents.arr->size(); i++) {
+            std::string part;
+            if (DecodeStream(doc, Resolve(doc, (*contents.arr)[i]), &part)) {
+                content += part;
+                content.push_back('\n');
+            }
+        }
+    }
+
+    TextWriter writer = {out, false, 0, 0, 0};
+    RunContent(doc, content, doc->pageResources[pageIndex], Matrix(), &writer, 0);
+    return true;
+}
+
+bool PDFParse_ExtractText(const char* path, std::string* out, std::string* error) {
+    if (!out) return false;
+
+    PDFDoc* doc = PDFParse_Open(path, error);
+    if (!doc) return false;
+
+    out->clear();
+    for (int i = 0; i < PDFParse_PageCount(doc); i++) {
+        PDFParse_ExtractPage(doc, i, out);
+        out->append("\n\n");
+    }
+    PDFParse_Close(doc);
+    return true;
+}
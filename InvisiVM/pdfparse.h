@@ -0,0 +1,37 @@
+#ifndef PDFPARSE_H
+#define PDFPARSE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Native PDF text extraction. Handles classic xref tables, xref streams,
+// object streams, FlateDecode, simple and Type0 fonts with ToUnicode CMaps.
+// Anything it cannot read is reported through 'error' so the caller can fall
+// back to the Python extractor.
+struct PDFDoc;
+
+PDFDoc* PDFParse_Open(const char* path, std::string* error);
+// Another handle on an open document for use on a different thread. The
+// file and page tree are shared; object and font caches are per handle.
+// Several threads may clone one original at once as long as none of them
+// extracts from it.
+PDFDoc* PDFParse_Clone(const PDFDoc* doc);
+void PDFParse_Close(PDFDoc* doc);
+int PDFParse_PageCount(PDFDoc* doc);
+bool PDFParse_ExtractPage(PDFDoc* doc, int pageIndex, std::string* out);
+
+// Parsed ToUnicode CMaps are cached process-wide, keyed by content, and
+// shared by every document and thread
+struct PDFCacheStats {
+    uint64_t hits;
+    uint64_t misses;   // each one parsed a CMap
+    size_t entries;
+    size_t bytes;
+};
+void PDFParse_CacheStats(PDFCacheStats* stats);
+
+// Whole document, pages separated by a blank line like program.py
+bool PDFParse_ExtractText(const char* path, std::string* out, std::string* error);
+
+#endif
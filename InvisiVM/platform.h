@@ -0,0 +1,66 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+// windows.h on Windows. Elsewhere, the few Win32 types and macros the
+// shared headers use, so the drawing code and the state it draws build
+// without it and can render headlessly.
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstdint>
+#include <cstring>
+
+typedef void* HANDLE;
+typedef void* HWND;
+typedef void* HINSTANCE;
+typedef int BOOL;
+typedef int32_t LONG;
+typedef uint32_t DWORD;
+typedef unsigned int UINT;
+typedef uintptr_t UINT_PTR;
+typedef uintptr_t WPARAM;
+typedef intptr_t LPARAM;
+typedef uint32_t COLORREF;
+
+struct POINT {
+    LONG x;
+    LONG y;
+};
+
+struct RECT {
+    LONG left;
+    LONG top;
+    LONG right;
+    LONG bottom;
+};
+
+struct PROCESS_INFORMATION {
+    HANDLE hProcess;
+    HANDLE hThread;
+    DWORD dwProcessId;
+    DWORD dwThreadId;
+};
+
+#define CALLBACK
+#define ZeroMemory(p, n) memset((p), 0, (n))
+
+#define RGB(r, g, b) ((COLORREF)((uint8_t)(r) | ((uint32_t)(uint8_t)(g) << 8) | ((uint32_t)(uint8_t)(b) << 16)))
+#define GetRValue(c) ((uint8_t)(c))
+#define GetGValue(c) ((uint8_t)((c) >> 8))
+#define GetBValue(c) ((uint8_t)((c) >> 16))
+
+#define WM_APP 0x8000
+
+#define FW_NORMAL 400
+#define FW_BOLD 700
+
+#define DT_TOP 0x00
+#define DT_LEFT 0x00
+#define DT_CENTER 0x01
+#define DT_RIGHT 0x02
+#define DT_VCENTER 0x04
+#define DT_BOTTOM 0x08
+#define DT_SINGLELINE 0x20
+#endif
+
+#endif
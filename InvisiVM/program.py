@@ -1,14 +1,12 @@
 import sys
 import os
+import struct
 
 def extract_pdf(filepath):
     try:
         from pypdf import PdfReader
         reader = PdfReader(filepath)
-        text = ""
-        for page in reader.pages:
-            text += page.extract_text() + "\n\n"
-        return text
+        return "".join(page.extract_text() + "\n\n" for page in reader.pages)
     except ImportError:
         return "Error: pypdf library not installed. Run: pip install pypdf"
     except Exception as e:
@@ -16,16 +14,17 @@ def extract_pdf(filepath):
 
 def extract_txt(filepath):
     try:
-        with open(filepath, 'r', encoding='utf-8') as f:
-            return f.read()
-    except UnicodeDecodeError:
-        try:
-            with open(filepath, 'r', encoding='latin-1') as f:
-                return f.read()
-        except Exception as e:
-            return f"Error reading TXT file: {e}"
+        # Read once; fall back to Latin-1 on the same bytes
+        with open(filepath, 'rb') as f:
+            data = f.read()
     except Exception as e:
         return f"Error reading TXT file: {e}"
+    if data.startswith(b'\xff\xfe') or data.startswith(b'\xfe\xff'):
+        return data.decode('utf-16', errors='replace')
+    try:
+        return data.decode('utf-8-sig')
+    except UnicodeDecodeError:
+        return data.decode('latin-1')
 
 def extract_csv(filepath, delimiter=','):
     try:
@@ -73,7 +72,43 @@ def extract_text(filepath, expected_type=None):
     else:
         return f"Error: Unsupported file type '.{ext}'"
 
+def serve():
+    # Resident worker mode used by the viewer's pool. Each request is a
+    # little-endian uint32 length followed by "path\0expected_type"; each
+    # response is a uint32 length followed by the UTF-8 text.
+    for module in ('pypdf', 'docx'):
+        try:
+            __import__(module)
+        except ImportError:
+            pass
+
+    stdin = sys.stdin.buffer
+    stdout = sys.stdout.buffer
+    while True:
+        header = stdin.read(4)
+        if len(header) < 4:
+            break
+        (size,) = struct.unpack('<I', header)
+        payload = stdin.read(size)
+        if len(payload) < size:
+            break
+
+        filepath, _, expected_type = payload.decode('utf-8').partition('\0')
+        try:
+            text = extract_text(filepath, expected_type or None)
+        except Exception as e:
+            text = f"Error: {e}"
+
+        data = text.encode('utf-8', errors='replace')
+        stdout.write(struct.pack('<I', len(data)))
+        stdout.write(data)
+        stdout.flush()
+
 if __name__ == "__main__":
+    if len(sys.argv) > 1 and sys.argv[1] == '--serve':
+        serve()
+        sys.exit(0)
+
     if len(sys.argv) < 2:
         print("Usage: python extract_text.py <filepath> [expected_type]")
         sys.exit(1)
@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <cstring>
+#include <regex>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SEARCH_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "searchindex.h"
+
+static const int BUCKET_BITS = 16;
+static const size_t BLOCK_WORDS = ((size_t)1 << BUCKET_BITS) / 64;
+// A block's bitmap also holds the trigrams running this far into the next
+// block, so a match starting near the end of a block is still found there.
+// Queries only test trigrams starting in their first OVERLAP - 2 bytes.
+static const size_t OVERLAP = 256;
+// How far past the range being searched a regex match may run, so a file
+// with no line breaks is not read to its end for every search
+static const size_t REGEX_REACH = 64 << 10;
+
+struct SearchRegex {
+    std::regex expression;
+};
+
+struct FoldTable {
+    unsigned char map[256];
+
+    FoldTable() {
+        for (int c = 0; c < 256; c++) map[c] = (unsigned char)(c >= 'A' && c <= 'Z' ? c + 32 : c);
+    }
+};
+
+static const FoldTable g_fold;
+
+static inline unsigned char Fold(char c) {
+    return g_fold.map[(unsigned char)c];
+}
+
+static inline unsigned char Unfold(unsigned char c) {
+    return (unsigned char)(c >= 'a' && c <= 'z' ? c - 32 : c);
+}
+
+#ifdef SEARCH_SSE2
+static inline int LowestBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return (int)bit;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// 24-bit trigram to a bit number
+static inline uint32_t Bucket(uint32_t trigram) {
+    return (trigram * 0x9E3779B1u) >> (32 - BUCKET_BITS);
+}
+
+// Longest run of plain characters every match of the expression contains,
+// folded. Empty if there is a '|' outside parentheses or no such run.
+static std::string RequiredLiteral(const std::string& pattern) {
+    std::string best, run;
+    int depth = 0;
+    size_t n = pattern.size();
+    size_t i = 0;
+    while (i < n) {
+        char c = pattern[i];
+        int literal = -1;  // the byte this token stands for, if it is plain
+        size_t next = i + 1;
+        if (c == '\\' && i + 1 < n) {
+            char escaped = pattern[i + 1];
+            next = i + 2;
+            if (strchr(".^$|?*+()[]{}\\/-", escaped)) {
+                literal = (unsigned char)escaped;
+            } else if (escaped == 'x') {
+                next += 2;
+            } else if (escaped == 'u') {
+                next += 4;
+            } else if (escaped == 'c') {
+                next += 1;
+            }
+        } else if (c == '[' || c == '{') {
+            char close = c == '[' ? ']' : '}';
+            while (next < n && pattern[next] != close) next += pattern[next] == '\\' ? 2 : 1;
+            next++;
+        } else if (c == '(') {
+            depth++;
+        } else if (c == ')') {
+            depth--;
+        } else if (c == '|') {
+            if (depth == 0) return std::string();
+        } else if (!strchr(".^$?*+", c)) {
+            literal = (unsigned char)c;
+        }
+
+        // A token followed by ?, * or {n,m} may not be there at all, and
+        // after a + the next token need not follow it directly
+        bool optional = next < n && (pattern[next] == '?' || pattern[next] == '*' || pattern[next] == '{');
+        bool repeated = next < n && pattern[next] == '+';
+        if (literal >= 0 && literal < 0x80 && depth == 0 && !optional) run.push_back((char)Fold((char)literal));
+        if (literal < 0 || literal >= 0x80 || depth != 0 || optional || repeated) {
+            if (run.size() > best.size()) best = run;
+            run.clear();
+        }
+        i = next;
+    }
+    if (run.size() > best.size()) best = run;
+    return best;
+}
+
+bool Search_Prepare(SearchQuery* query, const std::string& pattern, bool regex) {
+    query->regex.reset();
+    query->counts.reset();
+    query->folded.clear();
+    query->trigrams.clear();
+
+    std::string literal = pattern;
+    if (regex) {
+        // std::regex reports a bad pattern by throwing; nothing else here does
+        std::shared_ptr<SearchRegex> compiled = std::make_shared<SearchRegex>();
+        try {
+            compiled->expression.assign(pattern, std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+        } catch (const std::regex_error&) {
+            return false;
+        }
+        query->regex = compiled;
+        literal = RequiredLiteral(pattern);
+    }
+
+    query->folded.resize(literal.size());
+    for (size_t i = 0; i < literal.size(); i++) query->folded[i] = (char)Fold(literal[i]);
+
+    // A regex's literal may sit further into a match than a block's bitmap
+    // reaches, so only literal queries use the trigrams
+    for (size_t i = 0; !regex && i < OVERLAP - 2 && i + 2 < query->folded.size(); i++) {
+        const unsigned char* p = (const unsigned char*)query->folded.data() + i;
+        query->trigrams.push_back(Bucket((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]));
+    }
+    std::sort(query->trigrams.begin(), query->trigrams.end());
+    query->trigrams.erase(std::unique(query->trigrams.begin(), query->trigrams.end()), query->trigrams.end());
+
+    size_t m = query->folded.size();
+    for (int c = 0; c < 256; c++) query->shift[c] = m;
+    for (size_t i = 0; i + 1 < m; i++) query->shift[(unsigned char)query->folded[i]] = m - 1 - i;
+    return true;
+}
+
+void Search_StartCounts(SearchQuery* query, size_t size) {
+    std::shared_ptr<SearchCounts> counts = std::make_shared<SearchCounts>();
+    counts->size = size;
+    counts->blocks = (size + SEARCH_BLOCK - 1) / SEARCH_BLOCK;
+    counts->perBlock.reset(new std::atomic<size_t>[counts->blocks]);
+    for (size_t b = 0; b < counts->blocks; b++) counts->perBlock[b] = SEARCH_NONE;
+    query->counts = counts;
+}
+
+void SearchIndex_Init(SearchIndex* index, size_t size) {
+    index->size = size;
+    index->bits.assign(SearchIndex_Blocks(index) * BLOCK_WORDS, 0);
+}
+
+size_t SearchIndex_Blocks(const SearchIndex* index) {
+    return (index->size + SEARCH_BLOCK - 1) / SEARCH_BLOCK;
+}
+
+void SearchIndex_Build(SearchIndex* index, const char* text, size_t first, size_t end) {
+    end = std::min(end, SearchIndex_Blocks(index));
+    for (size_t b = first; b < end; b++) {
+        uint64_t* row = &index->bits[b * BLOCK_WORDS];
+        size_t start = b * SEARCH_BLOCK;
+        size_t stop = std::min(index->size, start + SEARCH_BLOCK + OVERLAP);
+        if (stop - start < 3) continue;
+        uint32_t trigram = (uint32_t)Fold(text[start]) << 8 | Fold(text[start + 1]);
+        for (size_t i = start + 2; i < stop; i++) {
+            trigram = (trigram << 8 | Fold(text[i])) & 0xFFFFFF;
+            uint32_t bit = Bucket(trigram);
+            row[bit >> 6] |= (uint64_t)1 << (bit & 63);
+        }
+    }
+}
+
+size_t SearchIndex_MemoryBytes(const SearchIndex* index) {
+    return index ? index->bits.capacity() * sizeof(uint64_t) : 0;
+}
+
+// Whether block b has to be read: it has not been counted empty, and the
+// index, where it fully covers the block, has every trigram
+static bool MayMatch(const SearchIndex* index, const SearchQuery* query, size_t size, size_t b) {
+    const SearchCounts* counts = query->counts.get();
+    if (counts && counts->size == size && b < counts->blocks && counts->perBlock[b].load() == 0) return false;
+    if (!index || index->size == 0) return true;
+    if (index->size != size && (b + 1) * SEARCH_BLOCK + OVERLAP > index->size) return true;
+    const uint64_t* row = &index->bits[b * BLOCK_WORDS];
+    for (size_t i = 0; i < query->trigrams.size(); i++) {
+        uint32_t bit = query->trigrams[i];
+        if (!(row[bit >> 6] >> (bit & 63) & 1)) return false;
+    }
+    return true;
+}
+
+static inline bool EqualsFolded(const char* text, const char* folded, size_t m) {
+    for (size_t i = 0; i < m; i++) {
+        if (Fold(text[i]) != (unsigned char)folded[i]) return false;
+    }
+    return true;
+}
+
+// First place the literal starts in [begin, end)
+static size_t FindLiteral(const SearchQuery* query, const char* text, size_t size, size_t begin, size_t end) {
+    size_t m = query->folded.size();
+    if (m == 0 || m > size) return SEARCH_NONE;
+    end = std::min(end, size - m + 1);
+    const char* pattern = query->folded.data();
+    size_t pos = begin;
+#ifdef SEARCH_SSE2
+    // 16 positions per step. Only those whose first and last bytes both
+    // match, in either case, are compared in full.
+    unsigned char first = (unsigned char)pattern[0], last = (unsigned char)pattern[m - 1];
+    const __m128i firstLower = _mm_set1_epi8((char)first), firstUpper = _mm_set1_epi8((char)Unfold(first));
+    const __m128i lastLower = _mm_set1_epi8((char)last), lastUpper = _mm_set1_epi8((char)Unfold(last));
+    while (pos + 16 <= end) {
+        __m128i head = _mm_loadu_si128((const __m128i*)(text + pos));
+        __m128i tail = _mm_loadu_si128((const __m128i*)(text + pos + m - 1));
+        __m128i hit = _mm_and_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(head, firstLower), _mm_cmpeq_epi8(head, firstUpper)),
+            _mm_or_si128(_mm_cmpeq_epi8(tail, lastLower), _mm_cmpeq_epi8(tail, lastUpper)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        while (mask) {
+            size_t at = pos + LowestBit(mask);
+            if (EqualsFolded(text + at, pattern, m)) return at;
+            mask &= mask - 1;
+        }
+        pos += 16;
+    }
+#endif
+    // Horspool on the last byte for whatever is left
+    unsigned char lastByte = (unsigned char)pattern[m - 1];
+    while (pos < end) {
+        unsigned char c = Fold(text[pos + m - 1]);
+        if (c == lastByte && EqualsFolded(text + pos, pattern, m - 1)) return pos;
+        pos += query->shift[c];
+    }
+    return SEARCH_NONE;
+}
+
+// First regex match starting in [begin, end), a line at a time. The first
+// line is searched from 'begin', so '^' only matches there if it is the
+// start of a line.
+static size_t FindRegex(const SearchQuery* query, const char* text, size_t size, size_t begin, size_t end,
+                        size_t* length) {
+    const std::regex& expression = query->regex->expression;
+    end = std::min(end, size);
+    size_t limit = std::min(size, end + REGEX_REACH);
+    size_t pos = begin;
+    while (pos < end) {
+        const char* newline = (const char*)memchr(text + pos, '\n', limit - pos);
+        size_t lineEnd = newline ? (size_t)(newline - text) : limit;
+        size_t next = newline ? lineEnd + 1 : limit;
+        if (lineEnd > pos && text[lineEnd - 1] == '\r') lineEnd--;
+
+        bool hasLiteral = query->folded.empty() ||
+                          FindLiteral(query, text + pos, lineEnd - pos, 0, lineEnd - pos) != SEARCH_NONE;
+        std::regex_constants::match_flag_type flags = std::regex_constants::match_default;
+        if (pos > 0 && text[pos - 1] != '\n') flags |= std::regex_constants::match_prev_avail;
+        if (!newline && limit < size) flags |= std::regex_constants::match_not_eol;
+        size_t from = pos;
+        while (hasLiteral && from <= lineEnd) {
+            std::cmatch match;
+            bool found;
+            try {
+                found = std::regex_search(text + from, text + lineEnd, match, expression, flags);
+            } catch (const std::regex_error&) {
+                // Too complex to finish on this line
+                found = false;
+            }
+            if (!found) break;
+            size_t at = (size_t)(match[0].first - text);
+            if (at >= end) return SEARCH_NONE;
+            // Empty matches, which "x*" has everywhere, are not shown
+            if (match.length(0) > 0) {
+                if (length) *length = (size_t)match.length(0);
+                return at;
+            }
+            from = at + 1;
+            flags |= std::regex_constants::match_prev_avail;
+        }
+        pos = next;
+    }
+    return SEARCH_NONE;
+}
+
+static size_t Find(const SearchQuery* query, const char* text, size_t size, size_t begin, size_t end,
+                   size_t* length) {
+    if (query->regex) return FindRegex(query, text, size, begin, end, length);
+    size_t found = FindLiteral(query, text, size, begin, end);
+    if (found != SEARCH_NONE && length) *length = query->folded.size();
+    return found;
+}
+
+size_t Search_Next(const SearchIndex* index, const SearchQuery* query, const char* text, size_t size,
+                   size_t from, size_t* length) {
+    for (size_t b = from / SEARCH_BLOCK; b * SEARCH_BLOCK < size; b++) {
+        if (!MayMatch(index, query, size, b)) continue;
+        size_t begin = std::max(from, b * SEARCH_BLOCK);
+        size_t found = Find(query, text, size, begin, (b + 1) * SEARCH_BLOCK, length);
+        if (found != SEARCH_NONE) return found;
+    }
+    return SEARCH_NONE;
+}
+
+size_t Search_Prev(const SearchIndex* index, const SearchQuery* query, const char* text, size_t size,
+                   size_t before, size_t* length) {
+    before = std::min(before, size);
+    for (size_t b = (before + SEARCH_BLOCK - 1) / SEARCH_BLOCK; b-- > 0;) {
+        if (!MayMatch(index, query, size, b)) continue;
+        size_t end = std::min(before, (b + 1) * SEARCH_BLOCK);
+        size_t last = SEARCH_NONE, lastLength = 0;
+        size_t pos = b * SEARCH_BLOCK;
+        for (;;) {
+            size_t foundLength = 0;
+            size_t found = Find(query, text, size, pos, end, &foundLength);
+            if (found == SEARCH_NONE) break;
+            last = found;
+            lastLength = foundLength;
+            pos = found + 1;
+        }
+        if (last != SEARCH_NONE) {
+            if (length) *length = lastLength;
+            return last;
+        }
+    }
+    return SEARCH_NONE;
+}
+
+size_t Search_Count(const SearchIndex* index, const SearchQuery* query, const char* text, size_t size,
+                    size_t begin, size_t end) {
+    end = std::min(end, size);
+    size_t count = 0;
+    for (size_t b = begin / SEARCH_BLOCK; b * SEARCH_BLOCK < end; b++) {
+        if (!MayMatch(index, query, size, b)) continue;
+        size_t pos = std::max(begin, b * SEARCH_BLOCK);
+        size_t blockEnd = std::min(end, (b + 1) * SEARCH_BLOCK);
+        for (;;) {
+            size_t found = Find(query, text, size, pos, blockEnd, NULL);
+            if (found == SEARCH_NONE) break;
+            count++;
+            pos = found + 1;
+        }
+    }
+    return count;
+}
+
+size_t Search_CountBlock(const SearchIndex* index, const SearchQuery* query, const char* text, size_t size,
+                         size_t b) {
+    size_t count = Search_Count(index, query, text, size, b * SEARCH_BLOCK, (b + 1) * SEARCH_BLOCK);
+    SearchCounts* counts = query->counts.get();
+    if (counts && counts->size == size && b < counts->blocks) counts->perBlock[b] = count;
+    return count;
+}
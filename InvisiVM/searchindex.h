@@ -0,0 +1,82 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Full-text search over a document's bytes, ignoring ASCII case.
+//
+// The text is cut into SEARCH_BLOCK sized blocks and each block gets a
+// 64 Kbit bitmap of the trigrams in it, hashed. A search only reads blocks
+// whose bitmap has every trigram of the query, so a rare string in a 1 GB
+// log costs a few bit tests per block and a scan of a handful of blocks.
+// The bitmaps take 1/16 of the text.
+const size_t SEARCH_BLOCK = 128 << 10;
+const size_t SEARCH_NONE = (size_t)-1;
+
+struct SearchIndex {
+    size_t size;                 // bytes covered
+    std::vector<uint64_t> bits;  // one bitmap per block
+
+    SearchIndex() : size(0) {}
+};
+
+// Matches per block for one query, recorded as a scan counts them. Later
+// searches with the query skip the blocks found empty.
+struct SearchCounts {
+    size_t size;  // the text counted
+    size_t blocks;
+    std::unique_ptr<std::atomic<size_t>[]> perBlock;  // SEARCH_NONE until counted
+};
+
+struct SearchRegex;
+
+// A pattern ready to look for. Literal patterns under 3 bytes have no
+// trigrams and are scanned for everywhere.
+//
+// A regular expression (ECMAScript, case-insensitive) is matched a line at
+// a time, so a match never spans a line break, and a match longer than
+// 64 KB may be cut short. Only lines holding the longest literal run the
+// expression requires are tried.
+struct SearchQuery {
+    std::string folded;              // the literal, or the one a regex requires
+    std::vector<uint32_t> trigrams;  // bits every candidate block has set
+    size_t shift[256];               // Horspool skip per folded byte
+    std::shared_ptr<const SearchRegex> regex;  // NULL for a literal search
+    std::shared_ptr<SearchCounts> counts;      // shared by copies of the query
+};
+
+// False if 'regex' is set and the pattern is not a valid expression
+bool Search_Prepare(SearchQuery* query, const std::string& pattern, bool regex);
+// Gives the query per-block counts for a text of 'size' bytes
+void Search_StartCounts(SearchQuery* query, size_t size);
+
+// Sizes the index for 'size' bytes. Blocks can then be built in any order,
+// separate ranges on different threads at once.
+void SearchIndex_Init(SearchIndex* index, size_t size);
+size_t SearchIndex_Blocks(const SearchIndex* index);
+// Builds blocks [first, end) from the text the index was sized for
+void SearchIndex_Build(SearchIndex* index, const char* text, size_t first, size_t end);
+size_t SearchIndex_MemoryBytes(const SearchIndex* index);
+
+// 'index' may be NULL, or cover only the start of the text; the rest is
+// read in full. A match may overlap the one before it. 'length' receives
+// the length of the match and may be NULL.
+// First match starting at or after 'from'
+size_t Search_Next(const SearchIndex* index, const SearchQuery* query, const char* text, size_t size,
+                   size_t from, size_t* length);
+// Last match starting before 'before'
+size_t Search_Prev(const SearchIndex* index, const SearchQuery* query, const char* text, size_t size,
+                   size_t before, size_t* length);
+// Matches starting in [begin, end)
+size_t Search_Count(const SearchIndex* index, const SearchQuery* query, const char* text, size_t size,
+                    size_t begin, size_t end);
+// Counts the matches starting in block b and records them in query->counts
+size_t Search_CountBlock(const SearchIndex* index, const SearchQuery* query, const char* text, size_t size,
+                         size_t b);
+
+#endif
@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "softcanvas.h"
+#include "constants.h"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CANVAS_SSE2 1
+#endif
+
+static inline uint32_t Opaque(COLORREF color) {
+    return (color & 0xFFFFFF) | 0xFF000000u;
+}
+
+// round(x / 255) for x up to 255 * 255, as the SSE2 path computes it
+static inline uint32_t Div255(uint32_t x) {
+    return ((x + 128) * 257) >> 16;
+}
+
+// Lays 'color' over a row of pixels by a row of coverage
+static void BlendSpan(uint32_t* dst, const uint8_t* coverage, int count, COLORREF color) {
+    uint32_t solid = Opaque(color);
+    uint32_t r = GetRValue(color), g = GetGValue(color), b = GetBValue(color);
+    int i = 0;
+#ifdef CANVAS_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i scale = _mm_set1_epi16(257);
+    const __m128i src = _mm_set_epi16(255, (short)b, (short)g, (short)r, 255, (short)b, (short)g, (short)r);
+    const __m128i solid4 = _mm_set1_epi32((int)solid);
+    for (; i + 4 <= count; i += 4) {
+        uint32_t four;
+        memcpy(&four, coverage + i, 4);
+        if (four == 0) continue;
+        if (four == 0xFFFFFFFFu) {
+            _mm_storeu_si128((__m128i*)(dst + i), solid4);
+            continue;
+        }
+        // Each coverage byte over the four channels of its pixel
+        __m128i a = _mm_cvtsi32_si128((int)four);
+        a = _mm_unpacklo_epi8(a, a);
+        a = _mm_unpacklo_epi16(a, a);
+        __m128i aLow = _mm_unpacklo_epi8(a, zero), aHigh = _mm_unpackhi_epi8(a, zero);
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i dLow = _mm_unpacklo_epi8(d, zero), dHigh = _mm_unpackhi_epi8(d, zero);
+        // dst * (255 - a) + src * a stays under 65536, so 16 bit lanes hold it
+        __m128i low = _mm_add_epi16(_mm_mullo_epi16(dLow, _mm_sub_epi16(full, aLow)), _mm_mullo_epi16(src, aLow));
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(dHigh, _mm_sub_epi16(full, aHigh)), _mm_mullo_epi16(src, aHigh));
+        low = _mm_mulhi_epu16(_mm_add_epi16(low, half), scale);
+        high = _mm_mulhi_epu16(_mm_add_epi16(high, half), scale);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(low, high));
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t a = coverage[i];
+        if (a == 0) continue;
+        if (a == 255) {
+            dst[i] = solid;
+            continue;
+        }
+        uint32_t d = dst[i];
+        uint32_t inv = 255 - a;
+        uint32_t outR = Div255((d & 0xFF) * inv + r * a);
+        uint32_t outG = Div255(((d >> 8) & 0xFF) * inv + g * a);
+        uint32_t outB = Div255(((d >> 16) & 0xFF) * inv + b * a);
+        uint32_t outA = Div255((d >> 24) * inv + 255 * a);
+        dst[i] = outR | outG << 8 | outB << 16 | outA << 24;
+    }
+}
+
+static RECT Intersect(const RECT& a, const RECT& b) {
+    RECT out = {std::max(a.left, b.left), std::max(a.top, b.top), std::min(a.right, b.right),
+                std::min(a.bottom, b.bottom)};
+    if (out.right < out.left) out.right = out.left;
+    if (out.bottom < out.top) out.bottom = out.top;
+    return out;
+}
+
+// Pixels of row 'y' whose centres lie in the ellipse inscribed in 'box'
+static bool EllipseSpan(const RECT& box, int y, int* x0, int* x1) {
+    double rx = (box.right - box.left) / 2.0, ry = (box.bottom - box.top) / 2.0;
+    if (rx <= 0 || ry <= 0) return false;
+    double cx = (box.left + box.right) / 2.0, cy = (box.top + box.bottom) / 2.0;
+    double dy = (y + 0.5 - cy) / ry;
+    if (dy < -1 || dy > 1) return false;
+    double reach = rx * std::sqrt(1 - dy * dy);
+    *x0 = (int)std::ceil(cx - reach - 0.5);
+    *x1 = (int)std::floor(cx + reach - 0.5) + 1;
+    return *x1 > *x0;
+}
+
+// The pen of StrokeRect and StrokeEllipse: centred on the edge, where the
+// right and bottom edges are the last pixels inside
+static void PenBoxes(const RECT& rect, int penWidth, RECT* outer, RECT* inner) {
+    int before = penWidth / 2, after = penWidth - before;
+    *outer = {rect.left - before, rect.top - before, rect.right - 1 + after, rect.bottom - 1 + after};
+    *inner = {outer->left + penWidth, outer->top + penWidth, outer->right - penWidth, outer->bottom - penWidth};
+}
+
+void SoftCanvasMeasurer::Measure(wchar_t first, wchar_t last, int* advances) {
+    for (uint32_t c = first; c <= (uint32_t)last; c++) advances[c - first] = canvas->Advance(slot, c);
+}
+
+SoftCanvas::SoftCanvas(int width, int height, GlyphRasterizer* rasterizer, GlyphSource* metrics)
+    : width(std::max(0, width)), height(std::max(0, height)),
+      rasterizer(rasterizer ? rasterizer : GlyphRaster_Default()), metrics(metrics) {
+    pixels.assign((size_t)this->width * this->height, Opaque(RGB(0, 0, 0)));
+    deviceFont = {L"DejaVu Sans", LINE_HEIGHT, FW_NORMAL, false};
+    paint = clip = {0, 0, this->width, this->height};
+    measurer.canvas = this;
+    measurer.slot = 0;
+}
+
+COLORREF SoftCanvas::Pixel(int x, int y) const {
+    if (x < 0 || y < 0 || x >= width || y >= height) return 0;
+    return pixels[(size_t)y * width + x] & 0xFFFFFF;
+}
+
+void SoftCanvas::SetClip(const RECT* rect) {
+    clip = rect ? Intersect(*rect, paint) : paint;
+}
+
+void SoftCanvas::SetPaintArea(const RECT* rect) {
+    RECT bounds = {0, 0, width, height};
+    paint = clip = rect ? Intersect(*rect, bounds) : bounds;
+}
+
+bool SoftCanvas::Visible(const RECT& rect) {
+    RECT shown = Intersect(rect, clip);
+    return shown.right > shown.left && shown.bottom > shown.top;
+}
+
+void SoftCanvas::Scroll(const RECT& rect, int dx, int dy) {
+    RECT area = Intersect(rect, {0, 0, width, height});
+    RECT to = Intersect({area.left + dx, area.top + dy, area.right + dx, area.bottom + dy}, area);
+    if (to.right <= to.left || to.bottom <= to.top) return;
+    size_t count = (size_t)(to.right - to.left) * sizeof(uint32_t);
+    // Rows are copied away from the direction of the move, so none is
+    // overwritten before it is read
+    for (int i = 0; i < to.bottom - to.top; i++) {
+        int y = dy > 0 ? to.bottom - 1 - i : to.top + i;
+        uint32_t* row = pixels.data() + (size_t)y * width;
+        memmove(row + to.left, row - (ptrdiff_t)dy * width + to.left - dx, count);
+    }
+}
+
+void SoftCanvas::FillSpan(int y, int x0, int x1, uint32_t pixel) {
+    if (y < clip.top || y >= clip.bottom) return;
+    x0 = std::max<int>(x0, clip.left);
+    x1 = std::min<int>(x1, clip.right);
+    if (x1 > x0) std::fill_n(pixels.begin() + (size_t)y * width + x0, x1 - x0, pixel);
+}
+
+void SoftCanvas::FillBox(int left, int top, int right, int bottom, COLORREF color) {
+    uint32_t pixel = Opaque(color);
+    top = std::max<int>(top, clip.top);
+    bottom = std::min<int>(bottom, clip.bottom);
+    for (int y = top; y < bottom; y++) FillSpan(y, left, right, pixel);
+}
+
+void SoftCanvas::FillRect(const RECT& rect, COLORREF color) {
+    FillBox(rect.left, rect.top, rect.right, rect.bottom, color);
+}
+
+void SoftCanvas::StrokeRect(const RECT& rect, int penWidth, COLORREF color) {
+    if (penWidth <= 0) return;
+    RECT outer, inner;
+    PenBoxes(rect, penWidth, &outer, &inner);
+    if (inner.right <= inner.left || inner.bottom <= inner.top) {
+        FillRect(outer, color);
+        return;
+    }
+    FillBox(outer.left, outer.top, outer.right, inner.top, color);
+    FillBox(outer.left, inner.bottom, outer.right, outer.bottom, color);
+    FillBox(outer.left, inner.top, inner.left, inner.bottom, color);
+    FillBox(inner.right, inner.top, outer.right, inner.bottom, color);
+}
+
+void SoftCanvas::Line(int x0, int y0, int x1, int y1, int penWidth, COLORREF color) {
+    if (penWidth <= 0) return;
+    int before = penWidth / 2;
+    if (y0 == y1) {
+        int left = x0 < x1 ? x0 : x1 + 1, right = x0 < x1 ? x1 : x0 + 1;
+        FillBox(left, y0 - before, right, y0 - before + penWidth, color);
+        return;
+    }
+    if (x0 == x1) {
+        int top = y0 < y1 ? y0 : y1 + 1, bottom = y0 < y1 ? y1 : y0 + 1;
+        FillBox(x0 - before, top, x0 - before + penWidth, bottom, color);
+        return;
+    }
+    // Anything else a pen-sized square at a time, leaving the end out
+    int steps = std::max(std::abs(x1 - x0), std::abs(y1 - y0));
+    for (int i = 0; i < steps; i++) {
+        int x = x0 + (int)std::lround((double)(x1 - x0) * i / steps);
+        int y = y0 + (int)std::lround((double)(y1 - y0) * i / steps);
+        FillBox(x - before, y - before, x - before + penWidth, y - before + penWidth, color);
+    }
+}
+
+void SoftCanvas::DrawEllipse(const RECT& outer, const RECT& inner, COLORREF ring, const COLORREF* fill) {
+    uint32_t ringPixel = Opaque(ring);
+    uint32_t fillPixel = fill ? Opaque(*fill) : 0;
+    int top = std::max<int>(outer.top, clip.top), bottom = std::min<int>(outer.bottom, clip.bottom);
+    for (int y = top; y < bottom; y++) {
+        int a0, a1, b0, b1;
+        if (!EllipseSpan(outer, y, &a0, &a1)) continue;
+        if (!EllipseSpan(inner, y, &b0, &b1)) {
+            FillSpan(y, a0, a1, ringPixel);
+            continue;
+        }
+        FillSpan(y, a0, b0, ringPixel);
+        FillSpan(y, b1, a1, ringPixel);
+        if (fill) FillSpan(y, b0, b1, fillPixel);
+    }
+}
+
+void SoftCanvas::FillEllipse(const RECT& rect, COLORREF fill, COLORREF outline) {
+    RECT inner = {rect.left + 1, rect.top + 1, rect.right - 1, rect.bottom - 1};
+    DrawEllipse(rect, inner, outline, &fill);
+}
+
+void SoftCanvas::StrokeEllipse(const RECT& rect, int penWidth, COLORREF color) {
+    if (penWidth <= 0) return;
+    RECT outer, inner;
+    PenBoxes(rect, penWidth, &outer, &inner);
+    DrawEllipse(outer, inner, color, NULL);
+}
+
+int SoftCanvas::FontSlot(const CanvasFont& font) {
+    const CanvasFont& wanted = font.face.empty() ? deviceFont : font;
+    for (size_t i = 0; i < fonts.size(); i++) {
+        const CanvasFont& f = fonts[i].font;
+        if (f.height == wanted.height && f.weight == wanted.weight && f.italic == wanted.italic &&
+            f.face == wanted.face) {
+            return (int)i;
+        }
+    }
+    SoftFont entry;
+    entry.font = wanted;
+    entry.advances = TextMeasure_Open({wanted.face, wanted.weight, wanted.italic}, metrics);
+    for (int c = 0; c < 128; c++) {
+        wchar_t unit = (wchar_t)c;
+        entry.ascii[c] = TextMeasure_Width(entry.advances, wanted.height, &unit, 1);
+    }
+    fonts.push_back(entry);
+    return (int)fonts.size() - 1;
+}
+
+// Each glyph's advance is rounded to a pixel, as GDI places them
+int SoftCanvas::Advance(int slot, uint32_t codePoint) {
+    SoftFont& font = fonts[slot];
+    if (codePoint < 128) return font.ascii[codePoint];
+    wchar_t units[2];
+    size_t length = 1;
+    if (codePoint >= 0x10000) {
+        units[0] = (wchar_t)(0xD800 + ((codePoint - 0x10000) >> 10));
+        units[1] = (wchar_t)(0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+        length = 2;
+    } else {
+        units[0] = (wchar_t)codePoint;
+    }
+    return TextMeasure_Width(font.advances, font.font.height, units, length);
+}
+
+const AtlasGlyph* SoftCanvas::Glyph(int slot, uint32_t codePoint) {
+    uint64_t key = (uint64_t)slot << 32 | codePoint;
+    std::unordered_map<uint64_t, AtlasGlyph>::const_iterator it = atlas.glyphs.find(key);
+    if (it != atlas.glyphs.end()) return &it->second;
+
+    const SoftFont& font = fonts[slot];
+    GlyphBitmap bitmap;
+    AtlasGlyph glyph = {0, 0, 0, 0, 0, 0};
+    if (rasterizer->Rasterize({font.font.face, font.font.weight, font.font.italic}, font.font.height, codePoint,
+                              &bitmap) && bitmap.width <= GlyphAtlas::WIDTH && bitmap.height <= GlyphAtlas::MAX_HEIGHT) {
+        if (atlas.shelfX + bitmap.width > GlyphAtlas::WIDTH) {
+            atlas.shelfY += atlas.shelfHeight;
+            atlas.shelfX = 0;
+            atlas.shelfHeight = 0;
+        }
+        if (atlas.shelfY + bitmap.height > GlyphAtlas::MAX_HEIGHT) {
+            // Full: start over with the glyphs in use now
+            atlas.glyphs.clear();
+            atlas.shelfX = atlas.shelfY = atlas.shelfHeight = 0;
+        }
+        size_t rows = (size_t)atlas.shelfY + bitmap.height;
+        if (atlas.pixels.size() < rows * GlyphAtlas::WIDTH) atlas.pixels.resize(rows * GlyphAtlas::WIDTH, 0);
+        glyph = {atlas.shelfX, atlas.shelfY, bitmap.width, bitmap.height, bitmap.left, bitmap.top};
+        for (int y = 0; y < bitmap.height; y++) {
+            memcpy(&atlas.pixels[(size_t)(glyph.y + y) * GlyphAtlas::WIDTH + glyph.x],
+                   &bitmap.coverage[(size_t)y * bitmap.width], bitmap.width);
+        }
+        atlas.shelfX += bitmap.width;
+        atlas.shelfHeight = std::max(atlas.shelfHeight, bitmap.height);
+    }
+    return &(atlas.glyphs[key] = glyph);
+}
+
+void SoftCanvas::Text(const CanvasFont& font, COLORREF color, int x, int y, const wchar_t* text, size_t length,
+                      const RECT* textClip) {
+    if (!text) return;
+    int slot = FontSlot(font);
+    RECT bounds = textClip ? Intersect(*textClip, clip) : clip;
+    int penX = x;
+    for (size_t i = 0; i < length && penX < bounds.right;) {
+        uint32_t c = (uint16_t)text[i++];
+        if (c >= 0xD800 && c <= 0xDBFF && i < length && text[i] >= 0xDC00 && text[i] <= 0xDFFF) {
+            c = 0x10000 + ((c - 0xD800) << 10) + ((uint16_t)text[i++] - 0xDC00);
+        }
+        int advance = Advance(slot, c);
+        if (c > 32) {
+            const AtlasGlyph* glyph = Glyph(slot, c);
+            int gx = penX + glyph->left, gy = y + glyph->top;
+            int x0 = std::max<int>(gx, bounds.left), x1 = std::min<int>(gx + glyph->width, bounds.right);
+            int y0 = std::max<int>(gy, bounds.top), y1 = std::min<int>(gy + glyph->height, bounds.bottom);
+            for (int row = y0; x1 > x0 && row < y1; row++) {
+                const uint8_t* coverage =
+                    &atlas.pixels[(size_t)(glyph->y + row - gy) * GlyphAtlas::WIDTH + glyph->x + (x0 - gx)];
+                BlendSpan(&pixels[(size_t)row * width + x0], coverage, x1 - x0, color);
+            }
+        }
+        penX += advance;
+    }
+}
+
+int SoftCanvas::TextWidth(const CanvasFont& font, const wchar_t* text, size_t length) {
+    if (!text) return 0;
+    int slot = FontSlot(font);
+    int sum = 0;
+    for (size_t i = 0; i < length;) {
+        uint32_t c = (uint16_t)text[i++];
+        if (c >= 0xD800 && c <= 0xDBFF && i < length && text[i] >= 0xDC00 && text[i] <= 0xDFFF) {
+            c = 0x10000 + ((c - 0xD800) << 10) + ((uint16_t)text[i++] - 0xDC00);
+        }
+        sum += Advance(slot, c);
+    }
+    return sum;
+}
+
+// As DrawText: lines break at '\n' unless DT_SINGLELINE, and DT_VCENTER
+// and DT_BOTTOM only apply to a single line
+void SoftCanvas::TextInRect(const CanvasFont& font, COLORREF color, const RECT& rect, const wchar_t* text, int length,
+                            UINT format) {
+    if (!text) return;
+    size_t total = length < 0 ? wcslen(text) : (size_t)length;
+    int lineHeight = font.face.empty() ? deviceFont.height : font.height;
+    int y = rect.top;
+    if (format & DT_SINGLELINE) {
+        if (format & DT_VCENTER) {
+            y = rect.top + (rect.bottom - rect.top - lineHeight) / 2;
+        } else if (format & DT_BOTTOM) {
+            y = rect.bottom - lineHeight;
+        }
+    }
+    size_t start = 0;
+    while (start <= total) {
+        size_t end = total;
+        if (!(format & DT_SINGLELINE)) {
+            const wchar_t* newline = std::find(text + start, text + total, L'\n');
+            end = (size_t)(newline - text);
+        }
+        size_t drawn = end;
+        if (drawn > start && text[drawn - 1] == L'\r') drawn--;
+        int lineWidth = TextWidth(font, text + start, drawn - start);
+        int x = rect.left;
+        if (format & DT_CENTER) {
+            x = rect.left + (rect.right - rect.left - lineWidth) / 2;
+        } else if (format & DT_RIGHT) {
+            x = rect.right - lineWidth;
+        }
+        Text(font, color, x, y, text + start, drawn - start, &rect);
+        y += lineHeight;
+        start = end + 1;
+    }
+}
+
+GlyphMeasurer* SoftCanvas::Measurer(const CanvasFont& font) {
+    measurer.slot = FontSlot(font);
+    return &measurer;
+}
@@ -0,0 +1,108 @@
+#ifndef SOFTCANVAS_H
+#define SOFTCANVAS_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "canvas.h"
+#include "glyphraster.h"
+#include "textmeasure.h"
+
+// Where a glyph sits in the atlas and how it is placed against the pen
+struct AtlasGlyph {
+    int x, y;            // in the atlas
+    int width, height;
+    int left, top;       // as GlyphBitmap
+};
+
+// Coverage of every glyph drawn so far, packed in shelves of one 8 bit
+// image, so each glyph is rasterized once per font and size. Starts over
+// when full.
+struct GlyphAtlas {
+    static const int WIDTH = 1024;
+    static const int MAX_HEIGHT = 4096;
+
+    std::vector<uint8_t> pixels;  // WIDTH per row
+    int shelfX, shelfY, shelfHeight;
+    std::unordered_map<uint64_t, AtlasGlyph> glyphs;  // by font slot and code point
+
+    GlyphAtlas() : shelfX(0), shelfY(0), shelfHeight(0) {}
+};
+
+class SoftCanvas;
+
+class SoftCanvasMeasurer : public GlyphMeasurer {
+public:
+    SoftCanvas* canvas;
+    int slot;
+
+    void Measure(wchar_t first, wchar_t last, int* advances) override;
+};
+
+// Rasterizes into memory: no window, no GDI, the same pixels on every
+// platform for the same fonts. Shapes are drawn without antialiasing, as
+// GDI draws them; text is blended from the atlas.
+//
+// Advances come from TextMeasure and glyphs from a GlyphRasterizer. On
+// Linux the defaults need fontmetrics.txt next to the executable and the
+// DejaVu fonts installed.
+class SoftCanvas : public Canvas {
+public:
+    int width;
+    int height;
+    // Bytes R, G, B, A per pixel; as a uint32_t on a little-endian machine,
+    // a COLORREF with 255 in the top byte
+    std::vector<uint32_t> pixels;
+    // Drawn for an empty face; stands in for the System font of a DC
+    CanvasFont deviceFont;
+
+    // NULL for either uses the defaults
+    SoftCanvas(int width, int height, GlyphRasterizer* rasterizer, GlyphSource* metrics);
+
+    void FillRect(const RECT& rect, COLORREF color) override;
+    void StrokeRect(const RECT& rect, int penWidth, COLORREF color) override;
+    void Line(int x0, int y0, int x1, int y1, int penWidth, COLORREF color) override;
+    void FillEllipse(const RECT& rect, COLORREF fill, COLORREF outline) override;
+    void StrokeEllipse(const RECT& rect, int penWidth, COLORREF color) override;
+    void Text(const CanvasFont& font, COLORREF color, int x, int y, const wchar_t* text, size_t length,
+              const RECT* clip) override;
+    void TextInRect(const CanvasFont& font, COLORREF color, const RECT& rect, const wchar_t* text, int length,
+                    UINT format) override;
+    int TextWidth(const CanvasFont& font, const wchar_t* text, size_t length) override;
+    GlyphMeasurer* Measurer(const CanvasFont& font) override;
+    void SetClip(const RECT* rect) override;
+    void SetPaintArea(const RECT* rect) override;
+    bool Visible(const RECT& rect) override;
+    void Scroll(const RECT& rect, int dx, int dy) override;
+
+    // Pixel at (x, y) as a COLORREF
+    COLORREF Pixel(int x, int y) const;
+
+private:
+    friend class SoftCanvasMeasurer;
+
+    struct SoftFont {
+        CanvasFont font;            // with the face filled in
+        FontAdvances* advances;
+        int ascii[128];             // pixel advances at font.height
+    };
+
+    RECT paint;
+    RECT clip;                      // inside 'paint'
+    GlyphRasterizer* rasterizer;
+    GlyphSource* metrics;
+    std::vector<SoftFont> fonts;
+    GlyphAtlas atlas;
+    SoftCanvasMeasurer measurer;
+
+    int FontSlot(const CanvasFont& font);
+    int Advance(int slot, uint32_t codePoint);
+    const AtlasGlyph* Glyph(int slot, uint32_t codePoint);
+    void FillSpan(int y, int x0, int x1, uint32_t pixel);
+    void FillBox(int left, int top, int right, int bottom, COLORREF color);
+    // 'ring' between the ellipses in 'outer' and 'inner', and 'fill', if
+    // given, inside 'inner'
+    void DrawEllipse(const RECT& outer, const RECT& inner, COLORREF ring, const COLORREF* fill);
+};
+
+#endif
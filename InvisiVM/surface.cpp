@@ -0,0 +1,73 @@
+#include <algorithm>
+#include "surface.h"
+
+static bool IsEmpty(const RECT& rect) {
+    return rect.right <= rect.left || rect.bottom <= rect.top;
+}
+
+static RECT Intersect(const RECT& a, const RECT& b) {
+    return {std::max(a.left, b.left), std::max(a.top, b.top), std::min(a.right, b.right),
+            std::min(a.bottom, b.bottom)};
+}
+
+static RECT Offset(const RECT& rect, int dx, int dy) {
+    return {rect.left + dx, rect.top + dy, rect.right + dx, rect.bottom + dy};
+}
+
+// 'area' less 'hole', which lies inside it, as up to four bands
+static void DamageAround(DamageRegion* damage, const RECT& area, const RECT& hole) {
+    Damage_Add(damage, {area.left, area.top, area.right, hole.top});
+    Damage_Add(damage, {area.left, hole.bottom, area.right, area.bottom});
+    Damage_Add(damage, {area.left, hole.top, hole.left, hole.bottom});
+    Damage_Add(damage, {hole.right, hole.top, area.right, hole.bottom});
+}
+
+bool Surface_Resize(Surface* surface, int width, int height) {
+    if (!surface || (width == surface->width && height == surface->height)) return false;
+    surface->width = width;
+    surface->height = height;
+    Damage_Clear(&surface->damage);
+    Surface_Damage(surface, {0, 0, width, height});
+    return true;
+}
+
+void Surface_Damage(Surface* surface, const RECT& rect) {
+    if (!surface) return;
+    Damage_Add(&surface->damage, Intersect(rect, {0, 0, surface->width, surface->height}));
+}
+
+RECT Surface_Scroll(Surface* surface, Canvas* canvas, const RECT& area, const RECT& kept, int dx, int dy) {
+    RECT none = {0, 0, 0, 0};
+    if (!surface || !canvas) return none;
+    RECT bounds = {0, 0, surface->width, surface->height};
+    RECT clippedArea = Intersect(area, bounds);
+    RECT from = Intersect(kept, clippedArea);
+    if (IsEmpty(clippedArea) || (dx == 0 && dy == 0)) return none;
+
+    RECT to = Intersect(Offset(from, dx, dy), from);
+    if (IsEmpty(to)) {
+        Surface_Damage(surface, clippedArea);
+        return none;
+    }
+
+    // Stale pixels move with the rest, so their damage does too
+    std::vector<RECT> stale = surface->damage.rects;
+    canvas->Scroll(from, dx, dy);
+    for (const RECT& rect : stale) {
+        RECT inside = Intersect(rect, from);
+        if (!IsEmpty(inside)) Surface_Damage(surface, Intersect(Offset(inside, dx, dy), from));
+    }
+    DamageAround(&surface->damage, clippedArea, to);
+    return to;
+}
+
+void Surface_Paint(Surface* surface, Canvas* canvas, SurfacePainter* painter, DamageRegion* drawn) {
+    if (!surface || !canvas || !painter) return;
+    for (const RECT& rect : surface->damage.rects) {
+        canvas->SetPaintArea(&rect);
+        painter->Draw(canvas);
+        Damage_Add(drawn, rect);
+    }
+    canvas->SetPaintArea(NULL);
+    Damage_Clear(&surface->damage);
+}
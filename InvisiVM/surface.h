@@ -0,0 +1,43 @@
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include "canvas.h"
+#include "damage.h"
+
+// Draws a whole frame; Surface_Paint calls it once per damaged rectangle
+// with the canvas limited to it
+class SurfacePainter {
+public:
+    virtual ~SurfacePainter() {}
+    virtual void Draw(Canvas* canvas) = 0;
+};
+
+// A window's back buffer, kept from one paint to the next. It only needs
+// reallocating when the window changes size, and a scroll moves the pixels
+// already in it so only what comes into view is drawn.
+//
+// The pixels are the canvas's, a bitmap through GdiCanvas on Windows or a
+// SoftCanvas; the surface tracks which of them are stale.
+struct Surface {
+    int width;
+    int height;
+    DamageRegion damage;  // stale, to be drawn before they are shown
+
+    Surface() : width(0), height(0) {}
+};
+
+// True if the size changed, in which case the pixels must be allocated
+// again and all of them are damaged
+bool Surface_Resize(Surface* surface, int width, int height);
+void Surface_Damage(Surface* surface, const RECT& rect);
+// Moves what is drawn in 'area' by (dx, dy). Only 'kept', the part of
+// 'area' whose pixels go with the content, is moved; the rest of 'area'
+// the move leaves stale is damaged, and so is any damage already in
+// 'kept', where it lands. Returns the rectangle the pixels moved to,
+// empty if none did, for moving the window's own pixels to match.
+RECT Surface_Scroll(Surface* surface, Canvas* canvas, const RECT& area, const RECT& kept, int dx, int dy);
+// Draws the damage and clears it. What was drawn is added to 'drawn', if
+// given, to be copied to the window.
+void Surface_Paint(Surface* surface, Canvas* canvas, SurfacePainter* painter, DamageRegion* drawn);
+
+#endif
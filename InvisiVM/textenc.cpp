@@ -0,0 +1,275 @@
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTENC_SSE2 1
+#endif
+#if defined(TEXTENC_SSE2) && defined(__GNUC__)
+#include <immintrin.h>
+#define TEXTENC_AVX2 1
+#endif
+#include "textenc.h"
+
+// How much of a BOM-less file is checked before settling on UTF-8
+static const size_t SNIFF_BYTES = 1 << 20;
+
+static size_t AsciiRunScalar(const unsigned char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && p[i] < 0x80) i++;
+    return i;
+}
+
+#ifdef TEXTENC_SSE2
+static size_t AsciiRunSSE2(const unsigned char* p, size_t n) {
+    size_t i = 0;
+    while (i + 16 <= n) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(p + i));
+        if (_mm_movemask_epi8(block) != 0) break;
+        i += 16;
+    }
+    return i + AsciiRunScalar(p + i, n - i);
+}
+#endif
+
+#ifdef TEXTENC_AVX2
+__attribute__((target("avx2")))
+static size_t AsciiRunAVX2(const unsigned char* p, size_t n) {
+    size_t i = 0;
+    while (i + 32 <= n) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(p + i));
+        if (_mm256_movemask_epi8(block) != 0) break;
+        i += 32;
+    }
+    return i + AsciiRunSSE2(p + i, n - i);
+}
+#endif
+
+// Length of the all-ASCII prefix, using the widest vectors the CPU has
+typedef size_t (*AsciiRunFn)(const unsigned char*, size_t);
+
+static AsciiRunFn PickAsciiRun() {
+#ifdef TEXTENC_AVX2
+    __builtin_cpu_init();  // runs before main, ahead of libgcc's own setup
+    if (__builtin_cpu_supports("avx2")) return AsciiRunAVX2;
+#endif
+#ifdef TEXTENC_SSE2
+    return AsciiRunSSE2;
+#else
+    return AsciiRunScalar;
+#endif
+}
+
+static const AsciiRunFn AsciiRun = PickAsciiRun();
+
+// Decodes one multi-byte sequence. Returns its length, 0 if it is invalid,
+// or -1 if it is valid so far but cut off at 'n'.
+static int DecodeSequence(const unsigned char* p, size_t n, uint32_t* codepoint) {
+    unsigned char lead = p[0];
+    int length;
+    uint32_t cp, min;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2; cp = lead & 0x1F; min = 0x80;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3; cp = lead & 0x0F; min = 0x800;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4; cp = lead & 0x07; min = 0x10000;
+    } else {
+        return 0;
+    }
+
+    for (int i = 1; i < length; i++) {
+        if ((size_t)i >= n) return -1;
+        if ((p[i] & 0xC0) != 0x80) return 0;
+        cp = (cp << 6) | (p[i] & 0x3F);
+        // Reject overlong forms, surrogates and values past U+10FFFF as soon
+        // as the second byte decides them, so a cut-off sequence is judged
+        // the same way as a complete one
+        if (i == 1) {
+            if (length == 3 && ((lead == 0xE0 && p[1] < 0xA0) || (lead == 0xED && p[1] >= 0xA0))) return 0;
+            if (length == 4 && ((lead == 0xF0 && p[1] < 0x90) || (lead == 0xF4 && p[1] >= 0x90))) return 0;
+        }
+    }
+    if (cp < min) return 0;
+    *codepoint = cp;
+    return length;
+}
+
+bool TextEnc_IsValidUTF8(const char* data, size_t size, bool allowCutEnd) {
+    const unsigned char* p = (const unsigned char*)data;
+    size_t i = 0;
+    while (i < size) {
+        i += AsciiRun(p + i, size - i);
+        if (i >= size) break;
+        uint32_t cp;
+        int length = DecodeSequence(p + i, size - i, &cp);
+        if (length == -1) return allowCutEnd;
+        if (length == 0) return false;
+        i += length;
+    }
+    return true;
+}
+
+TextEncoding TextEnc_Detect(const char* data, size_t size, size_t* bomSize) {
+    const unsigned char* p = (const unsigned char*)data;
+    *bomSize = 0;
+    if (size >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF) {
+        *bomSize = 3;
+        return TEXT_UTF8;
+    }
+    if (size >= 2 && p[0] == 0xFF && p[1] == 0xFE) {
+        *bomSize = 2;
+        return TEXT_UTF16LE;
+    }
+    if (size >= 2 && p[0] == 0xFE && p[1] == 0xFF) {
+        *bomSize = 2;
+        return TEXT_UTF16BE;
+    }
+    size_t sniff = size < SNIFF_BYTES ? size : SNIFF_BYTES;
+    return TextEnc_IsValidUTF8(data, sniff, sniff < size) ? TEXT_UTF8 : TEXT_LATIN1;
+}
+
+static void PutWide(uint32_t cp, std::wstring* out) {
+    if (cp >= 0x10000) {
+        cp -= 0x10000;
+        out->push_back((wchar_t)(0xD800 + (cp >> 10)));
+        out->push_back((wchar_t)(0xDC00 + (cp & 0x3FF)));
+    } else {
+        out->push_back((wchar_t)cp);
+    }
+}
+
+// Zero-extends 'n' bytes into the end of 'out'
+static void WidenBytes(const unsigned char* p, size_t n, std::wstring* out) {
+    size_t start = out->size();
+    out->resize(start + n);
+    wchar_t* dst = &(*out)[start];
+    size_t i = 0;
+#if defined(TEXTENC_SSE2) && WCHAR_MAX <= 0xFFFF
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(p + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(block, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(block, zero));
+    }
+#endif
+    for (; i < n; i++) dst[i] = (wchar_t)p[i];
+}
+
+void TextEnc_ToWide(const char* data, size_t size, TextEncoding encoding, std::wstring* out) {
+    if (!data || !out) return;
+    const unsigned char* p = (const unsigned char*)data;
+
+    switch (encoding) {
+        case TEXT_LATIN1:
+            WidenBytes(p, size, out);
+            return;
+
+        case TEXT_UTF16LE:
+        case TEXT_UTF16BE: {
+            bool big = encoding == TEXT_UTF16BE;
+            out->reserve(out->size() + size / 2);
+            for (size_t i = 0; i + 1 < size; i += 2) {
+                out->push_back((wchar_t)(big ? (p[i] << 8) | p[i + 1] : p[i] | (p[i + 1] << 8)));
+            }
+            return;
+        }
+
+        case TEXT_UTF8:
+            break;
+    }
+
+    out->reserve(out->size() + size);
+    size_t i = 0;
+    while (i < size) {
+        size_t run = AsciiRun(p + i, size - i);
+        if (run > 0) {
+            WidenBytes(p + i, run, out);
+            i += run;
+            if (i >= size) break;
+        }
+        uint32_t cp;
+        int length = DecodeSequence(p + i, size - i, &cp);
+        if (length <= 0) {
+            out->push_back((wchar_t)p[i]);
+            i++;
+        } else {
+            PutWide(cp, out);
+            i += length;
+        }
+    }
+}
+
+static void AppendUTF8(uint32_t cp, std::string* out) {
+    if (cp < 0x80) {
+        out->push_back((char)cp);
+    } else if (cp < 0x800) {
+        out->push_back((char)(0xC0 | (cp >> 6)));
+        out->push_back((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out->push_back((char)(0xE0 | (cp >> 12)));
+        out->push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out->push_back((char)(0x80 | (cp & 0x3F)));
+    } else {
+        out->push_back((char)(0xF0 | (cp >> 18)));
+        out->push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+        out->push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out->push_back((char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+void TextEnc_UTF16ToUTF8(const char* data, size_t size, bool bigEndian, std::string* out) {
+    if (!data || !out) return;
+    const unsigned char* p = (const unsigned char*)data;
+    out->reserve(out->size() + size);
+
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        uint32_t cp = bigEndian ? (p[i] << 8) | p[i + 1] : p[i] | (p[i + 1] << 8);
+        if (cp >= 0xD800 && cp <= 0xDBFF && i + 3 < size) {
+            uint32_t low = bigEndian ? (p[i + 2] << 8) | p[i + 3] : p[i + 2] | (p[i + 3] << 8);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+        }
+        if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;  // unpaired surrogate
+
+        AppendUTF8(cp, out);
+    }
+}
+
+void TextEnc_FromWide(const wchar_t* data, size_t size, TextEncoding encoding, std::string* out) {
+    if (!data || !out) return;
+    for (size_t i = 0; i < size; i++) {
+        uint32_t cp = (uint32_t)data[i];
+        if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < size && data[i + 1] >= 0xDC00 && data[i + 1] <= 0xDFFF) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + ((uint32_t)data[i + 1] - 0xDC00);
+            i++;
+        }
+        if (encoding == TEXT_LATIN1) {
+            out->push_back(cp < 0x100 ? (char)cp : '?');
+        } else {
+            AppendUTF8(cp >= 0xD800 && cp <= 0xDFFF ? 0xFFFD : cp, out);
+        }
+    }
+}
+
+const std::wstring& TextEnc_CachedLine(WideLineCache* cache, size_t line, std::string_view bytes,
+                                       TextEncoding encoding) {
+    WideLineCache::Slot& slot = cache->slots[line % WideLineCache::SLOTS];
+    if (!slot.used || slot.line != line || slot.bytes != bytes.size()) {
+        slot.text.clear();
+        TextEnc_ToWide(bytes.data(), bytes.size(), encoding, &slot.text);
+        slot.line = line;
+        slot.bytes = bytes.size();
+        slot.used = true;
+    }
+    return slot.text;
+}
+
+void TextEnc_ClearCache(WideLineCache* cache) {
+    for (size_t i = 0; i < WideLineCache::SLOTS; i++) {
+        cache->slots[i].used = false;
+        cache->slots[i].text.clear();
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef TEXTENC_H
+#define TEXTENC_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+enum TextEncoding {
+    TEXT_UTF8,
+    TEXT_UTF16LE,
+    TEXT_UTF16BE,
+    TEXT_LATIN1
+};
+
+// Looks for a byte order mark, otherwise validates the first megabyte as
+// UTF-8 and calls anything that fails Latin-1. 'bomSize' receives the number
+// of bytes to skip.
+TextEncoding TextEnc_Detect(const char* data, size_t size, size_t* bomSize);
+
+// Single pass; ASCII runs are checked 16 or 32 bytes at a time. With
+// 'allowCutEnd' a sequence cut off by the end of the buffer still passes.
+bool TextEnc_IsValidUTF8(const char* data, size_t size, bool allowCutEnd);
+
+// Appends UTF-16 for TextOutW. In UTF-8 input, bytes that do not form a
+// valid sequence are read as Latin-1 so stray 8-bit text stays legible.
+void TextEnc_ToWide(const char* data, size_t size, TextEncoding encoding, std::wstring* out);
+
+// Appends UTF-8. UTF-16 documents are converted once on open because the
+// line index works on bytes.
+void TextEnc_UTF16ToUTF8(const char* data, size_t size, bool bigEndian, std::string* out);
+
+// Appends typed text in a document's encoding, UTF-8 or Latin-1, so it can
+// be looked for in the document's bytes. Latin-1 gets '?' for what it lacks.
+void TextEnc_FromWide(const wchar_t* data, size_t size, TextEncoding encoding, std::string* out);
+
+// Direct-mapped cache of transcoded lines so redrawing or scrolling by a few
+// lines only converts the lines that came into view
+struct WideLineCache {
+    static const size_t SLOTS = 256;
+
+    struct Slot {
+        size_t line;
+        size_t bytes;  // source length, so a line still growing is redone
+        bool used;
+        std::wstring text;
+
+        Slot() : line(0), bytes(0), used(false) {}
+    };
+
+    Slot slots[SLOTS];
+};
+
+const std::wstring& TextEnc_CachedLine(WideLineCache* cache, size_t line, std::string_view bytes,
+                                       TextEncoding encoding);
+void TextEnc_ClearCache(WideLineCache* cache);
+
+#endif
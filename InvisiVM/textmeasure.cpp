@@ -0,0 +1,313 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#include <memory>
+#include <vector>
+#include "textmeasure.h"
+
+// Marks a code point queued for measuring in FontAdvances::others
+static const int PENDING = -1;
+
+// One face from a metrics file, in font units
+struct MetricsFace {
+    std::wstring face;
+    int weight;
+    int cell;
+    int defaultAdvance;
+    std::unordered_map<uint32_t, int> advances;
+};
+
+static bool SameFace(const std::wstring& a, const std::wstring& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (towlower(a[i]) != towlower(b[i])) return false;
+    }
+    return true;
+}
+
+class MetricsFileSource : public GlyphSource {
+public:
+    std::vector<MetricsFace> faces;
+
+    bool Measure(const TextFont& font, const uint32_t* codePoints, size_t count, int* advances) override {
+        const MetricsFace* face = Find(font);
+        if (!face) return false;
+        for (size_t i = 0; i < count; i++) {
+            std::unordered_map<uint32_t, int>::const_iterator it = face->advances.find(codePoints[i]);
+            int units = it != face->advances.end() ? it->second : face->defaultAdvance;
+            advances[i] = (int)(((int64_t)units * TEXTMEASURE_REF_HEIGHT + face->cell / 2) / face->cell);
+        }
+        return true;
+    }
+
+private:
+    // Nearest weight among faces of the requested name, else of the first face
+    const MetricsFace* Find(const TextFont& font) const {
+        if (faces.empty()) return NULL;
+        const std::wstring* name = &faces[0].face;
+        for (size_t i = 0; i < faces.size(); i++) {
+            if (SameFace(faces[i].face, font.face)) {
+                name = &faces[i].face;
+                break;
+            }
+        }
+        const MetricsFace* best = NULL;
+        for (size_t i = 0; i < faces.size(); i++) {
+            if (faces[i].face != *name) continue;
+            if (!best || abs(faces[i].weight - font.weight) < abs(best->weight - font.weight)) best = &faces[i];
+        }
+        return best;
+    }
+};
+
+// "font", "weight", "cell" and "default" lines open and describe a face;
+// the rest are a hex code point followed by advances for it and the code
+// points after it
+static bool LoadMetrics(const char* path, MetricsFileSource* source) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0') continue;
+        if (strncmp(line, "font ", 5) == 0) {
+            MetricsFace face;
+            for (const char* p = line + 5; *p; p++) face.face.push_back((wchar_t)(unsigned char)*p);
+            face.weight = 400;
+            face.cell = 0;
+            face.defaultAdvance = 0;
+            source->faces.push_back(face);
+            continue;
+        }
+        if (source->faces.empty()) continue;
+        MetricsFace& face = source->faces.back();
+        if (strncmp(line, "weight ", 7) == 0) {
+            face.weight = atoi(line + 7);
+        } else if (strncmp(line, "cell ", 5) == 0) {
+            face.cell = atoi(line + 5);
+        } else if (strncmp(line, "default ", 8) == 0) {
+            face.defaultAdvance = atoi(line + 8);
+        } else {
+            char* p;
+            uint32_t c = (uint32_t)strtoul(line, &p, 16);
+            while (*p) {
+                char* end;
+                long units = strtol(p, &end, 10);
+                if (end == p) break;
+                if (units > 0) face.advances[c] = (int)units;
+                c++;
+                p = end;
+            }
+        }
+    }
+    fclose(file);
+
+    // A face without a cell height cannot be scaled
+    source->faces.erase(std::remove_if(source->faces.begin(), source->faces.end(),
+                                       [](const MetricsFace& face) { return face.cell <= 0; }),
+                        source->faces.end());
+    return !source->faces.empty();
+}
+
+#ifdef _WIN32
+// Measures with a private memory DC, never one being painted on
+class GdiSource : public GlyphSource {
+public:
+    bool Measure(const TextFont& font, const uint32_t* codePoints, size_t count, int* advances) override {
+        HDC hdc = CreateCompatibleDC(NULL);
+        if (!hdc) return false;
+        HFONT hFont = CreateFontW(TEXTMEASURE_REF_HEIGHT, 0, 0, 0, font.weight, font.italic, FALSE, FALSE,
+                                  DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY,
+                                  DEFAULT_PITCH | FF_DONTCARE, font.face.c_str());
+        if (!hFont) {
+            DeleteDC(hdc);
+            return false;
+        }
+        HGDIOBJ oldFont = SelectObject(hdc, hFont);
+        size_t i = 0;
+        while (i < count) {
+            uint32_t first = codePoints[i];
+            if (first >= 0x10000) {
+                // Outside the BMP only a string measure will do
+                wchar_t pair[2] = {(wchar_t)(0xD800 + ((first - 0x10000) >> 10)),
+                                   (wchar_t)(0xDC00 + ((first - 0x10000) & 0x3FF))};
+                SIZE size = {0, 0};
+                GetTextExtentPoint32W(hdc, pair, 2, &size);
+                advances[i++] = size.cx;
+                continue;
+            }
+            // Consecutive code points go in one call
+            size_t run = 1;
+            while (i + run < count && codePoints[i + run] == first + run && first + run < 0x10000) run++;
+            if (!GetCharWidth32W(hdc, first, (UINT)(first + run - 1), advances + i)) {
+                std::fill(advances + i, advances + i + run, 0);
+            }
+            i += run;
+        }
+        SelectObject(hdc, oldFont);
+        DeleteObject(hFont);
+        DeleteDC(hdc);
+        return true;
+    }
+};
+#endif
+
+// fontmetrics.txt lives next to the executable, like program.py
+static std::string MetricsPath() {
+#ifdef _WIN32
+    char exePath[MAX_PATH];
+    if (GetModuleFileNameA(NULL, exePath, MAX_PATH) == 0) return "fontmetrics.txt";
+    char* lastSlash = strrchr(exePath, '\\');
+#else
+    char exePath[4096];
+    ssize_t len = readlink("/proc/self/exe", exePath, sizeof(exePath) - 1);
+    if (len <= 0) return "fontmetrics.txt";
+    exePath[len] = '\0';
+    char* lastSlash = strrchr(exePath, '/');
+#endif
+    if (!lastSlash) return "fontmetrics.txt";
+    lastSlash[1] = '\0';
+    return std::string(exePath) + "fontmetrics.txt";
+}
+
+GlyphSource* TextMeasure_MetricsFile(const char* path) {
+    std::unique_ptr<MetricsFileSource> source(new MetricsFileSource());
+    if (!path || !LoadMetrics(path, source.get())) return NULL;
+    return source.release();
+}
+
+GlyphSource* TextMeasure_DefaultSource() {
+#ifdef _WIN32
+    static GdiSource source;
+    return &source;
+#else
+    static GlyphSource* source = TextMeasure_MetricsFile(MetricsPath().c_str());
+    return source;
+#endif
+}
+
+// Code point at text[*i], stepping past it
+static uint32_t NextCodePoint(const wchar_t* text, size_t length, size_t* i) {
+    uint32_t c = (uint16_t)text[(*i)++];
+    if (c >= 0xD800 && c <= 0xDBFF && *i < length) {
+        uint32_t low = (uint16_t)text[*i];
+        if (low >= 0xDC00 && low <= 0xDFFF) {
+            (*i)++;
+            return 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+        }
+    }
+    return c;
+}
+
+// Queues code points of 'text' the font has not measured yet
+static void CollectMissing(FontAdvances* font, const wchar_t* text, size_t length, std::vector<uint32_t>* missing) {
+    for (size_t i = 0; i < length;) {
+        uint32_t c = NextCodePoint(text, length, &i);
+        if (c < 128) continue;
+        if (font->others.emplace(c, PENDING).second) missing->push_back(c);
+    }
+}
+
+static void MeasureMissing(FontAdvances* font, std::vector<uint32_t>* missing) {
+    if (missing->empty()) return;
+    std::sort(missing->begin(), missing->end());
+    std::vector<int> advances(missing->size(), 0);
+    if (!font->source || !font->source->Measure(font->font, missing->data(), missing->size(), advances.data())) {
+        std::fill(advances.begin(), advances.end(), 0);
+    }
+    for (size_t i = 0; i < missing->size(); i++) font->others[(*missing)[i]] = advances[i];
+    missing->clear();
+}
+
+// Advance of the whole text at the reference height. Every code point must
+// have been measured.
+static int64_t ReferenceWidth(const FontAdvances* font, const wchar_t* text, size_t length) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < length;) {
+        wchar_t unit = text[i];
+        if (unit < 128) {
+            sum += font->ascii[unit];
+            i++;
+            continue;
+        }
+        uint32_t c = NextCodePoint(text, length, &i);
+        std::unordered_map<uint32_t, int>::const_iterator it = font->others.find(c);
+        if (it != font->others.end()) sum += it->second;
+    }
+    return sum;
+}
+
+static int Scale(int64_t reference, int height) {
+    return (int)((reference * height + TEXTMEASURE_REF_HEIGHT / 2) / TEXTMEASURE_REF_HEIGHT);
+}
+
+struct FontCacheEntry {
+    GlyphSource* source;
+    std::unique_ptr<FontAdvances> advances;
+};
+
+static std::vector<FontCacheEntry> g_fonts;
+
+FontAdvances* TextMeasure_Open(const TextFont& font, GlyphSource* source) {
+    if (!source) source = TextMeasure_DefaultSource();
+    for (size_t i = 0; i < g_fonts.size(); i++) {
+        const TextFont& cached = g_fonts[i].advances->font;
+        if (g_fonts[i].source == source && cached.weight == font.weight && cached.italic == font.italic &&
+            cached.face == font.face) {
+            return g_fonts[i].advances.get();
+        }
+    }
+
+    FontCacheEntry entry;
+    entry.source = source;
+    entry.advances.reset(new FontAdvances());
+    FontAdvances* advances = entry.advances.get();
+    advances->font = font;
+    advances->source = source;
+    uint32_t ascii[128];
+    for (uint32_t c = 0; c < 128; c++) ascii[c] = c;
+    if (!source || !source->Measure(font, ascii, 128, advances->ascii)) {
+        std::fill(advances->ascii, advances->ascii + 128, 0);
+    }
+    g_fonts.push_back(std::move(entry));
+    return advances;
+}
+
+int TextMeasure_Width(FontAdvances* font, int height, const wchar_t* text, size_t length) {
+    if (!font || !text) return 0;
+    std::vector<uint32_t> missing;
+    CollectMissing(font, text, length, &missing);
+    MeasureMissing(font, &missing);
+    return Scale(ReferenceWidth(font, text, length), height);
+}
+
+void TextMeasure_Widths(FontAdvances* font, int height, const std::wstring* texts, size_t count, int* widths) {
+    if (!font || !texts || !widths) return;
+    std::vector<uint32_t> missing;
+    for (size_t i = 0; i < count; i++) CollectMissing(font, texts[i].data(), texts[i].size(), &missing);
+    MeasureMissing(font, &missing);
+    for (size_t i = 0; i < count; i++) widths[i] = Scale(ReferenceWidth(font, texts[i].data(), texts[i].size()), height);
+}
+
+int TextMeasure_FitHeight(FontAdvances* font, const wchar_t* text, size_t length, int width, int minHeight,
+                          int maxHeight) {
+    if (!font || !text || maxHeight <= minHeight) return minHeight;
+    std::vector<uint32_t> missing;
+    CollectMissing(font, text, length, &missing);
+    MeasureMissing(font, &missing);
+    int64_t reference = ReferenceWidth(font, text, length);
+    if (reference <= 0) return maxHeight;
+
+    // Width grows with height, so solve for it and settle the rounding
+    int64_t guess = ((int64_t)width * TEXTMEASURE_REF_HEIGHT + TEXTMEASURE_REF_HEIGHT / 2) / reference;
+    int height = (int)std::max<int64_t>(minHeight, std::min<int64_t>(maxHeight, guess + 1));
+    while (height > minHeight && Scale(reference, height) > width) height--;
+    return height;
+}
@@ -0,0 +1,63 @@
+#ifndef TEXTMEASURE_H
+#define TEXTMEASURE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// String widths from cached glyph advances, so layout code can measure
+// without a device context and without creating a font for every size it
+// tries. Advances are kept per face, weight and slant at one reference
+// height and scaled, which lands within a pixel or two of GDI's hinted
+// widths for display text.
+//
+// Not thread safe; meant for the UI thread.
+struct TextFont {
+    std::wstring face;
+    int weight;   // FW_NORMAL, FW_BOLD, ...
+    bool italic;
+};
+
+// Sources measure at this height, in pixels of cell height as a positive
+// CreateFont height means it
+const int TEXTMEASURE_REF_HEIGHT = 1024;
+
+// Where advances come from
+class GlyphSource {
+public:
+    virtual ~GlyphSource() {}
+    // Advances of 'count' code points at TEXTMEASURE_REF_HEIGHT. False if
+    // nothing could be measured.
+    virtual bool Measure(const TextFont& font, const uint32_t* codePoints, size_t count, int* advances) = 0;
+};
+
+struct FontAdvances {
+    TextFont font;
+    GlyphSource* source;
+    int ascii[128];                            // measured when the font is opened
+    std::unordered_map<uint32_t, int> others;  // measured as they turn up
+};
+
+// GDI on Windows; elsewhere the metrics file next to the executable,
+// fontmetrics.txt. Lives for the rest of the run.
+GlyphSource* TextMeasure_DefaultSource();
+// A source reading a metrics file laid out like fontmetrics.txt. Faces the
+// file lacks get its first face at the nearest weight. NULL if the file
+// cannot be read; lives for the rest of the run.
+GlyphSource* TextMeasure_MetricsFile(const char* path);
+
+// Cached advances for 'font' from 'source', or the default source if NULL.
+// Lives for the rest of the run.
+FontAdvances* TextMeasure_Open(const TextFont& font, GlyphSource* source);
+// Width in pixels of 'text' in the font 'height' pixels high
+int TextMeasure_Width(FontAdvances* font, int height, const wchar_t* text, size_t length);
+// Widths of many strings. Code points not seen before are measured in a
+// single call to the source.
+void TextMeasure_Widths(FontAdvances* font, int height, const std::wstring* texts, size_t count, int* widths);
+// Largest height in [minHeight, maxHeight] at which 'text' is no wider
+// than 'width'; minHeight if none is
+int TextMeasure_FitHeight(FontAdvances* font, const wchar_t* text, size_t length, int width, int minHeight,
+                          int maxHeight);
+
+#endif
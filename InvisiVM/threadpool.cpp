@@ -0,0 +1,105 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "threadpool.h"
+
+typedef std::function<void(int)> Task;
+
+struct WorkQueue {
+    std::mutex lock;
+    std::deque<Task> tasks;
+};
+
+struct ThreadPool {
+    std::once_flag started;
+    std::vector<WorkQueue*> queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> pending;  // queued, not yet taken
+    std::atomic<unsigned> nextQueue;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    bool stopping;
+
+    ThreadPool() : pending(0), nextQueue(0), stopping(false) {}
+};
+
+static ThreadPool g_pool;
+
+static bool TakeOwn(int worker, Task* task) {
+    WorkQueue* queue = g_pool.queues[worker];
+    std::lock_guard<std::mutex> guard(queue->lock);
+    if (queue->tasks.empty()) return false;
+    *task = std::move(queue->tasks.front());
+    queue->tasks.pop_front();
+    return true;
+}
+
+static bool Steal(int worker, Task* task) {
+    size_t count = g_pool.queues.size();
+    for (size_t i = 1; i < count; i++) {
+        WorkQueue* queue = g_pool.queues[(worker + i) % count];
+        std::lock_guard<std::mutex> guard(queue->lock);
+        if (queue->tasks.empty()) continue;
+        *task = std::move(queue->tasks.back());
+        queue->tasks.pop_back();
+        return true;
+    }
+    return false;
+}
+
+static void WorkerLoop(int worker) {
+    for (;;) {
+        Task task;
+        if (TakeOwn(worker, &task) || Steal(worker, &task)) {
+            g_pool.pending--;
+            task(worker);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(g_pool.sleepLock);
+        g_pool.wake.wait(guard, []() { return g_pool.stopping || g_pool.pending > 0; });
+        if (g_pool.stopping && g_pool.pending == 0) return;
+    }
+}
+
+static void Start() {
+    unsigned cores = std::thread::hardware_concurrency();
+    int count = cores > 0 ? (int)cores : 1;
+    for (int i = 0; i < count; i++) g_pool.queues.push_back(new WorkQueue());
+    for (int i = 0; i < count; i++) g_pool.threads.push_back(std::thread(WorkerLoop, i));
+}
+
+void ThreadPool_Submit(const std::function<void(int worker)>& task) {
+    std::call_once(g_pool.started, Start);
+
+    // Counted first so a worker that takes it early never sees it go negative
+    g_pool.pending++;
+    WorkQueue* queue = g_pool.queues[g_pool.nextQueue++ % g_pool.queues.size()];
+    {
+        std::lock_guard<std::mutex> guard(queue->lock);
+        queue->tasks.push_back(task);
+    }
+    {
+        // Taking the lock orders this against a worker about to sleep
+        std::lock_guard<std::mutex> guard(g_pool.sleepLock);
+    }
+    g_pool.wake.notify_one();
+}
+
+int ThreadPool_Size() {
+    std::call_once(g_pool.started, Start);
+    return (int)g_pool.queues.size();
+}
+
+void ThreadPool_Shutdown() {
+    {
+        std::lock_guard<std::mutex> guard(g_pool.sleepLock);
+        g_pool.stopping = true;
+    }
+    g_pool.wake.notify_all();
+    for (size_t i = 0; i < g_pool.threads.size(); i++) g_pool.threads[i].join();
+    g_pool.threads.clear();
+}
@@ -0,0 +1,38 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+// Process-wide pool with one worker per core, started on first use. Each
+// worker has its own queue and tasks are dealt to them in turn. A worker
+// runs its own tasks oldest first, so work comes out roughly in submission
+// order, and steals the newest task from a busy neighbour when it runs dry.
+// 'worker' is the index of the thread running the task, for per-thread state.
+void ThreadPool_Submit(const std::function<void(int worker)>& task);
+int ThreadPool_Size();
+// Runs what is queued, then joins the workers
+void ThreadPool_Shutdown();
+
+// Waits for a batch of pool tasks. Never wait from inside a pool task; the
+// tasks waited for could be queued behind it.
+struct TaskLatch {
+    std::mutex lock;
+    std::condition_variable done;
+    size_t pending;
+
+    explicit TaskLatch(size_t count) : pending(count) {}
+
+    void Finish() {
+        std::lock_guard<std::mutex> guard(lock);
+        if (--pending == 0) done.notify_all();
+    }
+
+    void Wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [this]() { return pending == 0; });
+    }
+};
+
+#endif
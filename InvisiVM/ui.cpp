@@ -18,18 +18,17 @@ HWND CreatePDFViewerWindow(HINSTANCE hInstance, const char* pdfPath, const char*
 
 // File type information
 struct FileTypeInfo {
-    const wchar_t* label;
     const char* extension;
     const char* filter;
 };
 
 static const FileTypeInfo fileTypeInfos[FILE_COUNT] = {
-    {L"PDF Files", "pdf", "PDF Files\0*.pdf\0All Files\0*.*\0"},
-    {L"Text Files", "txt", "Text Files\0*.txt\0All Files\0*.*\0"},
-    {L"CSV Files", "csv", "CSV Files\0*.csv\0All Files\0*.*\0"},
-    {L"Word Documents", "docx", "Word Documents\0*.docx\0All Files\0*.*\0"},
-    {L"Excel Files", "xlsx", "Excel Spreadsheets\0*.xlsx\0All Files\0*.*\0"},
-    {L"Open Application", "exe", "Applications\0*.exe\0All Files\0*.*\0"}
+    {"pdf", "PDF Files\0*.pdf\0All Files\0*.*\0"},
+    {"txt", "Text Files\0*.txt\0All Files\0*.*\0"},
+    {"csv", "CSV Files\0*.csv\0All Files\0*.*\0"},
+    {"docx", "Word Documents\0*.docx\0All Files\0*.*\0"},
+    {"xlsx", "Excel Spreadsheets\0*.xlsx\0All Files\0*.*\0"},
+    {"exe", "Applications\0*.exe\0All Files\0*.*\0"}
 };
 
 void UI_Initialize(UIState* state) {
@@ -207,293 +206,7 @@ void UI_UpdateIntroAnimation(HWND hwnd, UIState* state) {
     UpdateWindow(hwnd);
 }
 
-static void DrawTextWithGlow(HDC hdc, const wchar_t* text, int x, int y, HFONT hFont,
-                             SIZE textSize, int textColor, float glowPos) {
-    HFONT oldFont = (HFONT)SelectObject(hdc, hFont);
-    
-    SetTextColor(hdc, RGB(textColor, textColor, textColor));
-    TextOutW(hdc, x, y, text, (int)wcslen(text));
-    
-    int glowX = x + (int)(textSize.cx * glowPos);
-    int glowRadius = 40;
-    
-    for (int offset = -glowRadius; offset <= glowRadius; offset += 1) {
-        int currentX = glowX + offset;
-        if (currentX < x || currentX > x + textSize.cx) continue;
-        
-        float distance = abs(offset) / (float)glowRadius;
-        int intensity = (int)(200 * (1.0f - distance));
-        intensity = std::min(intensity, 255);
-        
-        if (intensity > 0) {
-            int r = (int)(intensity * (1.2f + 0.3f * glowPos));
-            int g = (int)(intensity * 0.5f);
-            int b = (int)(intensity * (1.2f - 0.3f * glowPos));
-            
-            SetTextColor(hdc, RGB(
-                std::min(255, textColor + r),
-                std::min(255, textColor + g),
-                std::min(255, textColor + b)
-            ));
-            
-            RECT clipRect = {currentX - 1, y, currentX + 1, y + textSize.cy};
-            ExtTextOutW(hdc, x, y, ETO_CLIPPED, &clipRect, text, (int)wcslen(text), NULL);
-        }
-    }
-    
-    SelectObject(hdc, oldFont);
-}
-
-void UI_DrawIntroSequence(HDC hdc, const RECT& clientRect, UIState* state) {
-    if (!state) return;
-    
-    HBRUSH whiteBrush = CreateSolidBrush(RGB(255, 255, 255));
-    FillRect(hdc, &clientRect, whiteBrush);
-    DeleteObject(whiteBrush);
-
-    SetBkMode(hdc, TRANSPARENT);
-
-    const wchar_t* text = (state->introState >= INTRO_WELCOME_IN) ? L"Welcome" : L"Loading...";
-
-    int availableWidth = (state->introState >= INTRO_WELCOME_IN)
-                         ? (int)(clientRect.right * 0.50)
-                         : (int)(clientRect.right * 0.30);
-
-    int fontSize = 100;
-    HFONT hFont = NULL;
-    SIZE textSize;
-
-    const wchar_t* fontName = L"Segoe Script";
-    int fontWeight = FW_BOLD;
-
-    do {
-        if (hFont) DeleteObject(hFont);
-
-        hFont = CreateFont(fontSize, 0, 0, 0, fontWeight,
-                          (state->introState < INTRO_WELCOME_IN) ? TRUE : FALSE,
-                          FALSE, FALSE,
-                          DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
-                          ANTIALIASED_QUALITY,
-                          DEFAULT_PITCH | FF_DONTCARE, fontName);
-
-        if (!hFont) return;
-
-        HFONT oldFont = (HFONT)SelectObject(hdc, hFont);
-        GetTextExtentPoint32W(hdc, text, (int)wcslen(text), &textSize);
-        SelectObject(hdc, oldFont);
-
-        if (textSize.cx <= availableWidth) break;
-        fontSize -= 2;
-
-    } while (fontSize > 10);
-
-    if (state->introState == INTRO_WELCOME_GROW) {
-        float growthFactor = 1.0f + ((state->welcomeSize - 30) / 50.0f) * 0.5f;
-        int grownSize = (int)(fontSize * growthFactor + 0.01f);
-
-        DeleteObject(hFont);
-        hFont = CreateFont(grownSize, 0, 0, 0, fontWeight, FALSE, FALSE, FALSE,
-                          DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
-                          ANTIALIASED_QUALITY,
-                          DEFAULT_PITCH | FF_DONTCARE, fontName);
-        if (!hFont) return;
-    }
-
-    HFONT oldFont = (HFONT)SelectObject(hdc, hFont);
-    GetTextExtentPoint32W(hdc, text, (int)wcslen(text), &textSize);
-    int x = (clientRect.right - textSize.cx) / 2;
-    int y = (clientRect.bottom - textSize.cy) / 2;
-
-    int alpha = std::max(0, std::min(255, state->introAlpha));
-    int gray = 255 - alpha;
-
-    if ((state->introState == INTRO_WELCOME_IN || state->introState == INTRO_WELCOME_GROW) && state->glowPosition < 1.0f) {
-        DrawTextWithGlow(hdc, text, x, y, hFont, textSize, gray, state->glowPosition);
-    } else {
-        SetTextColor(hdc, RGB(gray, gray, gray));
-        TextOutW(hdc, x, y, text, (int)wcslen(text));
-    }
-
-    SelectObject(hdc, oldFont);
-    DeleteObject(hFont);
-}
-
-void UI_DrawHomeUI(HDC hdc, const RECT& clientRect, UIState* state) {
-    if (!state) return;
-    
-    // Background white area
-    HBRUSH bgBrush = CreateSolidBrush(RGB(255, 255, 255));
-    FillRect(hdc, &clientRect, bgBrush);
-    DeleteObject(bgBrush);
-
-    // Left sidebar (grey)
-    RECT sidebar = clientRect;
-    sidebar.right = sidebar.left + 60;
-    HBRUSH sbBrush = CreateSolidBrush(RGB(210, 210, 210));
-    FillRect(hdc, &sidebar, sbBrush);
-    DeleteObject(sbBrush);
-
-    // Top header rectangle
-    RECT header = clientRect;
-    header.left = sidebar.right;
-    header.bottom = header.top + 90;
-    HBRUSH headerBrush = CreateSolidBrush(RGB(255, 255, 255));
-    FillRect(hdc, &header, headerBrush);
-    DeleteObject(headerBrush);
-
-    // Header text "Welcome To InvisVM"
-    const wchar_t* headerFontName = L"Segoe Script";
-    HFONT hHeaderFont = CreateFont(28, 0, 0, 0, FW_BOLD, TRUE, FALSE, FALSE,
-                                   DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
-                                   ANTIALIASED_QUALITY,
-                                   DEFAULT_PITCH | FF_DONTCARE, headerFontName);
-    HFONT oldF = (HFONT)SelectObject(hdc, hHeaderFont);
-    SetTextColor(hdc, RGB(30, 30, 30));
-    SetBkMode(hdc, TRANSPARENT);
-    RECT hdrTextRect = header;
-    hdrTextRect.left += 12;
-    hdrTextRect.top += 8;
-    DrawTextW(hdc, L"Welcome To\nInvisVM", -1, &hdrTextRect, DT_LEFT | DT_TOP);
-    SelectObject(hdc, oldF);
-    DeleteObject(hHeaderFont);
-
-    // Divider line under header
-    HPEN divPen = CreatePen(PS_SOLID, 3, RGB(0, 0, 0));
-    HPEN oldDiv = (HPEN)SelectObject(hdc, divPen);
-    MoveToEx(hdc, sidebar.right, header.bottom, NULL);
-    LineTo(hdc, clientRect.right, header.bottom);
-    SelectObject(hdc, oldDiv);
-    DeleteObject(divPen);
-
-    // Main content area
-    RECT content = clientRect;
-    content.top = header.bottom + 8;
-    content.left = sidebar.right + 12;
-    content.right -= 12;
-    content.bottom -= BAR_HEIGHT + 10;
-
-    // Label "Select File Type"
-    const wchar_t* labelFontName = L"Segoe UI";
-    HFONT labFont = CreateFont(22, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
-                               DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
-                               ANTIALIASED_QUALITY,
-                               DEFAULT_PITCH | FF_DONTCARE, labelFontName);
-    HFONT oldLabelFont = (HFONT)SelectObject(hdc, labFont);
-    SetTextColor(hdc, RGB(20, 20, 20));
-    RECT lblRect = content;
-    lblRect.top += 10;
-    DrawTextW(hdc, L"Select File Type", -1, &lblRect, DT_LEFT | DT_TOP);
-    SelectObject(hdc, oldLabelFont);
-    DeleteObject(labFont);
-
-    // Draw file type buttons
-    int btnW = 180;
-    int btnH = 36;
-    int btnSpacing = 10;
-    int startY = content.top + 50;
-    
-    for (int i = 0; i < FILE_COUNT; i++) {
-        int btnX = content.left + 10;
-        int btnY = startY + (i * (btnH + btnSpacing));
-        
-        // Shadow
-        RECT shadow = {btnX + 4, btnY + 4, btnX + 4 + btnW, btnY + 4 + btnH};
-        HBRUSH shadowBrush = CreateSolidBrush(RGB(200, 200, 200));
-        FillRect(hdc, &shadow, shadowBrush);
-        DeleteObject(shadowBrush);
-        
-        // Button rect
-        RECT btnRect = {btnX, btnY, btnX + btnW, btnY + btnH};
-        state->fileTypeButtons[i] = btnRect;
-        
-        // Button fill (special color for Application button)
-        HBRUSH btnBrush;
-        if (state->fileButtonPressed[i]) {
-            btnBrush = CreateSolidBrush(RGB(34, 34, 34));
-        } else if (state->fileButtonHovered[i]) {
-            if (i == FILE_APP) {
-                btnBrush = CreateSolidBrush(RGB(220, 240, 255));  // Light blue for app
-            } else {
-                btnBrush = CreateSolidBrush(RGB(240, 240, 240));
-            }
-        } else {
-            if (i == FILE_APP) {
-                btnBrush = CreateSolidBrush(RGB(230, 245, 255));  // Slightly blue tint
-            } else {
-                btnBrush = CreateSolidBrush(RGB(245, 245, 245));
-            }
-        }
-        FillRect(hdc, &btnRect, btnBrush);
-        DeleteObject(btnBrush);
-        
-        // Button border
-        HPEN borderPen = CreatePen(PS_SOLID, 2, RGB(0, 0, 0));
-        HPEN oldBorder = (HPEN)SelectObject(hdc, borderPen);
-        SelectObject(hdc, GetStockObject(NULL_BRUSH));
-        Rectangle(hdc, btnRect.left, btnRect.top, btnRect.right, btnRect.bottom);
-        SelectObject(hdc, oldBorder);
-        DeleteObject(borderPen);
-        
-        // Button label
-        HFONT btnFont = CreateFont(15, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
-                                   DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
-                                   ANTIALIASED_QUALITY,
-                                   DEFAULT_PITCH | FF_DONTCARE, L"Segoe UI");
-        HFONT oldBtnF = (HFONT)SelectObject(hdc, btnFont);
-        SetTextColor(hdc, RGB(20, 20, 20));
-        SetBkMode(hdc, TRANSPARENT);
-        DrawTextW(hdc, fileTypeInfos[i].label, -1, &btnRect, DT_CENTER | DT_VCENTER | DT_SINGLELINE);
-        SelectObject(hdc, oldBtnF);
-        DeleteObject(btnFont);
-    }
-
-    // Bottom bar (grey background)
-    RECT bottomBarRect = clientRect;
-    bottomBarRect.top = clientRect.bottom - BAR_HEIGHT;
-    HBRUSH greyBrush = CreateSolidBrush(RGB(60, 60, 60));
-    FillRect(hdc, &bottomBarRect, greyBrush);
-    DeleteObject(greyBrush);
-
-    // Draw the circular buttons on the bottom bar
-    for (const auto& button : state->buttons) {
-        UI_DrawButton(hdc, button);
-    }
-}
-
-void UI_DrawButton(HDC hdc, const WindowControlButton& button) {
-    HBRUSH brush = CreateSolidBrush(button.GetCurrentColor());
-    if (!brush) return;
-    
-    HBRUSH oldBrush = (HBRUSH)SelectObject(hdc, brush);
-    
-    Ellipse(hdc,
-           button.center.x - CIRCLE_RADIUS,
-           button.center.y - CIRCLE_RADIUS,
-           button.center.x + CIRCLE_RADIUS,
-           button.center.y + CIRCLE_RADIUS);
-    
-    if (button.isActive) {
-        HPEN whitePen = CreatePen(PS_SOLID, 2, RGB(255, 255, 255));
-        if (whitePen) {
-            HPEN oldPen = (HPEN)SelectObject(hdc, whitePen);
-            SelectObject(hdc, GetStockObject(NULL_BRUSH));
-            
-            Ellipse(hdc,
-                   button.center.x - CIRCLE_RADIUS - 2,
-                   button.center.y - CIRCLE_RADIUS - 2,
-                   button.center.x + CIRCLE_RADIUS + 2,
-                   button.center.y + CIRCLE_RADIUS + 2);
-            
-            SelectObject(hdc, oldPen);
-            DeleteObject(whitePen);
-        }
-    }
-    
-    SelectObject(hdc, oldBrush);
-    DeleteObject(brush);
-}
-
-void UI_HandleMouseMove(int x, int y, UIState* state) {
+void UI_HandleMouseMove(int x, int y, UIState* state, DamageRegion* damage) {
     if (!state) return;
     
     if (state->showHomeUI) {
@@ -503,6 +216,7 @@ void UI_HandleMouseMove(int x, int y, UIState* state) {
                            y >= state->fileTypeButtons[i].top && y <= state->fileTypeButtons[i].bottom);
             if (overBtn != state->fileButtonHovered[i]) {
                 state->fileButtonHovered[i] = overBtn;
+                Damage_Add(damage, UI_FileButtonArea(state, i));
             }
         }
     }
@@ -514,11 +228,13 @@ void UI_HandleMouseMove(int x, int y, UIState* state) {
         if (state->hoveredButton >= 0 && (size_t)state->hoveredButton < state->buttons.size()) {
             if (state->buttons[state->hoveredButton].state == STATE_HOVERED) {
                 state->buttons[state->hoveredButton].state = STATE_NORMAL;
+                Damage_Add(damage, UI_ButtonArea(state->buttons[state->hoveredButton]));
             }
         }
         
         if (newHovered >= 0 && (size_t)newHovered < state->buttons.size()) {
             state->buttons[newHovered].state = STATE_HOVERED;
+            Damage_Add(damage, UI_ButtonArea(state->buttons[newHovered]));
         }
         
         state->hoveredButton = newHovered;
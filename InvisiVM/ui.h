@@ -1,12 +1,14 @@
 #ifndef UI_H
 #define UI_H
 
-#include <windows.h>
+#include "platform.h"
 #include <vector>
 #include <string>
 #include <algorithm>
 #include "constants.h"
 #include "apprun.h"  // Include AppRunState
+#include "canvas.h"
+#include "damage.h"
 
 // File types supported
 enum FileType {
@@ -134,12 +136,20 @@ void UI_Initialize(UIState* state);
 void UI_StartIntroTimer(HWND hwnd, UIState* state);
 void UI_StopIntroTimer(HWND hwnd, UIState* state);
 void UI_UpdateIntroAnimation(HWND hwnd, UIState* state);
-void UI_DrawIntroSequence(HDC hdc, const RECT& clientRect, UIState* state);
-void UI_DrawHomeUI(HDC hdc, const RECT& clientRect, UIState* state);
-void UI_HandleMouseMove(int x, int y, UIState* state);
+// Drawing, in uidraw.cpp, works on any canvas
+void UI_DrawIntroSequence(Canvas* canvas, const RECT& clientRect, UIState* state);
+void UI_DrawHomeUI(Canvas* canvas, const RECT& clientRect, UIState* state);
+// The grey bar along the bottom with the window buttons
+void UI_DrawBottomBar(Canvas* canvas, const RECT& clientRect, UIState* state);
+// Adds the buttons whose hover state changed to 'damage'
+void UI_HandleMouseMove(int x, int y, UIState* state, DamageRegion* damage);
 bool UI_HandleHomeButtonClick(int x, int y, UIState* state, FileType* selectedType);
 bool UI_HandleHomeButtonRelease(HWND hwnd, int x, int y, UIState* state, HINSTANCE hInstance, FileType selectedType);
-void UI_DrawButton(HDC hdc, const WindowControlButton& button);
+void UI_DrawButton(Canvas* canvas, const WindowControlButton& button);
+// Everything a button draws, its ring and a file type button's shadow
+// included, for marking it damaged
+RECT UI_ButtonArea(const WindowControlButton& button);
+RECT UI_FileButtonArea(const UIState* state, int index);
 void UI_InitializeButtons(UIState* state);
 void UI_UpdateButtonPositions(const RECT& clientRect, UIState* state);
 int UI_FindButtonAtPoint(int x, int y, UIState* state);
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cwchar>
+#include "ui.h"
+#include "constants.h"
+#include "textmeasure.h"
+
+static const int SHADOW_OFFSET = 4;  // of a file type button
+static const int BORDER_WIDTH = 2;
+static const int RING_GAP = 2;       // between an active window button and its ring
+static const int RING_WIDTH = 2;
+
+// Drawing for the intro, the home screen and the window buttons. Nothing
+// here touches Windows, so it draws on any canvas.
+
+static const wchar_t* const fileTypeLabels[FILE_COUNT] = {
+    L"PDF Files",
+    L"Text Files",
+    L"CSV Files",
+    L"Word Documents",
+    L"Excel Files",
+    L"Open Application"
+};
+
+static void DrawTextWithGlow(Canvas* canvas, const wchar_t* text, int x, int y, const CanvasFont& font,
+                             int textWidth, int textHeight, int textColor, float glowPos) {
+    size_t length = wcslen(text);
+    canvas->Text(font, RGB(textColor, textColor, textColor), x, y, text, length, NULL);
+
+    int glowX = x + (int)(textWidth * glowPos);
+    int glowRadius = 40;
+
+    for (int offset = -glowRadius; offset <= glowRadius; offset += 1) {
+        int currentX = glowX + offset;
+        if (currentX < x || currentX > x + textWidth) continue;
+
+        float distance = abs(offset) / (float)glowRadius;
+        int intensity = (int)(200 * (1.0f - distance));
+        intensity = std::min(intensity, 255);
+
+        if (intensity > 0) {
+            int r = (int)(intensity * (1.2f + 0.3f * glowPos));
+            int g = (int)(intensity * 0.5f);
+            int b = (int)(intensity * (1.2f - 0.3f * glowPos));
+
+            COLORREF glow = RGB(
+                std::min(255, textColor + r),
+                std::min(255, textColor + g),
+                std::min(255, textColor + b)
+            );
+
+            RECT clipRect = {currentX - 1, y, currentX + 1, y + textHeight};
+            canvas->Text(font, glow, x, y, text, length, &clipRect);
+        }
+    }
+}
+
+void UI_DrawIntroSequence(Canvas* canvas, const RECT& clientRect, UIState* state) {
+    if (!state) return;
+
+    canvas->FillRect(clientRect, RGB(255, 255, 255));
+
+    const wchar_t* text = (state->introState >= INTRO_WELCOME_IN) ? L"Welcome" : L"Loading...";
+
+    int availableWidth = (state->introState >= INTRO_WELCOME_IN)
+                         ? (int)(clientRect.right * 0.50)
+                         : (int)(clientRect.right * 0.30);
+
+    const wchar_t* fontName = L"Segoe Script";
+    int fontWeight = FW_BOLD;
+    bool italic = state->introState < INTRO_WELCOME_IN;
+    size_t length = wcslen(text);
+
+    // Sized from cached advances; only the font drawn with is created
+    FontAdvances* advances = TextMeasure_Open({fontName, fontWeight, italic}, NULL);
+    int fontSize = TextMeasure_FitHeight(advances, text, length, availableWidth, 10, 100);
+
+    if (state->introState == INTRO_WELCOME_GROW) {
+        float growthFactor = 1.0f + ((state->welcomeSize - 30) / 50.0f) * 0.5f;
+        fontSize = (int)(fontSize * growthFactor + 0.01f);
+    }
+
+    CanvasFont font = {fontName, fontSize, fontWeight, italic};
+    int textWidth = TextMeasure_Width(advances, fontSize, text, length);
+    int textHeight = fontSize;
+
+    int x = (clientRect.right - textWidth) / 2;
+    int y = (clientRect.bottom - textHeight) / 2;
+
+    int alpha = std::max(0, std::min(255, state->introAlpha));
+    int gray = 255 - alpha;
+
+    if ((state->introState == INTRO_WELCOME_IN || state->introState == INTRO_WELCOME_GROW) && state->glowPosition < 1.0f) {
+        DrawTextWithGlow(canvas, text, x, y, font, textWidth, textHeight, gray, state->glowPosition);
+    } else {
+        canvas->Text(font, RGB(gray, gray, gray), x, y, text, length, NULL);
+    }
+}
+
+void UI_DrawHomeUI(Canvas* canvas, const RECT& clientRect, UIState* state) {
+    if (!state) return;
+
+    // Background white area
+    canvas->FillRect(clientRect, RGB(255, 255, 255));
+
+    // Left sidebar (grey)
+    RECT sidebar = clientRect;
+    sidebar.right = sidebar.left + 60;
+    canvas->FillRect(sidebar, RGB(210, 210, 210));
+
+    // Top header rectangle
+    RECT header = clientRect;
+    header.left = sidebar.right;
+    header.bottom = header.top + 90;
+    canvas->FillRect(header, RGB(255, 255, 255));
+
+    // Header text "Welcome To InvisVM"
+    CanvasFont headerFont = {L"Segoe Script", 28, FW_BOLD, true};
+    RECT hdrTextRect = header;
+    hdrTextRect.left += 12;
+    hdrTextRect.top += 8;
+    if (canvas->Visible(hdrTextRect)) canvas->TextInRect(headerFont, RGB(30, 30, 30), hdrTextRect, L"Welcome To\nInvisVM", -1, DT_LEFT | DT_TOP);
+
+    // Divider line under header
+    canvas->Line(sidebar.right, header.bottom, clientRect.right, header.bottom, 3, RGB(0, 0, 0));
+
+    // Main content area
+    RECT content = clientRect;
+    content.top = header.bottom + 8;
+    content.left = sidebar.right + 12;
+    content.right -= 12;
+    content.bottom -= BAR_HEIGHT + 10;
+
+    // Label "Select File Type"
+    CanvasFont labelFont = {L"Segoe UI", 22, FW_BOLD, false};
+    RECT lblRect = content;
+    lblRect.top += 10;
+    canvas->TextInRect(labelFont, RGB(20, 20, 20), lblRect, L"Select File Type", -1, DT_LEFT | DT_TOP);
+
+    // Draw file type buttons
+    CanvasFont buttonFont = {L"Segoe UI", 15, FW_NORMAL, false};
+    int btnW = 180;
+    int btnH = 36;
+    int btnSpacing = 10;
+    int startY = content.top + 50;
+
+    for (int i = 0; i < FILE_COUNT; i++) {
+        int btnX = content.left + 10;
+        int btnY = startY + (i * (btnH + btnSpacing));
+
+        // Button rect, kept for hit testing even when not drawn
+        RECT btnRect = {btnX, btnY, btnX + btnW, btnY + btnH};
+        state->fileTypeButtons[i] = btnRect;
+        if (!canvas->Visible(UI_FileButtonArea(state, i))) continue;
+
+        // Shadow
+        RECT shadow = {btnX + SHADOW_OFFSET, btnY + SHADOW_OFFSET, btnX + SHADOW_OFFSET + btnW,
+                       btnY + SHADOW_OFFSET + btnH};
+        canvas->FillRect(shadow, RGB(200, 200, 200));
+
+        // Button fill (special color for Application button)
+        COLORREF btnColor;
+        if (state->fileButtonPressed[i]) {
+            btnColor = RGB(34, 34, 34);
+        } else if (state->fileButtonHovered[i]) {
+            if (i == FILE_APP) {
+                btnColor = RGB(220, 240, 255);  // Light blue for app
+            } else {
+                btnColor = RGB(240, 240, 240);
+            }
+        } else {
+            if (i == FILE_APP) {
+                btnColor = RGB(230, 245, 255);  // Slightly blue tint
+            } else {
+                btnColor = RGB(245, 245, 245);
+            }
+        }
+        canvas->FillRect(btnRect, btnColor);
+
+        // Button border
+        canvas->StrokeRect(btnRect, BORDER_WIDTH, RGB(0, 0, 0));
+
+        // Button label
+        canvas->TextInRect(buttonFont, RGB(20, 20, 20), btnRect, fileTypeLabels[i], -1,
+                           DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+    }
+
+    UI_DrawBottomBar(canvas, clientRect, state);
+}
+
+void UI_DrawBottomBar(Canvas* canvas, const RECT& clientRect, UIState* state) {
+    if (!state) return;
+
+    // Grey background
+    RECT bottomBarRect = clientRect;
+    bottomBarRect.top = clientRect.bottom - BAR_HEIGHT;
+    if (!canvas->Visible(bottomBarRect)) return;
+    canvas->FillRect(bottomBarRect, RGB(60, 60, 60));
+
+    // The circular buttons on it
+    for (const auto& button : state->buttons) {
+        if (canvas->Visible(UI_ButtonArea(button))) UI_DrawButton(canvas, button);
+    }
+}
+
+void UI_DrawButton(Canvas* canvas, const WindowControlButton& button) {
+    RECT circle = {button.center.x - CIRCLE_RADIUS, button.center.y - CIRCLE_RADIUS,
+                   button.center.x + CIRCLE_RADIUS, button.center.y + CIRCLE_RADIUS};
+    canvas->FillEllipse(circle, button.GetCurrentColor(), RGB(0, 0, 0));
+
+    if (button.isActive) {
+        RECT ring = {circle.left - RING_GAP, circle.top - RING_GAP, circle.right + RING_GAP, circle.bottom + RING_GAP};
+        canvas->StrokeEllipse(ring, RING_WIDTH, RGB(255, 255, 255));
+    }
+}
+
+RECT UI_ButtonArea(const WindowControlButton& button) {
+    // Half the ring's pen lies outside it, the odd pixel to the right and below
+    int reach = CIRCLE_RADIUS + RING_GAP + RING_WIDTH / 2;
+    return {button.center.x - reach, button.center.y - reach, button.center.x + reach + 1,
+            button.center.y + reach + 1};
+}
+
+RECT UI_FileButtonArea(const UIState* state, int index) {
+    const RECT& button = state->fileTypeButtons[index];
+    int outside = BORDER_WIDTH / 2;
+    return {button.left - outside, button.top - outside, button.right + SHADOW_OFFSET,
+            button.bottom + SHADOW_OFFSET};
+}
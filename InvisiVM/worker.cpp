@@ -0,0 +1,317 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include "worker.h"
+
+struct Worker {
+#ifdef _WIN32
+    HANDLE process;
+    HANDLE toChild;
+    HANDLE fromChild;
+#else
+    pid_t pid;
+    int toChild;
+    int fromChild;
+#endif
+    bool busy;
+};
+
+struct WorkerPool {
+    std::mutex lock;
+    std::condition_variable idle;
+    std::vector<Worker*> workers;
+    size_t maxWorkers;
+    std::string script;
+    bool shutdown;
+
+    WorkerPool() : maxWorkers(0), shutdown(false) {}
+};
+
+static WorkerPool g_pool;
+
+// program.py lives next to the executable
+static std::string FindScript() {
+#ifdef _WIN32
+    char exePath[MAX_PATH];
+    if (GetModuleFileNameA(NULL, exePath, MAX_PATH) == 0) return "";
+    char* lastSlash = strrchr(exePath, '\\');
+    if (lastSlash) *lastSlash = '\0';
+    std::string script = std::string(exePath) + "\\program.py";
+    if (GetFileAttributesA(script.c_str()) == INVALID_FILE_ATTRIBUTES) return "";
+#else
+    char exePath[4096];
+    ssize_t len = readlink("/proc/self/exe", exePath, sizeof(exePath) - 1);
+    if (len <= 0) return "";
+    exePath[len] = '\0';
+    char* lastSlash = strrchr(exePath, '/');
+    if (lastSlash) *lastSlash = '\0';
+    std::string script = std::string(exePath) + "/program.py";
+    if (access(script.c_str(), R_OK) != 0) return "";
+#endif
+    return script;
+}
+
+static bool SpawnWorker(Worker* w, const std::string& script) {
+    w->busy = false;
+#ifdef _WIN32
+    SECURITY_ATTRIBUTES sa = {sizeof(sa), NULL, TRUE};
+    HANDLE inRead, inWrite, outRead, outWrite;
+    if (!CreatePipe(&inRead, &inWrite, &sa, 0)) return false;
+    if (!CreatePipe(&outRead, &outWrite, &sa, 0)) {
+        CloseHandle(inRead);
+        CloseHandle(inWrite);
+        return false;
+    }
+    // Only the child's ends are inheritable
+    SetHandleInformation(inWrite, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(outRead, HANDLE_FLAG_INHERIT, 0);
+
+    STARTUPINFOA si = {};
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = inRead;
+    si.hStdOutput = outWrite;
+    si.hStdError = NULL;
+
+    PROCESS_INFORMATION pi = {};
+    std::string command = "python -u \"" + script + "\" --serve";
+    BOOL ok = CreateProcessA(NULL, &command[0], NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &si, &pi);
+    CloseHandle(inRead);
+    CloseHandle(outWrite);
+    if (!ok) {
+        CloseHandle(inWrite);
+        CloseHandle(outRead);
+        return false;
+    }
+    CloseHandle(pi.hThread);
+    w->process = pi.hProcess;
+    w->toChild = inWrite;
+    w->fromChild = outRead;
+#else
+    int in[2], out[2];
+    if (pipe2(in, O_CLOEXEC) != 0) return false;
+    if (pipe2(out, O_CLOEXEC) != 0) {
+        close(in[0]);
+        close(in[1]);
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(in[0], 0);
+        dup2(out[1], 1);
+        execlp("python3", "python3", "-u", script.c_str(), "--serve", (char*)NULL);
+        _exit(127);
+    }
+    close(in[0]);
+    close(out[1]);
+    if (pid < 0) {
+        close(in[1]);
+        close(out[0]);
+        return false;
+    }
+    w->pid = pid;
+    w->toChild = in[1];
+    w->fromChild = out[0];
+#endif
+    return true;
+}
+
+static void KillWorker(Worker* w) {
+#ifdef _WIN32
+    CloseHandle(w->toChild);
+    CloseHandle(w->fromChild);
+    // Closing stdin lets a healthy worker exit on its own
+    if (WaitForSingleObject(w->process, 500) != WAIT_OBJECT_0) TerminateProcess(w->process, 1);
+    CloseHandle(w->process);
+#else
+    close(w->toChild);
+    close(w->fromChild);
+    int status;
+    for (int i = 0; i < 50 && waitpid(w->pid, &status, WNOHANG) == 0; i++) usleep(10000);
+    if (waitpid(w->pid, &status, WNOHANG) == 0) {
+        kill(w->pid, SIGKILL);
+        waitpid(w->pid, &status, 0);
+    }
+#endif
+}
+
+static bool WriteAll(Worker* w, const char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        DWORD written = 0;
+        if (!WriteFile(w->toChild, data, (DWORD)std::min<size_t>(size, 1 << 20), &written, NULL) || written == 0) {
+            return false;
+        }
+#else
+        ssize_t written = write(w->toChild, data, size);
+        if (written <= 0) return false;
+#endif
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool ReadAll(Worker* w, char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        DWORD got = 0;
+        if (!ReadFile(w->fromChild, data, (DWORD)std::min<size_t>(size, 1 << 20), &got, NULL) || got == 0) {
+            return false;
+        }
+#else
+        ssize_t got = read(w->fromChild, data, size);
+        if (got <= 0) return false;
+#endif
+        data += got;
+        size -= got;
+    }
+    return true;
+}
+
+static Worker* AcquireWorker() {
+    std::unique_lock<std::mutex> guard(g_pool.lock);
+
+    if (g_pool.maxWorkers == 0) {
+#ifndef _WIN32
+        signal(SIGPIPE, SIG_IGN);  // a dead worker must not take the viewer down
+#endif
+        // Each interpreter with pypdf loaded costs tens of MB, so use half the cores
+        unsigned cores = std::thread::hardware_concurrency();
+        g_pool.maxWorkers = std::max(1u, std::min(cores / 2, 8u));
+        g_pool.script = FindScript();
+    }
+    if (g_pool.script.empty()) return NULL;
+
+    for (;;) {
+        if (g_pool.shutdown) return NULL;
+
+        for (size_t i = 0; i < g_pool.workers.size(); i++) {
+            if (!g_pool.workers[i]->busy) {
+                g_pool.workers[i]->busy = true;
+                return g_pool.workers[i];
+            }
+        }
+
+        if (g_pool.workers.size() < g_pool.maxWorkers) {
+            // Spawning under the lock keeps inheritable pipe handles from
+            // leaking into a sibling worker created at the same moment
+            Worker* w = new Worker();
+            if (!SpawnWorker(w, g_pool.script)) {
+                delete w;
+                return NULL;
+            }
+            w->busy = true;
+            g_pool.workers.push_back(w);
+            return w;
+        }
+
+        g_pool.idle.wait(guard);
+    }
+}
+
+static void ReleaseWorker(Worker* w, bool healthy) {
+    {
+        std::lock_guard<std::mutex> guard(g_pool.lock);
+        if (healthy) {
+            w->busy = false;
+        } else {
+            g_pool.workers.erase(std::remove(g_pool.workers.begin(), g_pool.workers.end(), w),
+                                 g_pool.workers.end());
+        }
+    }
+    if (!healthy) {
+        KillWorker(w);
+        delete w;
+    }
+    g_pool.idle.notify_one();
+}
+
+static bool RunJob(Worker* w, const std::string& request, std::string* out) {
+    unsigned char header[4];
+    unsigned size = (unsigned)request.size();
+    for (int i = 0; i < 4; i++) header[i] = (unsigned char)(size >> (i * 8));
+    if (!WriteAll(w, (const char*)header, 4) || !WriteAll(w, request.data(), request.size())) return false;
+
+    if (!ReadAll(w, (char*)header, 4)) return false;
+    size = header[0] | (header[1] << 8) | (header[2] << 16) | ((unsigned)header[3] << 24);
+    out->resize(size);
+    return size == 0 || ReadAll(w, &(*out)[0], size);
+}
+
+static std::string ToUTF8Path(const char* path) {
+#ifdef _WIN32
+    // The file dialogs hand us ANSI paths; the worker protocol is UTF-8
+    int wlen = MultiByteToWideChar(CP_ACP, 0, path, -1, NULL, 0);
+    if (wlen <= 0) return path;
+    std::vector<wchar_t> wide(wlen);
+    MultiByteToWideChar(CP_ACP, 0, path, -1, &wide[0], wlen);
+    int len = WideCharToMultiByte(CP_UTF8, 0, &wide[0], -1, NULL, 0, NULL, NULL);
+    if (len <= 0) return path;
+    std::vector<char> utf8(len);
+    WideCharToMultiByte(CP_UTF8, 0, &wide[0], -1, &utf8[0], len, NULL, NULL);
+    return std::string(&utf8[0]);
+#else
+    return path;
+#endif
+}
+
+bool WorkerPool_Extract(const char* path, const char* expectedType, std::string* out) {
+    if (!path || !out) return false;
+
+    std::string request = ToUTF8Path(path);
+    request.push_back('\0');
+    if (expectedType) request += expectedType;
+
+    // A worker that dies mid-job is replaced and the job retried once
+    for (int attempt = 0; attempt < 2; attempt++) {
+        Worker* w = AcquireWorker();
+        if (!w) return false;
+        bool ok = RunJob(w, request, out);
+        ReleaseWorker(w, ok);
+        if (ok) return true;
+    }
+    return false;
+}
+
+int WorkerPool_Size() {
+    std::lock_guard<std::mutex> guard(g_pool.lock);
+    return (int)g_pool.workers.size();
+}
+
+void WorkerPool_Shutdown() {
+    std::vector<Worker*> workers;
+    {
+        std::lock_guard<std::mutex> guard(g_pool.lock);
+        g_pool.shutdown = true;
+        workers.swap(g_pool.workers);
+    }
+    g_pool.idle.notify_all();
+
+    // Busy workers belong to jobs still in flight. Only stop their process so
+    // the job's read fails and its own thread releases the handles.
+    for (size_t i = 0; i < workers.size(); i++) {
+        if (workers[i]->busy) {
+#ifdef _WIN32
+            TerminateProcess(workers[i]->process, 1);
+#else
+            kill(workers[i]->pid, SIGKILL);
+#endif
+        } else {
+            KillWorker(workers[i]);
+            delete workers[i];
+        }
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <string>
+
+// Pool of resident "python program.py --serve" processes. Interpreters stay
+// warm between files, crashed workers are replaced, and the pool grows up to
+// a size derived from the core count so several files extract at once.
+bool WorkerPool_Extract(const char* path, const char* expectedType, std::string* out);
+int WorkerPool_Size();
+void WorkerPool_Shutdown();
+
+#endif
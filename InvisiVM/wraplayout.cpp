@@ -0,0 +1,107 @@
+#include <algorithm>
+#include "wraplayout.h"
+
+static inline bool IsLowSurrogate(wchar_t c) {
+    return c >= 0xDC00 && c <= 0xDFFF;
+}
+
+// A row may end after one of these
+static inline bool BreaksAfter(wchar_t c) {
+    return c == L' ' || c == L'\t' || c == L'-';
+}
+
+static int Advance(WrapLayout* layout, wchar_t c, GlyphMeasurer* measurer) {
+    // The second half of a surrogate pair takes no room of its own
+    if (IsLowSurrogate(c)) return 0;
+    std::vector<int>& page = layout->advances[((unsigned)c >> 8) & 0xFF];
+    if (page.empty()) {
+        page.assign(256, 0);
+        wchar_t first = (wchar_t)(c & 0xFF00);
+        measurer->Measure(first, (wchar_t)(first | 0xFF), page.data());
+    }
+    return std::max(0, page[c & 0xFF]);
+}
+
+// Greedy fill: each row takes as many code units as fit, then gives back
+// the end of a word cut in half. Spaces at the end of a row hang past the
+// edge, so the next row starts on a word. A word wider than the row is
+// split where the row is full.
+static void Break(WrapLine* wrapped, const std::wstring& text, int width) {
+    wrapped->starts.assign(1, 0);
+    wrapped->width = width;
+    const std::vector<int>& x = wrapped->x;
+    size_t n = text.size();
+    size_t start = 0;
+    while (x[n] - x[start] > width) {
+        // Last end whose row still fits
+        size_t end = (size_t)(std::upper_bound(x.begin() + start + 1, x.end(), x[start] + width) - x.begin()) - 1;
+        if (end <= start) end = start + 1;
+        // Surrogate pairs stay together
+        if (end < n && IsLowSurrogate(text[end])) end = end - 1 > start ? end - 1 : end + 1;
+        while (end < n && text[end] == L' ') end++;
+
+        size_t cut = end;
+        if (end < n) {
+            for (size_t k = end; k > start; k--) {
+                if (BreaksAfter(text[k - 1])) {
+                    cut = k;
+                    break;
+                }
+            }
+        }
+        if (cut >= n) break;
+        wrapped->starts.push_back((uint32_t)cut);
+        start = cut;
+    }
+}
+
+void Wrap_SetWidth(WrapLayout* layout, int width) {
+    layout->width = std::max(0, width);
+}
+
+const WrapLine* Wrap_Line(WrapLayout* layout, size_t line, const std::wstring& text, GlyphMeasurer* measurer) {
+    WrapLine* wrapped = &layout->slots[line % WrapLayout::SLOTS];
+    if (!wrapped->used || wrapped->line != line || wrapped->units != text.size()) {
+        wrapped->x.resize(text.size() + 1);
+        int sum = 0;
+        wrapped->x[0] = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            sum += Advance(layout, text[i], measurer);
+            wrapped->x[i + 1] = sum;
+        }
+        wrapped->line = line;
+        wrapped->units = text.size();
+        wrapped->used = true;
+        wrapped->width = 0;
+    }
+    if (layout->width <= 0) {
+        wrapped->starts.assign(1, 0);
+        wrapped->width = 0;
+    } else if (wrapped->width != layout->width) {
+        Break(wrapped, text, layout->width);
+    }
+    return wrapped;
+}
+
+size_t Wrap_Rows(const WrapLine* wrapped) {
+    return wrapped->starts.size();
+}
+
+size_t Wrap_RowAt(const WrapLine* wrapped, size_t unit) {
+    const std::vector<uint32_t>& starts = wrapped->starts;
+    return (size_t)(std::upper_bound(starts.begin(), starts.end(), unit) - starts.begin()) - 1;
+}
+
+void Wrap_RowRange(const WrapLine* wrapped, size_t row, size_t* begin, size_t* end) {
+    *begin = wrapped->starts[row];
+    *end = row + 1 < wrapped->starts.size() ? wrapped->starts[row + 1] : wrapped->units;
+}
+
+void Wrap_Clear(WrapLayout* layout) {
+    for (size_t i = 0; i < WrapLayout::SLOTS; i++) {
+        WrapLine& slot = layout->slots[i];
+        slot.used = false;
+        std::vector<int>().swap(slot.x);
+        std::vector<uint32_t>().swap(slot.starts);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef WRAPLAYOUT_H
+#define WRAPLAYOUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Soft word wrap for the lines around the view. Only lines that are drawn
+// or scrolled past are laid out, so wrapping a 1M line document costs the
+// same as wrapping one screen of it.
+//
+// Each cached line keeps the running advance of its UTF-16 text, which
+// does not depend on the width. A resize only moves the breaks: a binary
+// search per row over the cached advances, with no font calls.
+
+// Supplies advances in pixels for a run of UTF-16 code units in the font
+// the text is drawn with
+class GlyphMeasurer {
+public:
+    virtual ~GlyphMeasurer() {}
+    virtual void Measure(wchar_t first, wchar_t last, int* advances) = 0;
+};
+
+struct WrapLine {
+    size_t line;
+    size_t units;               // text length, so a line still growing is redone
+    bool used;
+    std::vector<int> x;         // x[i]: advance of the first i code units
+    int width;                  // width 'starts' was broken for; 0 if none
+    std::vector<uint32_t> starts;  // first code unit of each row; starts[0] is 0
+
+    WrapLine() : line(0), units(0), used(false), width(0) {}
+};
+
+struct WrapLayout {
+    static const size_t SLOTS = 256;
+
+    int width;  // pixels available to a row; 0 leaves lines unwrapped
+    // Advances by code unit, measured 256 at a time as they turn up
+    std::vector<std::vector<int>> advances;
+    WrapLine slots[SLOTS];
+
+    WrapLayout() : width(0), advances(256) {}
+};
+
+// Later lines are broken for the new width as they are asked for
+void Wrap_SetWidth(WrapLayout* layout, int width);
+// Line 'line' with rows for the current width. 'text' is the line as
+// drawn; the result stays valid until the next call.
+const WrapLine* Wrap_Line(WrapLayout* layout, size_t line, const std::wstring& text, GlyphMeasurer* measurer);
+size_t Wrap_Rows(const WrapLine* wrapped);
+// Row holding code unit 'unit'
+size_t Wrap_RowAt(const WrapLine* wrapped, size_t unit);
+// Code units [*begin, *end) of row 'row'
+void Wrap_RowRange(const WrapLine* wrapped, size_t row, size_t* begin, size_t* end);
+// Forgets every line, for a new document
+void Wrap_Clear(WrapLayout* layout);
+
+#endif
@@ -0,0 +1,431 @@
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include "opcpackage.h"
+#include "xlsx.h"
+
+// Excel's limits; references past them come from a damaged file
+static const size_t MAX_ROWS = 1048576;
+static const size_t MAX_COLUMNS = 16384;
+
+struct XlsxSheet {
+    std::string name;
+    std::string part;  // path inside the archive
+};
+
+struct XlsxBook {
+    ZipArchive zip;
+    std::vector<XlsxSheet> sheets;
+    std::string sharedStringsPart;
+    std::string stylesPart;
+    bool date1904;
+    bool extrasLoaded;  // shared strings and styles
+    InflateWindow window;  // reused by every part read on the book's thread
+
+    // Every shared string back to back; string i is [offsets[i], offsets[i + 1])
+    std::string arena;
+    std::vector<size_t> offsets;
+    std::vector<char> dateStyles;  // per cell format index
+
+    XlsxBook() : date1904(false), extrasLoaded(false) {}
+};
+
+// ---------------------------------------------------------------------------
+// Workbook
+// ---------------------------------------------------------------------------
+
+static std::string Unescaped(std::string_view raw) {
+    std::string out;
+    Xml_AppendText(raw, &out);
+    return out;
+}
+
+class WorkbookReader : public XmlHandler {
+public:
+    std::vector<std::pair<std::string, std::string>> sheets;  // name, relationship id
+    bool date1904;
+
+    WorkbookReader() : date1904(false) {}
+
+    void OnStart(std::string_view name, const std::vector<XmlAttr>& attrs) override {
+        std::string_view local = Xml_LocalName(name);
+        if (local == "sheet") {
+            sheets.push_back(std::make_pair(Unescaped(Xml_Attr(attrs, "name")), Unescaped(Xml_Attr(attrs, "id"))));
+        } else if (local == "workbookPr") {
+            std::string_view flag = Xml_Attr(attrs, "date1904");
+            date1904 = flag == "1" || flag == "true";
+        }
+    }
+};
+
+XlsxBook* Xlsx_Open(const char* path, std::string* error) {
+    XlsxBook* book = new XlsxBook();
+    if (!Zip_Open(path, &book->zip)) {
+        if (error) *error = "Error: Not a valid XLSX file.";
+        delete book;
+        return NULL;
+    }
+
+    std::string workbookPart = Opc_MainPart(&book->zip, "xl/workbook.xml");
+    std::vector<OpcRelationship> rels;
+    Opc_Relationships(&book->zip, workbookPart, &rels);
+    WorkbookReader workbook;
+    if (!Opc_ParsePart(&book->zip, workbookPart, &workbook, NULL, &book->window)) {
+        if (error) *error = "Error: The XLSX file has no workbook.";
+        Xlsx_Close(book);
+        return NULL;
+    }
+    book->date1904 = workbook.date1904;
+
+    for (size_t i = 0; i < workbook.sheets.size(); i++) {
+        const OpcRelationship* rel = Opc_FindId(rels, workbook.sheets[i].second);
+        if (!rel) continue;
+        XlsxSheet sheet;
+        sheet.name = workbook.sheets[i].first;
+        sheet.part = rel->target;
+        book->sheets.push_back(sheet);
+    }
+
+    std::string folder = Opc_Folder(workbookPart);
+    const OpcRelationship* strings = Opc_FindType(rels, "/sharedStrings");
+    book->sharedStringsPart = strings ? strings->target : folder + "sharedStrings.xml";
+    const OpcRelationship* styles = Opc_FindType(rels, "/styles");
+    book->stylesPart = styles ? styles->target : folder + "styles.xml";
+    return book;
+}
+
+void Xlsx_Close(XlsxBook* book) {
+    if (!book) return;
+    Zip_Close(&book->zip);
+    delete book;
+}
+
+int Xlsx_SheetCount(const XlsxBook* book) {
+    return book ? (int)book->sheets.size() : 0;
+}
+
+std::string Xlsx_SheetName(const XlsxBook* book, int index) {
+    if (!book || index < 0 || index >= (int)book->sheets.size()) return std::string();
+    return book->sheets[index].name;
+}
+
+// ---------------------------------------------------------------------------
+// Shared strings and styles
+// ---------------------------------------------------------------------------
+
+// Rich text runs are concatenated; phonetic guides are left out
+class SharedStringsReader : public XmlHandler {
+public:
+    explicit SharedStringsReader(XlsxBook* book) : book(book), inText(false), phonetic(0) {}
+
+    void OnStart(std::string_view name, const std::vector<XmlAttr>& attrs) override {
+        std::string_view local = Xml_LocalName(name);
+        if (local == "si") book->offsets.push_back(book->arena.size());
+        else if (local == "t") inText = phonetic == 0;
+        else if (local == "rPh") phonetic++;
+    }
+
+    void OnEnd(std::string_view name) override {
+        std::string_view local = Xml_LocalName(name);
+        if (local == "t") inText = false;
+        else if (local == "rPh") phonetic--;
+    }
+
+    void OnText(std::string_view text, bool cdata) override {
+        if (!inText) return;
+        if (cdata) book->arena.append(text.data(), text.size());
+        else Xml_AppendText(text, &book->arena);
+    }
+
+private:
+    XlsxBook* book;
+    bool inText;
+    int phonetic;
+};
+
+// Built-in number formats that show a date or time
+static bool IsBuiltinDate(int id) {
+    return (id >= 14 && id <= 22) || (id >= 27 && id <= 36) || (id >= 45 && id <= 47) || (id >= 50 && id <= 58);
+}
+
+// A custom format shows a date or time if it has d, m, y, h or s outside
+// quoted text, escapes and [colour] or [$locale] sections
+static bool IsDateFormat(const std::string& code) {
+    for (size_t i = 0; i < code.size(); i++) {
+        char c = code[i];
+        if (c == '"') {
+            size_t close = code.find('"', i + 1);
+            if (close == std::string::npos) break;
+            i = close;
+        } else if (c == '[') {
+            size_t close = code.find(']', i + 1);
+            if (close == std::string::npos) break;
+            i = close;
+        } else if (c == '\\' || c == '_' || c == '*') {
+            i++;
+        } else {
+            c = (char)tolower((unsigned char)c);
+            if (c == 'd' || c == 'm' || c == 'y' || c == 'h' || c == 's') return true;
+        }
+    }
+    return false;
+}
+
+class StylesReader : public XmlHandler {
+public:
+    std::map<int, bool> customDates;
+    std::vector<int> cellFormats;  // number format of each cellXfs entry
+
+    StylesReader() : inCellXfs(false) {}
+
+    void OnStart(std::string_view name, const std::vector<XmlAttr>& attrs) override {
+        std::string_view local = Xml_LocalName(name);
+        if (local == "numFmt") {
+            int id = atoi(std::string(Xml_Attr(attrs, "numFmtId")).c_str());
+            customDates[id] = IsDateFormat(Unescaped(Xml_Attr(attrs, "formatCode")));
+        } else if (local == "cellXfs") {
+            inCellXfs = true;
+        } else if (local == "xf" && inCellXfs) {
+            cellFormats.push_back(atoi(std::string(Xml_Attr(attrs, "numFmtId")).c_str()));
+        }
+    }
+
+    void OnEnd(std::string_view name) override {
+        if (Xml_LocalName(name) == "cellXfs") inCellXfs = false;
+    }
+
+private:
+    bool inCellXfs;
+};
+
+// Either part may be missing, as in a workbook of numbers without styles.
+// They are independent, so both are inflated at once.
+static bool LoadExtras(XlsxBook* book, const std::atomic<bool>* cancel) {
+    if (book->extrasLoaded) return true;
+
+    SharedStringsReader strings(book);
+    StylesReader styles;
+    std::vector<std::string> parts = {book->sharedStringsPart, book->stylesPart};
+    std::vector<XmlHandler*> handlers = {&strings, &styles};
+    std::vector<char> ok;
+    Opc_ParseParts(&book->zip, parts, handlers, cancel, &ok);
+    if (Zip_Find(&book->zip, book->sharedStringsPart) && !ok[0]) {
+        std::string().swap(book->arena);
+        std::vector<size_t>().swap(book->offsets);
+        return false;
+    }
+    book->offsets.push_back(book->arena.size());
+
+    book->dateStyles.resize(styles.cellFormats.size());
+    for (size_t i = 0; i < styles.cellFormats.size(); i++) {
+        int id = styles.cellFormats[i];
+        std::map<int, bool>::const_iterator custom = styles.customDates.find(id);
+        book->dateStyles[i] = custom != styles.customDates.end() ? custom->second : IsBuiltinDate(id);
+    }
+    book->extrasLoaded = true;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Sheets
+// ---------------------------------------------------------------------------
+
+static void AppendField(std::string_view value, std::string* out) {
+    if (value.find_first_of(",\"\r\n") == std::string_view::npos) {
+        out->append(value.data(), value.size());
+        return;
+    }
+    out->push_back('"');
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '"') out->push_back('"');
+        out->push_back(value[i]);
+    }
+    out->push_back('"');
+}
+
+// Excel stores doubles with up to 17 digits; it shows 15
+static void AppendNumber(std::string_view raw, std::string* out) {
+    if (raw.size() <= 15) {
+        out->append(raw.data(), raw.size());
+        return;
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.15g", strtod(std::string(raw).c_str(), NULL));
+    out->append(buffer);
+}
+
+// Serial day numbers count from 1900-01-01 as day 1, including the
+// 1900-02-29 that never was, or from 1904-01-01 as day 0
+static void AppendDate(std::string_view raw, bool date1904, std::string* out) {
+    double serial = strtod(std::string(raw).c_str(), NULL);
+    if (!(serial >= 0 && serial < 2958466.0)) {
+        AppendNumber(raw, out);
+        return;
+    }
+    long days = (long)std::floor(serial);
+    long seconds = std::lround((serial - days) * 86400.0);
+    if (seconds >= 86400) {
+        days++;
+        seconds -= 86400;
+    }
+
+    char buffer[40];
+    if (!date1904 && days == 60) {
+        snprintf(buffer, sizeof(buffer), "1900-02-29");
+    } else if (!date1904 && days == 0 && seconds > 0) {
+        buffer[0] = '\0';  // a time of day on its own
+    } else {
+        // Days since 1970-01-01, then the civil date (Howard Hinnant's algorithm)
+        long z = date1904 ? days - 24107 : (days < 60 ? days - 25568 : days - 25569);
+        z += 719468;
+        long era = (z >= 0 ? z : z - 146096) / 146097;
+        long doe = z - era * 146097;
+        long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        long mp = (5 * doy + 2) / 153;
+        long day = doy - (153 * mp + 2) / 5 + 1;
+        long month = mp < 10 ? mp + 3 : mp - 9;
+        long year = yoe + era * 400 + (month <= 2);
+        snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", (int)year, (int)month, (int)day);
+    }
+    out->append(buffer);
+    if (seconds > 0) {
+        if (buffer[0]) out->push_back(' ');
+        snprintf(buffer, sizeof(buffer), "%02ld:%02ld:%02ld", seconds / 3600, seconds / 60 % 60, seconds % 60);
+        out->append(buffer);
+    }
+}
+
+// "AB12" -> 27
+static size_t ColumnOf(std::string_view ref) {
+    size_t column = 0;
+    for (size_t i = 0; i < ref.size() && ref[i] >= 'A' && ref[i] <= 'Z' && column <= MAX_COLUMNS; i++) {
+        column = column * 26 + (ref[i] - 'A' + 1);
+    }
+    return column > 0 ? column - 1 : 0;
+}
+
+class SheetReader : public XmlHandler {
+public:
+    SheetReader(XlsxBook* book, std::string* out)
+        : book(book), out(out), inSheetData(false), inValue(false), inInline(false), inText(false),
+          phonetic(0), lines(0), fields(0), column(0), style(-1) {}
+
+    void OnStart(std::string_view name, const std::vector<XmlAttr>& attrs) override {
+        std::string_view local = Xml_LocalName(name);
+        if (!inSheetData) {
+            inSheetData = local == "sheetData";
+            return;
+        }
+        if (local == "row") {
+            // Rows left out of the file are kept as empty lines
+            size_t number = strtoul(std::string(Xml_Attr(attrs, "r")).c_str(), NULL, 10);
+            if (number > lines + 1 && number <= MAX_ROWS) {
+                out->append(number - 1 - lines, '\n');
+                lines = number - 1;
+            }
+            fields = 0;
+        } else if (local == "c") {
+            std::string_view ref = Xml_Attr(attrs, "r");
+            column = ref.empty() ? fields : ColumnOf(ref);
+            if (column >= MAX_COLUMNS) column = fields;
+            type = Xml_Attr(attrs, "t");
+            std::string_view s = Xml_Attr(attrs, "s");
+            style = s.empty() ? -1 : atoi(std::string(s).c_str());
+            value.clear();
+        } else if (local == "v") {
+            inValue = true;
+        } else if (local == "is") {
+            inInline = true;
+        } else if (local == "t") {
+            inText = inInline && phonetic == 0;
+        } else if (local == "rPh") {
+            phonetic++;
+        }
+    }
+
+    void OnEnd(std::string_view name) override {
+        if (!inSheetData) return;
+        std::string_view local = Xml_LocalName(name);
+        if (local == "v") inValue = false;
+        else if (local == "t") inText = false;
+        else if (local == "is") inInline = false;
+        else if (local == "rPh") phonetic--;
+        else if (local == "c") EmitCell();
+        else if (local == "row") {
+            out->push_back('\n');
+            lines++;
+        } else if (local == "sheetData") {
+            inSheetData = false;
+        }
+    }
+
+    void OnText(std::string_view text, bool cdata) override {
+        if (!inValue && !inText) return;
+        if (cdata) value.append(text.data(), text.size());
+        else Xml_AppendText(text, &value);
+    }
+
+private:
+    void EmitCell() {
+        // Cells with only a style have nothing to show
+        if (value.empty()) return;
+
+        // Cells left out of the row are kept as empty fields
+        if (column < fields) column = fields;
+        for (; fields < column; fields++) {
+            if (fields > 0) out->push_back(',');
+        }
+        if (fields > 0) out->push_back(',');
+        fields++;
+
+        if (type == "s") {
+            size_t index = strtoul(value.c_str(), NULL, 10);
+            if (index + 1 < book->offsets.size()) {
+                AppendField(std::string_view(book->arena.data() + book->offsets[index],
+                                             book->offsets[index + 1] - book->offsets[index]), out);
+            }
+        } else if (type == "b") {
+            out->append(value == "1" ? "TRUE" : "FALSE");
+        } else if (type.empty() || type == "n") {
+            bool isDate = style >= 0 && (size_t)style < book->dateStyles.size() && book->dateStyles[style];
+            if (isDate) AppendDate(value, book->date1904, out);
+            else AppendNumber(value, out);
+        } else {
+            // str, inlineStr, e and d are text already
+            AppendField(value, out);
+        }
+    }
+
+    XlsxBook* book;
+    std::string* out;
+    bool inSheetData;
+    bool inValue;
+    bool inInline;
+    bool inText;
+    int phonetic;
+    size_t lines;   // lines written so far
+    size_t fields;  // fields written on the current line
+    size_t column;
+    std::string type;
+    int style;
+    std::string value;
+};
+
+bool Xlsx_ReadSheet(XlsxBook* book, int index, std::string* csv, const std::atomic<bool>* cancel,
+                    std::string* error) {
+    if (!book || !csv || index < 0 || index >= (int)book->sheets.size()) return false;
+    if (!LoadExtras(book, cancel)) {
+        if (error) *error = "Error: Could not read the workbook's shared strings.";
+        return false;
+    }
+    SheetReader reader(book, csv);
+    if (!Opc_ParsePart(&book->zip, book->sheets[index].part, &reader, cancel, &book->window)) {
+        if (error) *error = "Error: Could not read sheet '" + book->sheets[index].name + "'.";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,22 @@
+#ifndef XLSX_H
+#define XLSX_H
+
+#include <atomic>
+#include <string>
+
+// Native XLSX reader. Opening only indexes the archive and reads the sheet
+// list; shared strings and styles are read the first time a sheet needs
+// them, and sheets themselves are streamed, never held as XML.
+struct XlsxBook;
+
+XlsxBook* Xlsx_Open(const char* path, std::string* error);
+void Xlsx_Close(XlsxBook* book);
+int Xlsx_SheetCount(const XlsxBook* book);
+std::string Xlsx_SheetName(const XlsxBook* book, int index);
+// Appends the sheet as comma separated RFC 4180 text, one line per row, so
+// it can be shown like a CSV file. Gaps between rows and cells are kept as
+// empty lines and fields. Dates are written as YYYY-MM-DD[ HH:MM:SS].
+bool Xlsx_ReadSheet(XlsxBook* book, int index, std::string* csv, const std::atomic<bool>* cancel,
+                    std::string* error);
+
+#endif
@@ -0,0 +1,214 @@
+#include <cstdlib>
+#include <cstring>
+#include "xmlscan.h"
+
+static inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static const char* Find(const char* p, const char* end, std::string_view what) {
+    size_t at = std::string_view(p, end - p).find(what);
+    return at == std::string_view::npos ? NULL : p + at;
+}
+
+// Name and attributes of a start tag, given what lies between '<' and '>'
+static void StartTag(XmlScanner* xml, const char* p, const char* end) {
+    bool empty = end > p && end[-1] == '/';
+    if (empty) end--;
+
+    const char* q = p;
+    while (q < end && !IsSpace(*q)) q++;
+    std::string_view name(p, q - p);
+
+    xml->attrs.clear();
+    while (q < end) {
+        while (q < end && IsSpace(*q)) q++;
+        const char* n = q;
+        while (q < end && *q != '=' && !IsSpace(*q)) q++;
+        std::string_view attrName(n, q - n);
+        while (q < end && IsSpace(*q)) q++;
+        if (q >= end || *q != '=') {
+            // Not well formed; skip the stray word
+            if (attrName.empty()) break;
+            continue;
+        }
+        q++;
+        while (q < end && IsSpace(*q)) q++;
+        if (q >= end || (*q != '"' && *q != '\'')) break;
+        char quote = *q++;
+        const char* v = q;
+        while (q < end && *q != quote) q++;
+        XmlAttr attr = {attrName, std::string_view(v, q - v)};
+        xml->attrs.push_back(attr);
+        if (q < end) q++;
+    }
+
+    xml->handler->OnStart(name, xml->attrs);
+    if (empty) xml->handler->OnEnd(name);
+}
+
+// Reports every complete item and returns how many bytes they took. What
+// is left is an item cut off by the end of the piece.
+static size_t Scan(XmlScanner* xml, const char* data, size_t size) {
+    XmlHandler* handler = xml->handler;
+    const char* p = data;
+    const char* end = data + size;
+
+    while (p < end) {
+        if (*p != '<') {
+            // Text runs to the next tag, which may be in the next piece
+            const char* lt = (const char*)memchr(p, '<', end - p);
+            if (!lt) break;
+            handler->OnText(std::string_view(p, lt - p), false);
+            p = lt;
+            continue;
+        }
+
+        size_t left = end - p;
+        if (left < 2) break;
+        if (p[1] == '!') {
+            if (left >= 4 && memcmp(p, "<!--", 4) == 0) {
+                const char* close = Find(p + 4, end, "-->");
+                if (!close) break;
+                p = close + 3;
+            } else if (left < 9) {
+                break;  // too short to tell CDATA from a DOCTYPE
+            } else if (memcmp(p, "<![CDATA[", 9) == 0) {
+                const char* close = Find(p + 9, end, "]]>");
+                if (!close) break;
+                handler->OnText(std::string_view(p + 9, close - p - 9), true);
+                p = close + 3;
+            } else {
+                // DOCTYPE, possibly with an internal subset in brackets
+                const char* q = p + 2;
+                int depth = 0;
+                for (; q < end; q++) {
+                    if (*q == '[') depth++;
+                    else if (*q == ']') depth--;
+                    else if (*q == '>' && depth <= 0) break;
+                }
+                if (q >= end) break;
+                p = q + 1;
+            }
+            continue;
+        }
+        if (p[1] == '?') {
+            const char* close = Find(p + 2, end, "?>");
+            if (!close) break;
+            p = close + 2;
+            continue;
+        }
+        if (p[1] == '/') {
+            const char* gt = (const char*)memchr(p, '>', left);
+            if (!gt) break;
+            const char* nameEnd = p + 2;
+            while (nameEnd < gt && !IsSpace(*nameEnd)) nameEnd++;
+            handler->OnEnd(std::string_view(p + 2, nameEnd - p - 2));
+            p = gt + 1;
+            continue;
+        }
+
+        // A start tag ends at the first '>' outside an attribute value
+        const char* q = p + 1;
+        char quote = 0;
+        for (; q < end; q++) {
+            if (quote) {
+                if (*q == quote) quote = 0;
+            } else if (*q == '"' || *q == '\'') {
+                quote = *q;
+            } else if (*q == '>') {
+                break;
+            }
+        }
+        if (q >= end) break;
+        StartTag(xml, p + 1, q);
+        p = q + 1;
+    }
+    return p - data;
+}
+
+void Xml_Begin(XmlScanner* xml, XmlHandler* handler) {
+    xml->handler = handler;
+    xml->pending.clear();
+    xml->attrs.clear();
+}
+
+void Xml_Feed(XmlScanner* xml, const char* data, size_t size) {
+    if (!xml || !xml->handler) return;
+    if (xml->pending.empty()) {
+        size_t used = Scan(xml, data, size);
+        xml->pending.assign(data + used, size - used);
+        return;
+    }
+    xml->pending.append(data, size);
+    size_t used = Scan(xml, xml->pending.data(), xml->pending.size());
+    xml->pending.erase(0, used);
+}
+
+bool Xml_Finish(XmlScanner* xml) {
+    if (!xml || !xml->handler) return false;
+    bool complete = xml->pending.find('<') == std::string::npos;
+    if (complete && !xml->pending.empty()) xml->handler->OnText(xml->pending, false);
+    xml->pending.clear();
+    return complete;
+}
+
+std::string_view Xml_LocalName(std::string_view name) {
+    size_t colon = name.find(':');
+    return colon == std::string_view::npos ? name : name.substr(colon + 1);
+}
+
+std::string_view Xml_Attr(const std::vector<XmlAttr>& attrs, std::string_view localName) {
+    for (size_t i = 0; i < attrs.size(); i++) {
+        if (Xml_LocalName(attrs[i].name) == localName) return attrs[i].value;
+    }
+    return std::string_view();
+}
+
+static void AppendUTF8(std::string* out, unsigned long cp) {
+    if (cp < 0x80) {
+        out->push_back((char)cp);
+    } else if (cp < 0x800) {
+        out->push_back((char)(0xC0 | (cp >> 6)));
+        out->push_back((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out->push_back((char)(0xE0 | (cp >> 12)));
+        out->push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out->push_back((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x110000) {
+        out->push_back((char)(0xF0 | (cp >> 18)));
+        out->push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+        out->push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out->push_back((char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+void Xml_AppendText(std::string_view raw, std::string* out) {
+    size_t pos = 0;
+    while (pos < raw.size()) {
+        size_t amp = raw.find('&', pos);
+        if (amp == std::string_view::npos) amp = raw.size();
+        out->append(raw.data() + pos, amp - pos);
+        if (amp == raw.size()) break;
+
+        size_t semi = raw.find(';', amp);
+        if (semi == std::string_view::npos || semi - amp > 10) {
+            out->push_back('&');
+            pos = amp + 1;
+            continue;
+        }
+        std::string_view ref = raw.substr(amp + 1, semi - amp - 1);
+        if (ref == "lt") out->push_back('<');
+        else if (ref == "gt") out->push_back('>');
+        else if (ref == "amp") out->push_back('&');
+        else if (ref == "quot") out->push_back('"');
+        else if (ref == "apos") out->push_back('\'');
+        else if (ref.size() > 1 && ref[0] == '#') {
+            std::string digits(ref.substr(ref[1] == 'x' || ref[1] == 'X' ? 2 : 1));
+            AppendUTF8(out, strtoul(digits.c_str(), NULL, ref[1] == 'x' || ref[1] == 'X' ? 16 : 10));
+        } else {
+            out->append(raw.data() + amp, semi + 1 - amp);
+        }
+        pos = semi + 1;
+    }
+}
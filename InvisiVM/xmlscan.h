@@ -0,0 +1,49 @@
+#ifndef XMLSCAN_H
+#define XMLSCAN_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Streaming XML tokenizer for Office parts. The document is fed in pieces
+// as it is inflated and reported tag by tag, so no tree is ever built.
+// Names keep their namespace prefix and values their entity references.
+struct XmlAttr {
+    std::string_view name;
+    std::string_view value;
+};
+
+// Views passed to a handler only live for the call
+class XmlHandler {
+public:
+    virtual ~XmlHandler() {}
+    // An empty element <a/> gets OnStart followed by OnEnd
+    virtual void OnStart(std::string_view name, const std::vector<XmlAttr>& attrs) {}
+    virtual void OnEnd(std::string_view name) {}
+    // Character data; 'cdata' text has no entity references to expand
+    virtual void OnText(std::string_view text, bool cdata) {}
+};
+
+struct XmlScanner {
+    XmlHandler* handler;
+    std::string pending;  // unfinished markup or text from the previous piece
+    std::vector<XmlAttr> attrs;
+
+    XmlScanner() : handler(NULL) {}
+};
+
+void Xml_Begin(XmlScanner* xml, XmlHandler* handler);
+// Feeds the next piece of the document
+void Xml_Feed(XmlScanner* xml, const char* data, size_t size);
+// Delivers trailing text; false if the document stopped inside markup
+bool Xml_Finish(XmlScanner* xml);
+
+// "x:row" -> "row"
+std::string_view Xml_LocalName(std::string_view name);
+// Raw value of the attribute with this local name; empty if absent
+std::string_view Xml_Attr(const std::vector<XmlAttr>& attrs, std::string_view localName);
+// Appends 'raw' with entity and character references expanded
+void Xml_AppendText(std::string_view raw, std::string* out);
+
+#endif
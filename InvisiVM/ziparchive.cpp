@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <cstring>
+#include "threadpool.h"
+#include "ziparchive.h"
+
+static const uint32_t SIG_LOCAL = 0x04034b50;
+static const uint32_t SIG_CENTRAL = 0x02014b50;
+static const uint32_t SIG_END = 0x06054b50;
+static const uint32_t SIG_END64 = 0x06064b50;
+static const uint32_t SIG_LOCATOR64 = 0x07064b50;
+static const size_t END_SIZE = 22;
+static const size_t END64_SIZE = 56;
+static const size_t LOCATOR64_SIZE = 20;
+static const size_t CENTRAL_SIZE = 46;
+static const size_t LOCAL_SIZE = 30;
+static const uint16_t EXTRA_ZIP64 = 0x0001;
+static const uint16_t FLAG_ENCRYPTED = 0x0001;
+// Deflate cannot expand data by more than this
+static const uint64_t MAX_RATIO = 1032;
+static const size_t READ_SLACK = 4096;
+
+static inline uint16_t Read16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t Read32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t Read64(const unsigned char* p) {
+    return Read32(p) | ((uint64_t)Read32(p + 4) << 32);
+}
+
+// The end record sits in the last 64 KB + 22 bytes, after an optional comment
+static bool FindEnd(const unsigned char* data, size_t size, size_t* offset) {
+    if (size < END_SIZE) return false;
+    size_t lowest = size > 0xFFFF + END_SIZE ? size - 0xFFFF - END_SIZE : 0;
+    for (size_t pos = size - END_SIZE + 1; pos-- > lowest;) {
+        if (Read32(data + pos) == SIG_END && pos + END_SIZE + Read16(data + pos + 20) <= size) {
+            *offset = pos;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Archives over 4 GB or 65535 members keep the real directory position in a
+// zip64 end record, found through a locator just before the classic one
+static bool ReadEnd64(const unsigned char* data, size_t end, uint64_t* count, uint64_t* dirSize,
+                      uint64_t* dirOffset) {
+    if (end < LOCATOR64_SIZE) return false;
+    const unsigned char* locator = data + end - LOCATOR64_SIZE;
+    if (Read32(locator) != SIG_LOCATOR64) return false;
+    uint64_t offset = Read64(locator + 8);
+    if (offset > end - LOCATOR64_SIZE || end - LOCATOR64_SIZE - offset < END64_SIZE) return false;
+    const unsigned char* record = data + offset;
+    if (Read32(record) != SIG_END64) return false;
+    *count = Read64(record + 32);
+    *dirSize = Read64(record + 40);
+    *dirOffset = Read64(record + 48);
+    return true;
+}
+
+// Sizes and offsets too big for their 32-bit fields are saturated and
+// given in full, in field order, by a zip64 extra record
+static void ReadExtra64(const unsigned char* extra, size_t size, ZipEntry* entry, bool bigSize,
+                        bool bigCompressed, bool bigOffset) {
+    size_t pos = 0;
+    while (pos + 4 <= size) {
+        uint16_t id = Read16(extra + pos);
+        size_t length = Read16(extra + pos + 2);
+        pos += 4;
+        if (length > size - pos) return;
+        if (id == EXTRA_ZIP64) {
+            const unsigned char* p = extra + pos;
+            const unsigned char* end = p + length;
+            if (bigSize && end - p >= 8) { entry->size = Read64(p); p += 8; }
+            if (bigCompressed && end - p >= 8) { entry->compressedSize = Read64(p); p += 8; }
+            if (bigOffset && end - p >= 8) entry->headerOffset = Read64(p);
+            return;
+        }
+        pos += length;
+    }
+}
+
+bool Zip_Open(const char* path, ZipArchive* zip) {
+    if (!zip) return false;
+    Zip_Close(zip);
+    if (!MapFile_Open(path, &zip->file)) return false;
+
+    const unsigned char* data = (const unsigned char*)zip->file.data;
+    size_t size = zip->file.size;
+    size_t end;
+    if (!data || !FindEnd(data, size, &end)) {
+        Zip_Close(zip);
+        return false;
+    }
+
+    uint64_t count = Read16(data + end + 10);
+    uint64_t dirSize = Read32(data + end + 12);
+    uint64_t dirOffset = Read32(data + end + 16);
+    if (count == 0xFFFF || dirSize == 0xFFFFFFFF || dirOffset == 0xFFFFFFFF) {
+        ReadEnd64(data, end, &count, &dirSize, &dirOffset);
+    }
+    if (dirOffset > end || dirSize > end - dirOffset) {
+        Zip_Close(zip);
+        return false;
+    }
+
+    size_t pos = (size_t)dirOffset;
+    size_t dirEnd = (size_t)(dirOffset + dirSize);
+    // The count is only a hint; a damaged one must not size the table
+    zip->entries.reserve((size_t)std::min<uint64_t>(count, dirSize / CENTRAL_SIZE));
+    while (zip->entries.size() < count && pos + CENTRAL_SIZE <= dirEnd) {
+        const unsigned char* h = data + pos;
+        if (Read32(h) != SIG_CENTRAL) break;
+        size_t nameLen = Read16(h + 28);
+        size_t extraLen = Read16(h + 30);
+        size_t commentLen = Read16(h + 32);
+        if (nameLen + extraLen > dirEnd - pos - CENTRAL_SIZE) break;
+
+        ZipEntry entry;
+        entry.flags = Read16(h + 8);
+        entry.method = Read16(h + 10);
+        entry.compressedSize = Read32(h + 20);
+        entry.size = Read32(h + 24);
+        entry.headerOffset = Read32(h + 42);
+        entry.name.assign((const char*)h + CENTRAL_SIZE, nameLen);
+        ReadExtra64(h + CENTRAL_SIZE + nameLen, extraLen, &entry, entry.size == 0xFFFFFFFF,
+                    entry.compressedSize == 0xFFFFFFFF, entry.headerOffset == 0xFFFFFFFF);
+        zip->byName[entry.name] = zip->entries.size();
+        zip->entries.push_back(entry);
+        pos += CENTRAL_SIZE + nameLen + extraLen + commentLen;
+    }
+    return true;
+}
+
+void Zip_Close(ZipArchive* zip) {
+    if (!zip) return;
+    MapFile_Close(&zip->file);
+    zip->entries.clear();
+    zip->byName.clear();
+}
+
+const ZipEntry* Zip_Find(const ZipArchive* zip, const std::string& name) {
+    if (!zip) return NULL;
+    std::unordered_map<std::string, size_t>::const_iterator it = zip->byName.find(name);
+    return it == zip->byName.end() ? NULL : &zip->entries[it->second];
+}
+
+// The member's compressed bytes, checked against the mapping
+static bool MemberData(const ZipArchive* zip, const ZipEntry* entry, const unsigned char** out) {
+    const unsigned char* data = (const unsigned char*)zip->file.data;
+    size_t size = zip->file.size;
+    if (!entry || (entry->flags & FLAG_ENCRYPTED)) return false;
+    if (entry->headerOffset > size || size - entry->headerOffset < LOCAL_SIZE) return false;
+
+    const unsigned char* h = data + entry->headerOffset;
+    if (Read32(h) != SIG_LOCAL) return false;
+    // The local header's own name and extra lengths decide where data starts
+    uint64_t start = entry->headerOffset + LOCAL_SIZE + Read16(h + 26) + Read16(h + 28);
+    if (start > size || entry->compressedSize > size - start) return false;
+    *out = data + start;
+    return true;
+}
+
+bool Zip_Read(const ZipArchive* zip, const ZipEntry* entry, std::string* out) {
+    const unsigned char* src;
+    if (!zip || !out || !MemberData(zip, entry, &src)) return false;
+    if (entry->method == 0) {
+        out->append((const char*)src, (size_t)entry->compressedSize);
+        return true;
+    }
+    if (entry->method != 8) return false;
+    if (entry->size == 0) return true;
+    // The declared size is only trusted as far as the data could expand. The
+    // slack covers the decoder's look-ahead, so it never has to regrow.
+    out->reserve(out->size() + (size_t)std::min(entry->size, entry->compressedSize * MAX_RATIO) + READ_SLACK);
+    return Inflate_Raw(src, (size_t)entry->compressedSize, out);
+}
+
+bool Zip_Stream(const ZipArchive* zip, const ZipEntry* entry, const InflateSink& sink, size_t chunkSize,
+                InflateWindow* window) {
+    const unsigned char* src;
+    if (!zip || !MemberData(zip, entry, &src)) return false;
+    if (entry->method == 0) {
+        size_t size = (size_t)entry->compressedSize;
+        chunkSize = std::max<size_t>(chunkSize, 1);
+        for (size_t pos = 0; pos < size; pos += chunkSize) {
+            if (!sink((const char*)src + pos, std::min(chunkSize, size - pos))) return false;
+        }
+        return true;
+    }
+    if (entry->method != 8) return false;
+    if (entry->size == 0) return true;
+    // A small member needs no more buffer than its own size. A wrong size
+    // only means more, smaller pieces.
+    chunkSize = (size_t)std::min<uint64_t>(chunkSize, entry->size);
+    return Inflate_Stream(src, (size_t)entry->compressedSize, sink, chunkSize, window);
+}
+
+void Zip_StreamParallel(const ZipArchive* zip, const std::vector<const ZipEntry*>& entries,
+                        const std::vector<InflateSink>& sinks, size_t chunkSize, std::vector<char>* ok) {
+    size_t count = std::min(entries.size(), sinks.size());
+    ok->assign(entries.size(), 0);
+    if (count == 0) return;
+
+    TaskLatch latch(count - 1);
+    for (size_t i = 1; i < count; i++) {
+        ThreadPool_Submit([&, i](int) {
+            (*ok)[i] = Zip_Stream(zip, entries[i], sinks[i], chunkSize, NULL);
+            latch.Finish();
+        });
+    }
+    (*ok)[0] = Zip_Stream(zip, entries[0], sinks[0], chunkSize, NULL);
+    latch.Wait();
+}
@@ -0,0 +1,49 @@
+#ifndef ZIPARCHIVE_H
+#define ZIPARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "inflate.h"
+#include "mapfile.h"
+
+// Reader for the ZIP containers behind DOCX and XLSX. The archive is mapped
+// and its central directory indexed once; members are inflated straight
+// from the mapping. Zip64 archives are read. Every offset and length is
+// checked against the mapping, so a damaged archive fails rather than
+// reading out of bounds. An open archive may be read from several threads.
+struct ZipEntry {
+    std::string name;
+    uint64_t headerOffset;  // local file header
+    uint64_t compressedSize;
+    uint64_t size;
+    int method;             // 0 stored, 8 deflate
+    int flags;              // general purpose bits; encrypted members are refused
+};
+
+struct ZipArchive {
+    MappedFile file;
+    std::vector<ZipEntry> entries;
+    std::unordered_map<std::string, size_t> byName;
+};
+
+bool Zip_Open(const char* path, ZipArchive* zip);
+void Zip_Close(ZipArchive* zip);
+// NULL if there is no such member
+const ZipEntry* Zip_Find(const ZipArchive* zip, const std::string& name);
+// Appends the whole member to 'out'
+bool Zip_Read(const ZipArchive* zip, const ZipEntry* entry, std::string* out);
+// Hands the member to 'sink' in pieces of about 'chunkSize' bytes without
+// ever holding all of it. 'window' may be NULL; see InflateWindow.
+bool Zip_Stream(const ZipArchive* zip, const ZipEntry* entry, const InflateSink& sink, size_t chunkSize,
+                InflateWindow* window);
+// Zip_Stream for several members at once: the first on this thread, the
+// rest on the thread pool, each with its own window. sinks[i] receives
+// entries[i] and ok[i] is set to what Zip_Stream returned for it. The
+// sinks run concurrently. Not to be called from a pool task.
+void Zip_StreamParallel(const ZipArchive* zip, const std::vector<const ZipEntry*>& entries,
+                        const std::vector<InflateSink>& sinks, size_t chunkSize, std::vector<char>* ok);
+
+#endif